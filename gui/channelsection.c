@@ -30,6 +30,7 @@
 #include "gui.h"
 #include "patchlist.h"
 #include "midi.h"
+#include "mixer.h"
 #include "patch_set_and_get.h"
 
 
@@ -76,6 +77,14 @@ static void upper_vel_cb(PhinSliderButton* button, ChannelSection* self)
 }
 
 
+static void bus_cb(PhinSliderButton* button, ChannelSection* self)
+{
+    int bus = (int)phin_slider_button_get_value(button);
+
+    patch_set_bus(self->patch, bus-1);
+}
+
+
 static void connect(ChannelSection* self)
 {
     g_signal_connect(G_OBJECT(self->chan_sb), "value-changed",
@@ -84,16 +93,19 @@ static void connect(ChannelSection* self)
                         G_CALLBACK(lower_vel_cb), (gpointer) self);
     g_signal_connect(G_OBJECT(self->upper_vel_sb), "value-changed",
                         G_CALLBACK(upper_vel_cb), (gpointer) self);
+    g_signal_connect(G_OBJECT(self->bus_sb), "value-changed",
+                        G_CALLBACK(bus_cb), (gpointer) self);
 }
 
 
 static void channel_section_init(ChannelSection* self)
 {
     GtkBox* box = GTK_BOX(self);
-    GtkWidget* table = gtk_table_new( 3, 2, 1);
+    GtkWidget* table = gtk_table_new( 4, 2, 1);
     GtkWidget* lbl_chan = gtk_label_new("Channel");
     GtkWidget* lbl_lower = gtk_label_new("Lower Vel.");
     GtkWidget* lbl_upper = gtk_label_new("Upper Vel.");
+    GtkWidget* lbl_bus = gtk_label_new("Output");
     
     self->patch = -1;
 
@@ -103,6 +115,8 @@ static void channel_section_init(ChannelSection* self)
     gtk_widget_show(lbl_lower);
     gtk_table_attach_defaults(GTK_TABLE(table),lbl_upper,0,1,2,3);
     gtk_widget_show(lbl_upper);
+    gtk_table_attach_defaults(GTK_TABLE(table),lbl_bus,0,1,3,4);
+    gtk_widget_show(lbl_bus);
 
     /* channel sliderbutton */
     self->chan_sb = phin_slider_button_new_with_range(1, 1, MIDI_CHANS,1,0);
@@ -124,6 +138,14 @@ static void channel_section_init(ChannelSection* self)
                                                         GUI_THRESHOLD);
     gtk_table_attach_defaults(GTK_TABLE(table),self->upper_vel_sb,1,2,2,3);
     gtk_widget_show(self->upper_vel_sb);
+
+    /* output bus sliderbutton */
+    self->bus_sb = phin_slider_button_new_with_range(1, 1,
+                                                    MIXER_MAX_BUSES, 1, 0);
+    phin_slider_button_set_threshold(PHIN_SLIDER_BUTTON(self->bus_sb),
+                                                        GUI_THRESHOLD);
+    gtk_table_attach_defaults(GTK_TABLE(table),self->bus_sb,1,2,3,4);
+    gtk_widget_show(self->bus_sb);
     
     gui_pack(box, table);
     
@@ -135,12 +157,14 @@ static void channel_section_init(ChannelSection* self)
 static void block(ChannelSection* self)
 {
     g_signal_handlers_block_by_func(self->chan_sb, channel_cb, self);
+    g_signal_handlers_block_by_func(self->bus_sb, bus_cb, self);
 }
 
 
 static void unblock(ChannelSection* self)
 {
     g_signal_handlers_unblock_by_func(self->chan_sb, channel_cb, self);
+    g_signal_handlers_unblock_by_func(self->bus_sb, bus_cb, self);
 }
 
 
@@ -149,6 +173,7 @@ static void set_sensitive(ChannelSection* self, gboolean val)
     gtk_widget_set_sensitive(self->chan_sb, val);
     gtk_widget_set_sensitive(self->lower_vel_sb, val);
     gtk_widget_set_sensitive(self->upper_vel_sb, val);
+    gtk_widget_set_sensitive(self->bus_sb, val);
 }
 
 
@@ -160,7 +185,7 @@ GtkWidget* channel_section_new(void)
 
 void channel_section_set_patch(ChannelSection* self, int patch)
 {
-    int channel, lower_vel, upper_vel;
+    int channel, lower_vel, upper_vel, bus;
 
     self->patch = patch;
 
@@ -172,6 +197,7 @@ void channel_section_set_patch(ChannelSection* self, int patch)
         channel = patch_get_channel(patch);
         lower_vel = patch_get_lower_vel(patch);
         upper_vel = patch_get_upper_vel(patch);
+        bus = patch_get_bus(patch);
 
         block(self);
         phin_slider_button_set_value(PHIN_SLIDER_BUTTON(self->chan_sb),
@@ -180,6 +206,8 @@ void channel_section_set_patch(ChannelSection* self, int patch)
                                                                 lower_vel);
         phin_slider_button_set_value(PHIN_SLIDER_BUTTON(self->upper_vel_sb),
                                                                 upper_vel);
+        phin_slider_button_set_value(PHIN_SLIDER_BUTTON(self->bus_sb),
+                                                                bus+1);
         unblock(self);
     }
 }
@@ -60,6 +60,7 @@ struct _ChannelSection
     GtkWidget* chan_sb;
     GtkWidget* lower_vel_sb;
     GtkWidget* upper_vel_sb;
+    GtkWidget* bus_sb;
 };
 
 
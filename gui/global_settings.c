@@ -49,6 +49,9 @@ void settings_init()
 
     gbl_settings->sample_file_filter = strdup("All Audio files");
     gbl_settings->sample_auto_preview = true;
+    gbl_settings->bank_lazy_load = false;
+    gbl_settings->sample_budget = 0;
+    gbl_settings->sample_keep_source = false;
 
     gbl_settings->filename = (char*) g_build_filename(
                              g_get_user_config_dir(),
@@ -155,6 +158,17 @@ int settings_read(const char* path)
                     }
                 }
 
+                if (xmlStrcmp(prop, BAD_CAST "sample-budget") == 0)
+                {
+                    xmlChar* vprop = xmlGetProp(node2, BAD_CAST "value");
+
+                    if (sscanf((const char*)vprop, "%d", &n) == 1)
+                    {
+                        if (n >= 0)
+                            gbl_settings->sample_budget = n;
+                    }
+                }
+
                 if (xmlStrcmp(prop, BAD_CAST "sample-file-filter") == 0)
                 {
                     free(gbl_settings->sample_file_filter);
@@ -169,6 +183,20 @@ int settings_read(const char* path)
                                                         BAD_CAST "value"));
                 }
 
+                if (xmlStrcmp(prop, BAD_CAST "bank-lazy-load") == 0)
+                {
+                    gbl_settings->bank_lazy_load =
+                        xmlstr_to_gboolean(xmlGetProp(node2,
+                                                        BAD_CAST "value"));
+                }
+
+                if (xmlStrcmp(prop, BAD_CAST "sample-keep-source") == 0)
+                {
+                    gbl_settings->sample_keep_source =
+                        xmlstr_to_gboolean(xmlGetProp(node2,
+                                                        BAD_CAST "value"));
+                }
+
                 if (xmlStrcmp(prop, BAD_CAST "sync-method") == 0)
                 {
                     xmlChar* vprop = xmlGetProp(node2, BAD_CAST "value");
@@ -266,6 +294,12 @@ int settings_write()
     snprintf(buf, CHARBUFSIZE, "%d", gbl_settings->log_lines);
     xmlNewProp(node2, BAD_CAST "value", BAD_CAST buf);
 
+    node2 = xmlNewTextChild(node1, NULL, BAD_CAST "property", NULL);
+    xmlNewProp(node2, BAD_CAST "name", BAD_CAST "sample-budget");
+    xmlNewProp(node2, BAD_CAST "type", BAD_CAST "int");
+    snprintf(buf, CHARBUFSIZE, "%d", gbl_settings->sample_budget);
+    xmlNewProp(node2, BAD_CAST "value", BAD_CAST buf);
+
 
     node2 = xmlNewTextChild(node1, NULL, BAD_CAST "property", NULL);
     xmlNewProp(node2, BAD_CAST "name", BAD_CAST "sample-file-filter");
@@ -281,6 +315,22 @@ int settings_write()
                                     ? "true"
                                     : "false"));
 
+    node2 = xmlNewTextChild(node1, NULL, BAD_CAST "property", NULL);
+    xmlNewProp(node2, BAD_CAST "name", BAD_CAST "bank-lazy-load");
+    xmlNewProp(node2, BAD_CAST "type", BAD_CAST "boolean");
+    xmlNewProp(node2, BAD_CAST "value",
+                      BAD_CAST (gbl_settings->bank_lazy_load
+                                    ? "true"
+                                    : "false"));
+
+    node2 = xmlNewTextChild(node1, NULL, BAD_CAST "property", NULL);
+    xmlNewProp(node2, BAD_CAST "name", BAD_CAST "sample-keep-source");
+    xmlNewProp(node2, BAD_CAST "type", BAD_CAST "boolean");
+    xmlNewProp(node2, BAD_CAST "value",
+                      BAD_CAST (gbl_settings->sample_keep_source
+                                    ? "true"
+                                    : "false"));
+
     node2 = xmlNewTextChild(node1, NULL, BAD_CAST "property", NULL);
     xmlNewProp(node2, BAD_CAST "name", BAD_CAST "sync-method");
     xmlNewProp(node2, BAD_CAST "type", BAD_CAST "string");
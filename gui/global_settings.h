@@ -40,6 +40,10 @@ typedef struct global_settings_def
     char*   sample_file_filter;
     bool    sample_auto_preview;
 
+    bool    bank_lazy_load;     /* see dish_file_set_lazy */
+    int     sample_budget;      /* MB, see patch_set_sample_budget */
+    bool    sample_keep_source; /* see sample_set_keep_source */
+
 } global_settings;
 
 
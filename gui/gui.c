@@ -86,6 +86,7 @@ static GtkWidget* menu_file_export = 0;
 
 /* settings */
 static GtkWidget* menu_settings_auto_preview = 0;
+static GtkWidget* menu_settings_lazy_load = 0;
 
 /* view */
 static GtkWidget* menu_view_log_display = 0;
@@ -520,6 +521,16 @@ static void cb_menu_settings_auto_preview(GtkWidget* widget, gpointer data)
 }
 
 
+static void cb_menu_settings_lazy_load(GtkWidget* widget, gpointer data)
+{
+    (void)widget;(void)data;
+    global_settings* settings = settings_get();
+    settings->bank_lazy_load = gtk_check_menu_item_get_active(
+                        GTK_CHECK_MENU_ITEM(menu_settings_lazy_load));
+    dish_file_set_lazy(settings->bank_lazy_load);
+}
+
+
 void cb_menu_view_log_display_showing(gboolean active)
 {
     gtk_check_menu_item_set_active(
@@ -602,6 +613,21 @@ static void cb_patch_list_changed(PatchList* list, gpointer data)
 }
 
 
+/*  installs the samples of a lazily loaded bank as they become ready,
+    and keeps the samples in memory to the budget */
+static gboolean cb_samples_poll(gpointer data)
+{
+    (void)data;
+
+    patch_sample_budget_poll();
+
+    if (dish_file_poll() > 0)
+        patch_list_update(PATCH_LIST(patch_list), cur_patch,
+                                                PATCH_LIST_PATCH);
+    return TRUE;
+}
+
+
 static void cb_recent_chooser_item_activated (GtkRecentChooser *chooser
                , gpointer *data)
 {
@@ -732,6 +758,20 @@ int gui_init(void)
                                         menu_settings_auto_preview);
     gtk_widget_show(menu_settings_auto_preview);
 
+    /* lazy bank loading */
+    menu_settings_lazy_load =
+        gtk_check_menu_item_new_with_label("Load samples in background");
+    gtk_check_menu_item_set_active(
+        GTK_CHECK_MENU_ITEM(menu_settings_lazy_load),
+            settings->bank_lazy_load);
+
+    g_signal_connect(GTK_OBJECT(menu_settings_lazy_load), "toggled",
+        G_CALLBACK(cb_menu_settings_lazy_load), NULL);
+
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu_settings),
+                                        menu_settings_lazy_load);
+    gtk_widget_show(menu_settings_lazy_load);
+
     /* view menu */
     menu_view = gui_menu_add(menubar, "View", NULL, NULL);
     menu_view_log_display =
@@ -811,6 +851,8 @@ int gui_init(void)
 
     gui_refresh();
 
+    g_timeout_add(100, cb_samples_poll, NULL);
+
     return 0;
 }
 
@@ -23,6 +23,7 @@
 
 
 #include <gtk/gtk.h>
+#include <stdio.h>
 
 #include "phin.h"
 
@@ -30,6 +31,7 @@
 #include "petri-foo.h"
 #include "gui.h"
 #include "mixer.h"
+#include "telemetry.h"
 
 
 
@@ -52,6 +54,41 @@ static void amp_changed_cb(PhinSlider* sl, gpointer data)
 }
 
 
+static gboolean load_update_cb(gpointer data)
+{
+    MasterSection* self = MASTER_SECTION(data);
+    Telemetry t;
+    char buf[256];
+
+    telemetry_get(engine_default(), &t);
+
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(self->load),
+                                    t.load > 1.0 ? 1.0 : t.load);
+
+    snprintf(buf, sizeof(buf), "DSP %.0f%% (peak %.0f%%), %d voices",
+                        t.load * 100.0, t.load_peak * 100.0, t.voices);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(self->load), buf);
+
+    telemetry_format(buf, sizeof(buf), &t);
+    gtk_widget_set_tooltip_text(self->load, buf);
+
+    return TRUE;
+}
+
+
+static void destroy_cb(GtkWidget* widget, gpointer data)
+{
+    MasterSection* self = MASTER_SECTION(widget);
+    (void)data;
+
+    if (self->load_timeout)
+    {
+        g_source_remove(self->load_timeout);
+        self->load_timeout = 0;
+    }
+}
+
+
 static void master_section_init(MasterSection* self)
 {
     GtkBox* box = GTK_BOX(self);
@@ -76,6 +113,13 @@ static void master_section_init(MasterSection* self)
     gtk_widget_show(self->amp);
     gtk_widget_show(hbox);
 
+    /* dsp load */
+    self->load = gtk_progress_bar_new();
+    gtk_box_pack_start(box, self->load, FALSE, FALSE, 0);
+    gtk_widget_show(self->load);
+
+    self->load_timeout = g_timeout_add(250, load_update_cb, self);
+
     /* pad */
     pad = gui_vpad_new(GUI_SPACING/2);
     gtk_box_pack_start(box, pad, FALSE, FALSE, 0);
@@ -84,6 +128,8 @@ static void master_section_init(MasterSection* self)
     /* signal */
     g_signal_connect(self->amp, "value-changed",
                     G_CALLBACK(amp_changed_cb), NULL);
+
+    g_signal_connect(self, "destroy", G_CALLBACK(destroy_cb), NULL);
 }
 
 
@@ -54,6 +54,8 @@ struct _MasterSection
 {
     GtkVBox parent_instance;
     GtkWidget* amp; /* <private> */
+    GtkWidget* load;
+    guint      load_timeout;
 };
 
 
@@ -25,6 +25,7 @@
 #include <gtk/gtk.h>
 #include "patchlist.h"
 #include "gui.h"
+#include "dish_file.h"
 #include "petri-foo.h"
 #include "patch_set_and_get.h"
 #include "patch_util.h"
@@ -52,6 +53,7 @@ enum
 {
     PATCH_NAME,
     PATCH_ID,
+    PATCH_READY,    /* not waiting for its sample to load */
     LAST_COLUMN,
 };
 
@@ -199,7 +201,8 @@ static void patch_list_init(PatchList* self)
 
     /* patch list */
     p->patch_store =
-        gtk_list_store_new(LAST_COLUMN, G_TYPE_STRING, G_TYPE_INT);
+        gtk_list_store_new(LAST_COLUMN, G_TYPE_STRING, G_TYPE_INT,
+                                                        G_TYPE_BOOLEAN);
 
     p->patch_tree = 
         gtk_tree_view_new_with_model(GTK_TREE_MODEL(p->patch_store));
@@ -209,6 +212,8 @@ static void patch_list_init(PatchList* self)
     column = gtk_tree_view_column_new_with_attributes(  "Patch",
                                                         renderer,
                                                         "text", PATCH_NAME,
+                                                        "sensitive",
+                                                        PATCH_READY,
                                                         NULL);
 
     gtk_tree_view_append_column(GTK_TREE_VIEW(p->patch_tree), column);
@@ -264,7 +269,9 @@ void patch_list_update(PatchList* self, int target, int type)
         str = patch_get_name(patches[i]);
         gtk_list_store_append(p->patch_store, &iter);
         gtk_list_store_set(p->patch_store, &iter, PATCH_NAME, str,
-                                                  PATCH_ID, patches[i], -1);
+                                                  PATCH_ID, patches[i],
+                        PATCH_READY, !dish_file_patch_loading(patches[i]),
+                                                  -1);
 
         if (type == PATCH_LIST_PATCH && patches[i] == target)
             index = i;
@@ -30,6 +30,7 @@
 
 #include "dish_file.h"
 #include "driver.h"
+#include "gc.h"
 #include "global_settings.h"
 #include "gui.h"
 #include "instance.h"
@@ -42,8 +43,12 @@
 #include "names.h"
 #include "patch.h"
 #include "patch_util.h"
+#include "rtlog.h"
 #include "petri-foo.h"
+#include "sample.h"
 #include "session.h"
+#include "trace.h"
+#include "worker.h"
 
 
 void show_usage (void)
@@ -59,12 +64,28 @@ void show_usage (void)
     printf("  -u, --unconnected         Don't auto-connect to JACK system "
                                         "playback ports (deprecated)\n");
     printf("  -U, --uuid <uuid>         Set UUID for JACK session\n");
+    printf("  -n, --native-rate         Play samples at their own rate "
+                                        "instead of resampling them\n");
+    printf("  -s, --stats <seconds>     Print engine load and voice "
+                                        "counts every <seconds>\n");
+    printf("  -t, --trace <file>        Record what the engine does to "
+                                        "a Chrome trace file\n");
+    printf("  -o, --outputs <n>         Number of stereo JACK outputs "
+                                        "patches may be sent to\n");
     printf("  -h, --help                Display this help message\n\n");
     printf("For more information, please see:"
             "http://petri-foo.sourceforge.net/\n");
 }
 
 
+static gboolean rtlog_dispatch_cb(gpointer data)
+{
+    (void)data;
+    rtlog_dispatch();
+    return TRUE;
+}
+
+
 void cleanup(void)
 {
     msg_log(MSG_MESSAGE, "Cleanup...\n");
@@ -72,6 +93,10 @@ void cleanup(void)
     dish_file_state_cleanup();
     midi_stop();
     driver_stop();
+    worker_shutdown();
+    rtlog_dispatch();
+    trace_stop();
+    gc_shutdown();
     patch_shutdown();
     mixer_shutdown();
     settings_write();
@@ -138,14 +163,25 @@ int main(int argc, char *argv[])
     mod_src_create();
     gtk_init(&argc, &argv);
     settings_init();
+    dish_file_set_lazy(settings_get()->bank_lazy_load);
+    patch_set_sample_budget(
+                    (unsigned long)settings_get()->sample_budget << 20);
+    sample_set_keep_source(settings_get()->sample_keep_source);
+    jackdriver_register();
     driver_init();
     lfo_tables_init();
     mixer_init();
+    worker_init(0);
+    gc_init();
     patch_control_init();
     dish_file_state_init();
     session_init(argc, argv);
     gui_init();
 
+    /* the engine's messages are passed on from the GUI thread */
+    rtlog_set_sink(msg_log_rtlog_sink);
+    g_timeout_add(100, rtlog_dispatch_cb, NULL);
+
     for (n = 0; n < SC; ++n)
     {
         s[n].sa_handler = sighandlers[n];
@@ -25,6 +25,7 @@
 #include <getopt.h>
 #include <glib.h>
 #include <gtk/gtk.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -38,9 +39,12 @@
 #include "instance.h"
 #include "jackdriver.h"
 #include "midi.h"
+#include "mixer.h"
 #include "msg_log.h"
 #include "patch_util.h"
 #include "petri-foo.h"
+#include "telemetry.h"
+#include "trace.h"
 
 #if HAVE_LIBLO
 #include "nsm.h"
@@ -106,6 +110,23 @@ static void msg_log_to_nsm(const char* msg, int msg_base_type)
 #endif /* HAVE_LIBLO */
 
 
+/* --stats: each line covers the peaks since the line before */
+static gboolean session_stats_cb(gpointer data)
+{
+    Telemetry t;
+    char buf[256];
+    (void)data;
+
+    telemetry_get(engine_default(), &t);
+    telemetry_reset_peaks(engine_default());
+    telemetry_format(buf, sizeof(buf), &t);
+    printf("%s\n", buf);
+    fflush(stdout);
+
+    return TRUE;
+}
+
+
 void session_idle_add_event_poll(void)
 {
     debug("session_type:'%s'\n", session_names[_session->type]);
@@ -137,6 +158,10 @@ int session_init(int argc, char* argv[])
         { "jack-name",      1, 0, 'j'},
         { "unconnected",    0, 0, 'u'},
         { "uuid",           1, 0, 'U'},
+        { "native-rate",    0, 0, 'n'},
+        { "stats",          1, 0, 's'},
+        { "trace",          1, 0, 't'},
+        { "outputs",        1, 0, 'o'},
         { 0, 0, 0, 0}
     };
 
@@ -154,7 +179,8 @@ int session_init(int argc, char* argv[])
     s->state = SESSION_STATE_CLOSED;
     s->bank_path = 0;
 
-    while((opt = getopt_long(argc, argv, "aj:uU:", opts, &opt_ix)) > 0)
+    while((opt = getopt_long(argc, argv, "aj:uU:ns:t:o:",
+                                                    opts, &opt_ix)) > 0)
     {
         switch (opt)
         {
@@ -195,6 +221,38 @@ int session_init(int argc, char* argv[])
             else msg_log(MSG_WARNING, "Ignoring --uuid option\n");
             break;
 
+        case 'n':
+            patch_set_native_rate(true);
+            msg_log(MSG_MESSAGE, "Playing samples at their native rate\n");
+            break;
+
+        case 's':
+            if (atoi(optarg) > 0)
+                g_timeout_add_seconds(atoi(optarg), session_stats_cb, 0);
+            else
+                msg_log(MSG_WARNING, "Ignoring --stats option\n");
+            break;
+
+        case 'o':
+            if (atoi(optarg) >= 1 && atoi(optarg) <= MIXER_MAX_BUSES)
+            {
+                mixer_set_buses(atoi(optarg));
+                msg_log(MSG_MESSAGE, "Using %d stereo outputs\n",
+                                                    mixer_get_buses());
+            }
+            else
+                msg_log(MSG_WARNING, "Ignoring --outputs option, "
+                                "must be 1 to %d\n", MIXER_MAX_BUSES);
+            break;
+
+        case 't':
+            if (trace_start(optarg) == 0)
+                msg_log(MSG_MESSAGE, "Recording trace to '%s'\n", optarg);
+            else
+                msg_log(MSG_ERROR, "Failed to open trace file '%s'\n",
+                                                                optarg);
+            break;
+
         default:
             msg_log(MSG_WARNING, "Ignoring unknown option '--%s'\n",
                                                         opts[opt_ix].name);
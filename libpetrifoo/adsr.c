@@ -281,7 +281,7 @@ float adsr_tick(ADSR* e)
 }
 
 
-void adsr_set_params (ADSR* env, ADSRParams* params)
+void adsr_set_params (ADSR* env, const ADSRParams* params)
 {
     env->_delay   = ticks_secs_to_ticks (params->delay);
     env->_attack  = ticks_secs_to_ticks (params->attack);
@@ -73,7 +73,7 @@ ADSR*   adsr_new        (void);
 void    adsr_free       (ADSR*);
 void    adsr_init       (ADSR*);
 void    adsr_release    (ADSR*);
-void    adsr_set_params (ADSR*, ADSRParams*);
+void    adsr_set_params (ADSR*, const ADSRParams*);
 float   adsr_tick       (ADSR*);
 void    adsr_trigger    (ADSR*, float key_val, float vel_val);
 
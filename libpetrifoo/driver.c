@@ -35,17 +35,34 @@
 
 
 /* available drivers */
-extern Driver  jack_driver;
-static Driver* drivers[] = { &jack_driver, NULL };
+extern Driver  offline_driver;
+static Driver* drivers[DRIVER_MAX];
 static int ndrivers = 0;
 static int curdriver = -1;
 
 
+int driver_register(Driver* driver)
+{
+    if (ndrivers == DRIVER_MAX)
+    {
+        debug("too many drivers, not registering %s\n",
+                                                driver->getname());
+        return -1;
+    }
+
+    drivers[ndrivers++] = driver;
+
+    return 0;
+}
+
+
 void driver_init(void)
 {
     int i;
 
-    for (i = 0; drivers[i] != NULL; i++, ndrivers++)
+    driver_register(&offline_driver);
+
+    for (i = 0; i < ndrivers; i++)
         drivers[i]->init();
 }
 
@@ -67,6 +84,36 @@ int driver_start(void)
     return drivers[curdriver]->start();
 }
 
+int driver_start_named(const char* name)
+{
+    int i;
+
+    assert(ndrivers > 0);
+
+    for (i = 0; i < ndrivers; ++i)
+        if (strcasecmp(drivers[i]->getname(), name) == 0)
+            break;
+
+    if (i == ndrivers)
+    {
+        debug("no such driver: %s\n", name);
+        return -1;
+    }
+
+    if (curdriver >= 0)
+        drivers[curdriver]->stop();
+
+    curdriver = i;
+
+    if (drivers[curdriver]->start() != 0)
+    {
+        curdriver = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
 void driver_stop(void)
 {
     debug("driver stop\n");
@@ -29,10 +29,11 @@
 #include <stdbool.h>
 
 
-/*  driver has been fixed to only handle JACK
-    more work should be done to clear the debris scattered
-    from when there was a choice between JACK and ALSA, but
-    for now, i'd rather have things working.
+/*  the drivers are those registered before driver_init, then the
+    offline driver (see offlinedriver.h) which the command line tools
+    start by name. driver_start starts the first: JACK, for the
+    programs which register it (see jackdriver.h). the JACK driver
+    is a library of its own so the rest need not link libjack.
 */
 
 
@@ -50,9 +51,15 @@ typedef struct _Driver
 } Driver;
 
 
+enum { DRIVER_MAX = 4 };
+
+/* before driver_init only, returns -1 if there are DRIVER_MAX already */
+int         driver_register       (Driver*);
+
 void        driver_init           (void);
 int         driver_restart        (void);
 int         driver_start          (void);
+int         driver_start_named    (const char* name);
 void        driver_stop           (void);
 bool        driver_running        (void);
 int         driver_get_count      (void);
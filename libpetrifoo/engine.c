@@ -0,0 +1,126 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "engine_private.h"
+
+#include <stdlib.h>
+
+#include "petri-foo.h"
+#include "patch_util.h"
+#include "sync.h"
+
+
+static Engine   default_engine =
+{
+    &mixer_state_default,
+    &patch_state_default,
+    &telemetry_state_default,
+    -1,
+    SYNC_DEFAULT_TEMPO,
+    0,
+    1
+};
+
+
+__thread Engine* current_engine = &default_engine;
+
+
+Engine* engine_new(void)
+{
+    Engine* e = malloc(sizeof(*e));
+
+    if (!e)
+        return 0;
+
+    e->mixer = mixer_state_new();
+    e->patch = patch_state_new();
+    e->telemetry = telemetry_state_new();
+    e->samplerate = -1;
+    e->tempo = SYNC_DEFAULT_TEMPO;
+    e->audio_epoch = 0;
+    e->refs = 1;
+
+    if (!e->mixer || !e->patch || !e->telemetry)
+    {
+        mixer_state_free(e->mixer);
+        patch_state_free(e->patch);
+        telemetry_state_free(e->telemetry);
+        free(e);
+        return 0;
+    }
+
+    debug("created engine %p\n", (void*)e);
+
+    return e;
+}
+
+
+void engine_free(Engine* e)
+{
+    Engine* prev = current_engine;
+
+    if (!e || e == &default_engine)
+        return;
+
+    debug("freeing engine %p\n", (void*)e);
+
+    current_engine = e;
+    patch_destroy_all();
+    current_engine = (prev == e) ? &default_engine : prev;
+
+    engine_release(e);
+}
+
+
+void engine_select(Engine* e)
+{
+    current_engine = e ? e : &default_engine;
+}
+
+
+Engine* engine_current(void)
+{
+    return current_engine;
+}
+
+
+Engine* engine_default(void)
+{
+    return &default_engine;
+}
+
+
+void engine_hold(Engine* e)
+{
+    __atomic_add_fetch(&e->refs, 1, __ATOMIC_RELAXED);
+}
+
+
+void engine_release(Engine* e)
+{
+    if (e == &default_engine)
+        return;
+
+    if (__atomic_sub_fetch(&e->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        mixer_state_free(e->mixer);
+        patch_state_free(e->patch);
+        telemetry_state_free(e->telemetry);
+        free(e);
+    }
+}
@@ -0,0 +1,62 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ENGINE_H__
+#define __ENGINE_H__
+
+
+/*  engine
+        the state of one sampler: its patches, MIDI controllers, event
+        queue, master amplitude and samplerate. a process starts with
+        a single engine (the default) and may create more, which all
+        share the worker pool, the gc and the preview.
+
+        the audio thread hands its engine to mixer_mixdown. the rest of
+        libpetrifoo works on the engine selected for the calling
+        thread, which is the default until engine_select says
+        otherwise. every other thread driving an engine (whichever
+        threads queue events to it or edit its patches) must select
+        it first.
+
+        a new engine is silent until driver_set_samplerate and
+        driver_set_buffersize have been called with it selected.
+
+        engines share no sample data: each loads (and resamples) its
+        own copy of every file its patches use. the JACK driver is a
+        single client per process, which renders the default engine
+        only.
+ */
+
+
+typedef struct _Engine Engine;
+
+
+Engine* engine_new(void);
+
+/*  destroys the patches of e, nothing may be rendering it. the
+    default engine is not freed. */
+void    engine_free(Engine* e);
+
+/* binds e to the calling thread, or the default engine if e is 0 */
+void    engine_select(Engine* e);
+
+Engine* engine_current(void);
+Engine* engine_default(void);
+
+
+#endif /* __ENGINE_H__ */
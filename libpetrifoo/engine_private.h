@@ -0,0 +1,71 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __ENGINE_PRIVATE_H__
+#define __ENGINE_PRIVATE_H__
+
+
+#include "engine.h"
+
+
+/* for libpetrifoo only, see engine.h */
+
+
+typedef struct _MixerState MixerState;
+typedef struct _PatchState PatchState;
+typedef struct _TelemetryState TelemetryState;
+
+
+struct _Engine
+{
+    MixerState*     mixer;
+    PatchState*     patch;
+    TelemetryState* telemetry;
+    int             samplerate;     /* for the LFOs and ticks */
+    float           tempo;          /* for the synced LFOs */
+    unsigned long   audio_epoch;    /* see gc.c */
+    int             refs;
+};
+
+
+/* the calling thread's */
+extern __thread Engine* current_engine;
+
+
+/*  jobs left to run on the worker threads after their engine may
+    have been freed hold a reference to it */
+void    engine_hold(Engine*);
+void    engine_release(Engine*);
+
+#define engine_is_default() (current_engine == engine_default())
+
+
+/* the default engine's state, and the state of the others */
+extern MixerState   mixer_state_default;
+extern PatchState   patch_state_default;
+extern TelemetryState telemetry_state_default;
+
+MixerState*     mixer_state_new(void);
+void            mixer_state_free(MixerState*);
+PatchState*     patch_state_new(void);
+void            patch_state_free(PatchState*);
+TelemetryState* telemetry_state_new(void);
+void            telemetry_state_free(TelemetryState*);
+
+
+#endif /* __ENGINE_PRIVATE_H__ */
@@ -0,0 +1,276 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "gc.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "engine_private.h"
+#include "petri-foo.h"
+
+
+enum {
+    GC_INTERVAL_MS =    20,
+
+    /*  besides the audio thread, the GUI reads sample data while
+        drawing (without locking). it only ever holds onto it for the
+        length of a redraw, so a little grace time covers it. */
+    GC_GRACE_MS =       500
+};
+
+
+typedef struct _GCItem GCItem;
+
+struct _GCItem
+{
+    GCFreeFunc      func;
+    void*           ptr;
+    Engine*         engine; /* held until ptr is freed */
+    unsigned long   epoch;  /* its audio_epoch when retired */
+    long            ms;     /* time when retired */
+    GCItem*         next;
+};
+
+
+/*  each engine's audio_epoch is incremented at the start and end of
+ *  every period, so is odd while its audio thread is in the middle
+ *  of one */
+
+static GCItem*          items = 0;
+static bool             running = false;
+static bool             quit = false;
+static pthread_t        thread;
+static pthread_mutex_t  mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   cond = PTHREAD_COND_INITIALIZER;
+
+
+static long gc_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static bool gc_safe(Engine* e, unsigned long epoch)
+{
+    return !(epoch & 1)
+        || __atomic_load_n(&e->audio_epoch, __ATOMIC_ACQUIRE) != epoch;
+}
+
+
+static void gc_wait_and_free(GCFreeFunc func, void* ptr, Engine* e,
+                                            unsigned long epoch)
+{
+    while (!gc_safe(e, epoch))
+        usleep(1000);
+
+    func(ptr);
+}
+
+
+/* frees whatever can be freed, returns true if anything is left */
+static bool gc_collect(void)
+{
+    GCItem* list;
+    GCItem* keep = 0;
+    GCItem* next;
+    bool left;
+    long now = gc_now_ms();
+
+    pthread_mutex_lock(&mutex);
+    list = items;
+    items = 0;
+    pthread_mutex_unlock(&mutex);
+
+    for (; list; list = next)
+    {
+        next = list->next;
+
+        if (gc_safe(list->engine, list->epoch)
+         && now - list->ms >= GC_GRACE_MS)
+        {
+            list->func(list->ptr);
+            engine_release(list->engine);
+            free(list);
+        }
+        else
+        {
+            list->next = keep;
+            keep = list;
+        }
+    }
+
+    pthread_mutex_lock(&mutex);
+
+    while (keep)
+    {
+        next = keep->next;
+        keep->next = items;
+        items = keep;
+        keep = next;
+    }
+
+    left = (items != 0);
+    pthread_mutex_unlock(&mutex);
+
+    return left;
+}
+
+
+static void* gc_thread(void* arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&mutex);
+
+    while (!quit)
+    {
+        if (!items)
+        {
+            pthread_cond_wait(&cond, &mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock(&mutex);
+
+        if (gc_collect())
+            usleep(GC_INTERVAL_MS * 1000);
+
+        pthread_mutex_lock(&mutex);
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return 0;
+}
+
+
+int gc_init(void)
+{
+    if (running)
+        return 0;
+
+    debug("starting gc thread\n");
+
+    quit = false;
+
+    if (pthread_create(&thread, NULL, gc_thread, NULL) != 0)
+        return -1;
+
+    running = true;
+
+    return 0;
+}
+
+
+void gc_shutdown(void)
+{
+    GCItem* next;
+
+    if (!running)
+        return;
+
+    debug("stopping gc thread...\n");
+
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_join(thread, NULL);
+    running = false;
+
+    for (; items; items = next)
+    {
+        next = items->next;
+        gc_wait_and_free(items->func, items->ptr, items->engine,
+                                                    items->epoch);
+        engine_release(items->engine);
+        free(items);
+    }
+
+    debug("done\n");
+}
+
+
+void gc_retire(GCFreeFunc func, void* ptr)
+{
+    GCItem* item;
+
+    /*  the seq_cst load here pairs with the seq_cst increment in
+        gc_audio_begin: either the audio thread is seen to be in a
+        period, or its next period starts after the pointer to ptr
+        was replaced and so cannot see it */
+    Engine* e = current_engine;
+    unsigned long epoch = __atomic_load_n(&e->audio_epoch,
+                                                    __ATOMIC_SEQ_CST);
+    if (!ptr)
+        return;
+
+    if (!running || !(item = malloc(sizeof(*item))))
+    {
+        gc_wait_and_free(func, ptr, e, epoch);
+        return;
+    }
+
+    engine_hold(e);
+
+    item->func = func;
+    item->ptr = ptr;
+    item->engine = e;
+    item->epoch = epoch;
+    item->ms = gc_now_ms();
+
+    pthread_mutex_lock(&mutex);
+    item->next = items;
+    items = item;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+
+unsigned long gc_epoch(void)
+{
+    /* see gc_retire */
+    return __atomic_load_n(&current_engine->audio_epoch,
+                                                    __ATOMIC_SEQ_CST);
+}
+
+
+void gc_wait(unsigned long epoch)
+{
+    while (!gc_safe(current_engine, epoch))
+        usleep(1000);
+}
+
+
+void gc_audio_begin(Engine* e)
+{
+    __atomic_add_fetch(&e->audio_epoch, 1, __ATOMIC_SEQ_CST);
+}
+
+
+void gc_audio_end(Engine* e)
+{
+    __atomic_add_fetch(&e->audio_epoch, 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,72 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __GC_H__
+#define __GC_H__
+
+
+/*  gc
+        deferred freeing of data the audio thread might still be
+        reading. data is published to the audio thread by swapping a
+        pointer atomically, and the old data handed to gc_retire,
+        which frees it (on the gc thread) once the audio thread can
+        no longer be holding a pointer to it.
+
+        the audio thread marks the start and end of each period with
+        gc_audio_begin and gc_audio_end: anything retired outside of
+        a period, or during a period which has since ended, is safe
+        to free. each engine (see engine.h) has its own periods, and
+        what is retired is taken to be the calling thread's engine's.
+ */
+
+
+#include "engine.h"
+
+
+typedef void (*GCFreeFunc)(void*);
+
+
+int     gc_init(void);
+void    gc_shutdown(void);
+
+
+/*  *** NOT for usage by RT thread ***
+
+    if the gc thread is not running gc_retire waits for the audio
+    thread to finish its period (if it is in one) and frees ptr
+    itself.
+ */
+void    gc_retire(GCFreeFunc func, void* ptr);
+
+
+/*  *** NOT for usage by RT thread ***
+
+    for data which is reused rather than freed: take gc_epoch straight
+    after swapping the pointer to it away, and gc_wait on that epoch
+    before writing to the data again.
+ */
+unsigned long   gc_epoch(void);
+void            gc_wait(unsigned long epoch);
+
+
+/* RT thread only: the periods of engine e */
+void    gc_audio_begin(Engine* e);
+void    gc_audio_end(Engine* e);
+
+
+#endif /* __GC_H__ */
@@ -37,16 +37,22 @@
 #endif /* HAVE_JACK_SESSION_H */
 
 #include <pthread.h>
+#include <unistd.h>
 
 #include "instance.h"
 #include "petri-foo.h"
 #include "driver.h"
 #include "patch.h"
+#include "patch_util.h"
 #include "pf_error.h"
+#include "rtaudit.h"
 #include "mixer.h"
 #include "sync.h"
+#include "telemetry.h"
+#include "trace.h"
 #include "lfo.h"
 #include "midi_control.h"
+#include "worker.h"
 
 /* prototypes */
 static int start(void);
@@ -57,13 +63,13 @@ MIDI_CONTROL_H__CC_MAP_DEF
 
 
 /* file-global variables */
-static jack_port_t*     lport;
-static jack_port_t*     rport;
+static jack_port_t*     lport[MIXER_MAX_BUSES];
+static jack_port_t*     rport[MIXER_MAX_BUSES];
+static int              buses = 1;
 static jack_port_t*     midiport;
 
 
 static jack_client_t*   client = 0;
-static float*           buffer = 0;
 static int              rate = 44100;
 static int              periodsize = 2048;
 static int              running = 0;
@@ -72,6 +78,10 @@ static char*            session_uuid = NULL;
 
 static bool             autoconnect = false;
 
+/* the resampling the user had before freewheeling began */
+static bool             freewheel_fast_resample = true;
+static bool             freewheeling = false;
+
 #if HAVE_JACK_SESSION_H
 static bool             disable_jacksession = false;
 #else
@@ -97,12 +107,23 @@ void jackdriver_disable_jacksession(void)
 }
 
 
+static Tick period_time(void)
+{
+    return jack_last_frame_time(client);
+}
+
+
+static Tick frame_time(void)
+{
+    return jack_frame_time(client);
+}
+
+
 static int process(jack_nframes_t frames, void* arg)
 {
     (void)arg;
-    size_t i;
-    jack_sample_t* l = (jack_sample_t*)jack_port_get_buffer(lport, frames);
-    jack_sample_t* r = (jack_sample_t*)jack_port_get_buffer(rport, frames);
+    int i;
+    MixerBus bus[MIXER_MAX_BUSES];
     jack_position_t pos;
 
      /* MIDI data */
@@ -120,6 +141,20 @@ static int process(jack_nframes_t frames, void* arg)
     static float last_tempo = -1;
     float new_tempo;
      
+    /*  while freewheeling nobody is waiting on us, so rather than
+        render what fast loaded or evicted samples there are, wait
+        for the worker pool to finish upgrading and reloading them.
+        this is before the period starts (see gc_audio_begin) so the
+        jobs can publish without waiting on us in turn. */
+    if (__atomic_load_n(&freewheeling, __ATOMIC_RELAXED))
+    {
+        while (patch_sample_jobs_pending() > 0)
+            usleep(1000);
+    }
+
+    rt_audit_enter();
+    trace_begin("process", frames);
+
     /* behold: the jack_transport sync code */
     new_state = jack_transport_query (client, &pos);
 
@@ -181,13 +216,19 @@ static int process(jack_nframes_t frames, void* arg)
         event_index++;
     }
 
-    mixer_mixdown (buffer, frames);
-    for (i = 0; i < frames; i++)
+    /* the mixer renders straight into the ports */
+    for (i = 0; i < buses; i++)
     {
-        l[i] = buffer[i * 2];
-        r[i] = buffer[i * 2 + 1];
+        bus[i].left = (jack_sample_t*)jack_port_get_buffer(lport[i], frames);
+        bus[i].right = (jack_sample_t*)jack_port_get_buffer(rport[i],
+                                                                frames);
     }
 
+    mixer_mixdown (engine_default(), bus, buses, frames);
+
+    trace_end("process");
+    rt_audit_leave();
+
     return 0;
 }
 
@@ -200,23 +241,53 @@ static int sample_rate_change(jack_nframes_t r, void* arg)
 }
 
 
-static int buffer_size_change(jack_nframes_t b, void* arg)
+static int xrun(void* arg)
 {
     (void)arg;
-    float* new;
-    float* old;
+    telemetry_xrun(engine_default());
+    trace_instant("xrun", -1);
+    return 0;
+}
 
-    if ((new = malloc(sizeof(float) * b * 2)) == NULL)
+
+/*  freewheeling is JACK running us as fast as we can go, to bounce a
+    session, so there is no deadline to trade quality for: samples
+    are loaded at best quality straight away, the jobs upgrading
+    those already loaded fast get the worker pool before anything
+    else does, and process waits for them before each period.
+ */
+static void freewheel(int starting, void* arg)
+{
+    (void)arg;
+
+    if (starting)
+    {
+        freewheel_fast_resample = patch_get_fast_resample();
+        patch_set_fast_resample(false);
+        worker_set_urgent(true);
+    }
+    else
     {
-        pf_error(PF_ERR_JACK_BUF_SIZE_CHANGE);
-        stop();
+        patch_set_fast_resample(freewheel_fast_resample);
+        worker_set_urgent(false);
     }
 
-    old = buffer;
-    buffer = new;
+    __atomic_store_n(&freewheeling, (bool)starting, __ATOMIC_RELAXED);
+
+    trace_instant(starting ? "freewheel start" : "freewheel stop", -1);
+}
+
 
-    if (old != NULL)
-        free (old);
+static void thread_init(void* arg)
+{
+    (void)arg;
+    trace_thread_name("jack process");
+}
+
+
+static int buffer_size_change(jack_nframes_t b, void* arg)
+{
+    (void)arg;
 
     periodsize = b;
 
@@ -246,6 +317,8 @@ static int start(void)
 {
     const char* instancename = get_instance_name();
     jack_status_t status;
+    char name[32];
+    int i;
 
     if (!instancename)
         instancename = PACKAGE;
@@ -276,7 +349,7 @@ static int start(void)
     if (status & JackNameNotUnique)
         set_instance_name(jack_get_client_name(client));
 
-    mixer_set_jack_client(jackdriver_get_client());
+    mixer_set_clock(period_time, frame_time);
 
     jack_set_process_callback(client, process, 0);
 
@@ -294,17 +367,33 @@ static int start(void)
 
     jack_on_shutdown(client, shutdown, 0);
 
-    lport = jack_port_register( client,
-                                "out_left",
-                                JACK_DEFAULT_AUDIO_TYPE,
-                                JackPortIsOutput,
-                                0);
+    /* the first bus keeps the names it had before there were more */
+    buses = mixer_get_buses();
 
-    rport = jack_port_register( client,
-                                "out_right",
-                                JACK_DEFAULT_AUDIO_TYPE,
-                                JackPortIsOutput,
-                                0);
+    for (i = 0; i < buses; ++i)
+    {
+        if (i == 0)
+            snprintf(name, sizeof(name), "out_left");
+        else
+            snprintf(name, sizeof(name), "out_%d_left", i + 1);
+
+        lport[i] = jack_port_register(  client,
+                                        name,
+                                        JACK_DEFAULT_AUDIO_TYPE,
+                                        JackPortIsOutput,
+                                        0);
+
+        if (i == 0)
+            snprintf(name, sizeof(name), "out_right");
+        else
+            snprintf(name, sizeof(name), "out_%d_right", i + 1);
+
+        rport[i] = jack_port_register(  client,
+                                        name,
+                                        JACK_DEFAULT_AUDIO_TYPE,
+                                        JackPortIsOutput,
+                                        0);
+    }
 
     midiport = jack_port_register(  client,
                                     "midi_input",
@@ -319,14 +408,9 @@ static int start(void)
     periodsize = jack_get_buffer_size (client);
     driver_set_buffersize (periodsize);
     jack_set_buffer_size_callback (client, buffer_size_change, 0);
-
-    if ((buffer = malloc (sizeof (float) * periodsize * 2)) == NULL)
-    {
-        pf_error(PF_ERR_JACK_BUF_ALLOC);
-        jack_client_close (client);
-        pthread_mutex_unlock (&running_mutex);
-        return -1;
-    }
+    jack_set_xrun_callback (client, xrun, 0);
+    jack_set_freewheel_callback (client, freewheel, 0);
+    jack_set_thread_init_callback (client, thread_init, 0);
 
     mixer_flush();
 
@@ -345,14 +429,16 @@ static int start(void)
         if (ports)
         {
             if (!ports[0]
-             || jack_connect(client, jack_port_name(lport), ports[0]) != 0)
+             || jack_connect(client, jack_port_name(lport[0]),
+                                                        ports[0]) != 0)
             {
                 free(ports);
                 goto ac_full_fail;
             }
 
             if (!ports[1]
-             || jack_connect(client, jack_port_name(rport), ports[1]) != 0)
+             || jack_connect(client, jack_port_name(rport[0]),
+                                                        ports[1]) != 0)
             {
                 printf("failed to auto-connect to stereo h/w ports\n");
             }
@@ -387,9 +473,6 @@ static int stop(void)
         debug("JACK close..\n");
         jack_client_close (client);
         debug("JACK stopped\n");
-
-        if (buffer != NULL)
-            free (buffer);
     }
 
     running = 0;
@@ -440,7 +523,7 @@ jack_client_t*  jackdriver_get_client(void)
 }
 
 
-Driver jack_driver = {
+static Driver jack_driver = {
      init,
      start,
      stop,
@@ -449,3 +532,9 @@ Driver jack_driver = {
      getname,
      getid
 };
+
+
+int jackdriver_register(void)
+{
+    return driver_register(&jack_driver);
+}
@@ -35,6 +35,10 @@
 void jackdriver_set_session_cb(JackSessionCallback jacksession_cb);
 #endif
 
+/*  makes JACK the driver driver_start starts, to be called before
+    driver_init (see driver.h) */
+int             jackdriver_register(void);
+
 void            jackdriver_set_autoconnect(bool);
 void            jackdriver_set_uuid(char *uuid);
 jack_client_t*  jackdriver_get_client(void);
@@ -27,6 +27,7 @@
 #include "maths.h"
 #include "petri-foo.h"
 #include "driver.h"
+#include "engine_private.h"
 #include "patch.h"
 #include "sync.h"
 #include "ticks.h"
@@ -60,12 +61,6 @@ struct _LFO
 };
 
 
-/* sample rate we expect the world to be running at */
-static int samplerate = -1;
-
-static float sync_tempo = SYNC_DEFAULT_TEMPO;
-
-
 static float sin_tab[255];
 static float squ_tab[255];
 static float tri_tab[255];
@@ -74,13 +69,14 @@ static float saw_tab[255];
 
 inline static void lfo_phase_inc_from_freq (LFO* lfo, float freq)
 {
-     lfo->inc = (uint32_t)((255.0 * freq / samplerate) * (float)(1 << 24));
+     lfo->inc = (uint32_t)((255.0 * freq / current_engine->samplerate)
+                                                    * (float)(1 << 24));
 }
 
 
 inline static void lfo_phase_inc_from_beats (LFO* lfo, float beats)
 {
-     lfo_phase_inc_from_freq(lfo, (sync_tempo / 60.0) / beats);
+     lfo_phase_inc_from_freq(lfo, (current_engine->tempo / 60.0) / beats);
 }
 
 
@@ -186,17 +182,17 @@ void lfo_tables_init(void)
 
 void lfo_set_samplerate(int rate)
 {
-     samplerate = rate;
+     current_engine->samplerate = rate;
 }
 
 
 void lfo_set_tempo(float bpm)
 {
-     sync_tempo = bpm;
+     current_engine->tempo = bpm;
 }
 
 
-void lfo_update_params(LFO* lfo, LFOParams* params)
+void lfo_update_params(LFO* lfo, const LFOParams* params)
 {
     lfo->positive = params->positive;
 
@@ -235,7 +231,7 @@ void lfo_update_params(LFO* lfo, LFOParams* params)
 }
 
 
-void lfo_trigger(LFO* lfo, LFOParams* params)
+void lfo_trigger(LFO* lfo, const LFOParams* params)
 {
     lfo_update_params(lfo, params);
     lfo->phase = 0;
@@ -105,8 +105,8 @@ void    lfo_init(LFO*);
 /* activate an LFO using the given params; an LFO must be re-activated
  * after the samplerate/tempo changes in order for those changes to
  * take effect */
-void    lfo_trigger(LFO*, LFOParams*);
-void    lfo_update_params(LFO*, LFOParams*);
+void    lfo_trigger(LFO*, const LFOParams*);
+void    lfo_update_params(LFO*, const LFOParams*);
 
 /* advance an LFO and return its new value */
 float   lfo_tick(LFO*);
@@ -38,6 +38,7 @@
 #include "midi.h"
 #include "sync.h"
 #include "midi_control.h"
+#include "rtlog.h"
 
 
 static Atomic       running = 0;
@@ -63,8 +64,8 @@ static float calc_bpm(snd_seq_t* handle, int q)
 
     if (snd_seq_queue_tempo_get_tempo(tempo) == 0)
     {
-        errmsg ("about to encounter a floating point exception\n");
-        errmsg ("bailing out and providing an arbitrary tempo of 120.0\n");
+        rtlog(RTLOG_WARNING, "MIDI queue tempo is zero, "
+                             "using an arbitrary tempo of 120.0\n");
         return 120.0;
     }
 
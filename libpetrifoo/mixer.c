@@ -22,26 +22,31 @@
 */
 
 
-#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "mixer.h"
+#include "engine_private.h"
 #include "patch.h"
 #include "petri-foo.h"
-#include "pf_error.h"
 #include "driver.h"
-#include "sample.h"
+#include "gc.h"
+#include "preview.h"
+#include "telemetry.h"
+#include "trace.h"
 #include "maths.h"
 #include "ticks.h"
 #include "lfo.h"
 #include "patch_util.h"
-#include "jackdriver.h"
 #include "midi_control.h"
 
 
 /* magic numbers */
 enum
 {
-    EVENTMAX = 1024,
+    EVENTMAX = 1024,    /* must be a power of two */
 };
 
 
@@ -58,6 +63,14 @@ typedef enum
 MixerEventType;
 
 
+/* for the trace */
+static const char* event_names[] =
+{
+    "event", "note on", "note off", "note on (id)", "note off (id)",
+    "control", "pitch bend"
+};
+
+
 typedef struct
 {
     int     chan;
@@ -101,198 +114,358 @@ typedef struct _Event
 } Event;
 
 
-/* special structure for previewing samples */
-typedef struct _MixerPreview
+/*  slot in the queue of incoming events. seq tells whose turn it is:
+ *  equal to the slot's position it is free for the producer who claims
+ *  that position, one more than that it holds an event for the mixer.
+ */
+typedef struct _EventCell
+{
+    unsigned long   seq;
+    Event           event;
+
+} EventCell;
+
+
+/* one for each engine (see engine.h) */
+struct _MixerState
 {
-     Atomic     active;
-     Sample*    sample;
-     int        next_frame;
+    float           amplitude;      /* master amplitude */
+
+    /*  incoming from the MIDI and GUI threads: a bounded queue which
+     *  any number of threads may write to at once but only the audio
+     *  thread reads from (and never waits on).
+     */
+    EventCell       events[EVENTMAX];
+    unsigned long   enqueue_pos;    /* next position to write */
+    unsigned long   dequeue_pos;    /* next position to read */
+    bool            events_discard;
+
+    /* events taken off the queue, waiting to be played by the mixdown */
+    Event           batch[EVENTMAX];
+    int             batch_end;
+
+    MixerEventStats event_stats;
+
+    Event           direct_events[EVENTMAX]; /* incoming from audio
+                                                thread              */
+    int             direct_events_end;
+    int             samplerate;
+    int             buses;
+
+    MixerClock      clock_period;
+    MixerClock      clock_now;
+};
 
-     pthread_mutex_t mutex;
 
-} MixerPreview;
+MixerState      mixer_state_default = { .samplerate = -1, .buses = 1 };
 
 
-/* general variables */
-static float            amplitude = 0.0;    /* master amplitude */
-static MixerPreview     preview;            /* current preview sample */
-static Event            events[EVENTMAX];   /* incoming from MIDI thread */
+/*  events from other threads are stamped with the frame they arrive
+ *  at (as near as the driver can tell) rather than the start of the
+ *  period they arrive in. the mixdown plays the events of one period
+ *  at the same offsets into the next, so they keep their timing to
+ *  the frame at the cost of one period's latency.
+ */
+inline static Tick event_time(void)
+{
+    MixerState* ms = current_engine->mixer;
 
-static Event* volatile  writer = events;
-static Event* volatile  reader = events;
+    return ms->clock_now ? ms->clock_now() : 0;
+}
 
-static Event            direct_events[EVENTMAX]; /* incoming from audio
-                                                    thread              */
 
-static int              direct_events_end;
-static int              samplerate = -1;
+/*  where ticks falls in the period starting at start. frame times
+ *  wrap, so they are only ever compared by their difference. anything
+ *  stamped before the period (ie stale, from before a wrap or a clock
+ *  jump) is due at its start, and anything impossibly far ahead is
+ *  due now too, so that no event can hold up those behind it.
+ */
+inline static int event_offset(Tick ticks, Tick start, int frames)
+{
+    int32_t offset = (int32_t)(ticks - start);
 
-static jack_client_t*   jc;
+    if (offset < 0 || offset > 2 * frames)
+        return 0;
 
+    return offset;
+}
 
 
-inline static void advance_reader(void)
+static void events_init(MixerState* ms)
 {
-     reader = (reader + 1 >= events + EVENTMAX) ? events : reader + 1;
+    unsigned long i;
+
+    for (i = 0; i < EVENTMAX; ++i)
+        ms->events[i].seq = i;
+
+    ms->enqueue_pos = ms->dequeue_pos = 0;
 }
 
 
-inline static void advance_writer(void)
+/* queues a copy of ev, or drops it and counts it if the queue is full */
+static void queue_event(const Event* ev)
 {
-     writer = (writer + 1 >= events + EVENTMAX) ? events : writer + 1;
+    MixerState* ms = current_engine->mixer;
+    EventCell* cell;
+    unsigned long pos = __atomic_load_n(&ms->enqueue_pos, __ATOMIC_RELAXED);
+    long diff;
+
+    for (;;)
+    {
+        cell = &ms->events[pos & (EVENTMAX - 1)];
+        diff = (long)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0)
+        {   /* free, unless another producer gets there first */
+            if (__atomic_compare_exchange_n(&ms->enqueue_pos, &pos, pos + 1,
+                                            true,   __ATOMIC_RELAXED,
+                                                    __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+        {   /* not yet read by the mixer: full */
+            __atomic_add_fetch(&ms->event_stats.dropped, 1,
+                                                    __ATOMIC_RELAXED);
+            return;
+        }
+        else
+            pos = __atomic_load_n(&ms->enqueue_pos, __ATOMIC_RELAXED);
+    }
+
+    cell->event = *ev;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&ms->event_stats.queued, 1, __ATOMIC_RELAXED);
 }
 
 
-inline static void preview_render(float *buf, int frames)
+/* RT: moves the queued events into the batch, leaving any the batch
+ * hasn't room for until next time */
+inline static void drain_events(MixerState* ms)
 {
-    int i, j;
+    EventCell* cell;
+    bool discard = __atomic_exchange_n(&ms->events_discard, false,
+                                                    __ATOMIC_ACQUIRE);
+    if (discard)
+        ms->batch_end = 0;
 
-    if (preview.active && pthread_mutex_trylock(&preview.mutex) == 0)
+    while (ms->batch_end < EVENTMAX || discard)
     {
-        if (preview.sample->sp != NULL)
-        {
-            float logamp = log_amplitude(DEFAULT_AMPLITUDE);
+        cell = &ms->events[ms->dequeue_pos & (EVENTMAX - 1)];
 
-            for (   i = 0, j = preview.next_frame * 2;
-                    i < frames * 2 && j < preview.sample->frames * 2;
-                    i++, j++)
-            {
-                buf[i] += preview.sample->sp[j] * logamp;
-            }
+        if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE)
+                                                != ms->dequeue_pos + 1)
+            break;
 
-            if ((preview.next_frame = j / 2) >= preview.sample->frames)
-            {
-                preview.active = 0;
-                sample_free_data(preview.sample);
-            }
-        }
-        else
-            preview.active = 0;
+        if (!discard)
+            ms->batch[ms->batch_end++] = cell->event;
+
+        __atomic_store_n(&cell->seq, ms->dequeue_pos + EVENTMAX,
+                                                    __ATOMIC_RELEASE);
+        __atomic_store_n(&ms->dequeue_pos, ms->dequeue_pos + 1,
+                                                    __ATOMIC_RELAXED);
+    }
 
-        pthread_mutex_unlock(&preview.mutex);
-     }
+    if (ms->batch_end > ms->event_stats.high_water)
+        __atomic_store_n(&ms->event_stats.high_water, ms->batch_end,
+                                                    __ATOMIC_RELAXED);
 }
 
 
 void mixer_flush(void)
 {
-    /* skip any queued ringbuffer events */
-    reader = writer;
+    MixerState* ms = current_engine->mixer;
+
+    /* have the mixer skip any queued events */
+    __atomic_store_n(&ms->events_discard, true, __ATOMIC_RELEASE);
 
     patch_flush_all();
+    preview_stop();
+}
 
-    /* stop any previews */
-    pthread_mutex_lock(&preview.mutex);
 
-    if (preview.active && preview.sample->sp)
-    {
-        /* this will "mark" the preview sample for deletion next
-         * mixdown */
-        preview.next_frame = preview.sample->frames;
-    }
+MixerState* mixer_state_new(void)
+{
+    MixerState* ms = malloc(sizeof(*ms));
+
+    if (!ms)
+        return 0;
+
+    memset(ms, 0, sizeof(*ms));
+    ms->amplitude = DEFAULT_AMPLITUDE;
+    ms->samplerate = -1;
+    ms->buses = 1;
+    events_init(ms);
+
+    return ms;
+}
+
 
-    pthread_mutex_unlock(&preview.mutex);
+void mixer_state_free(MixerState* ms)
+{
+    free(ms);
 }
 
 
 /* constructor */
 void mixer_init(void)
 {
+    MixerState* ms = current_engine->mixer;
+
     debug ("initializing mixer\n");
-    amplitude = DEFAULT_AMPLITUDE;
-    pthread_mutex_init (&preview.mutex, NULL);
-    preview.sample = sample_new();
+    ms->amplitude = DEFAULT_AMPLITUDE;
+    events_init(ms);
+    preview_init();
+}
+
+
+void mixer_set_clock(MixerClock period, MixerClock now)
+{
+    MixerState* ms = current_engine->mixer;
+
+    ms->clock_period = period;
+    ms->clock_now = now;
 }
 
 
-void mixer_set_jack_client(jack_client_t* client)
+void mixer_set_buses(int count)
 {
-    jc = client;
+    MixerState* ms = current_engine->mixer;
+
+    if (count < 1)
+        count = 1;
+    else if (count > MIXER_MAX_BUSES)
+        count = MIXER_MAX_BUSES;
+
+    ms->buses = count;
+}
+
+
+int mixer_get_buses(void)
+{
+    MixerState* ms = current_engine->mixer;
+
+    return ms->buses;
 }
 
 
-/* mix current soundscape into buf */
-void mixer_mixdown(float *buf, int frames)
+/* mix current soundscape into the buses */
+void mixer_mixdown(Engine* e, const MixerBus* bus, int count, int frames)
 {
-    Tick curticks = jack_last_frame_time(jc);
+    Engine* prev = current_engine;
+    MixerState* ms = e->mixer;
+    Tick curticks = ms->clock_period();
+    Tick start = curticks - frames;
     Event* event = NULL;
+    int offset;
     int wrote = 0;
     int write;
     int i;
+    int n;
+    int b = 0;
     int d = 0;
     float logvol = 0.0;
 
-    for (i = 0; i < frames * 2; i++)
-        buf[i] = 0.0;
+    /*  for the LFOs, ticks and whatever else works on the calling
+        thread's engine, should the driver not have selected it */
+    current_engine = e;
 
-    /* adjust the ticks in the direct events */
-    for (i = 0; i < direct_events_end; ++i)
-         direct_events[i].ticks += curticks - frames;
+    /* nothing published before this can be freed until gc_audio_end */
+    gc_audio_begin(e);
+    telemetry_period_begin();
+    trace_begin("mixdown", frames);
 
-    /* get the first event */
-    if (reader != writer)
+    for (n = 0; n < count; ++n)
     {
-        if (d < direct_events_end
-         && direct_events[d].ticks < reader->ticks)
-        {
-            event = &direct_events[d++];
-        }
-        else
-        {
-            event = reader;
-            advance_reader();
-        }
+        memset(bus[n].left, 0, sizeof(float) * frames);
+        memset(bus[n].right, 0, sizeof(float) * frames);
     }
-    else if (d < direct_events_end)
-        event = &direct_events[d++];
 
+    /* adjust the ticks in the direct events */
+    for (i = 0; i < ms->direct_events_end; ++i)
+         ms->direct_events[i].ticks += curticks - frames;
+
+    /*  take everything queued so far in one go. events stamped during
+        the last period are due now, any stamped after the start of
+        this one are held back for the next (see event_time) */
+    trace_begin("drain events", ms->batch_end);
+    drain_events(ms);
+    trace_end("drain events");
 
     /* process events */
-    while (event)
+    for (;;)
     {
-        if (event->ticks > curticks)
+        /* get next event */
+        if (b < ms->batch_end)
+        {
+            if (d < ms->direct_events_end
+             && event_offset(ms->direct_events[d].ticks, start, frames)
+                    < event_offset(ms->batch[b].ticks, start, frames))
+            {
+                event = &ms->direct_events[d];
+            }
+            else
+                event = &ms->batch[b];
+        }
+        else if (d < ms->direct_events_end)
+            event = &ms->direct_events[d];
+        else
+            break;
+
+        if ((offset = event_offset(event->ticks, start, frames)) > frames)
             break;
 
-        write = event->ticks - (curticks - frames + wrote);
+        if (event == &ms->batch[b])
+            ++b;
+        else
+            ++d;
+
+        write = offset - wrote;
 
         if (write > 0)
         {
-            patch_render(buf + wrote*2, write);
+            patch_render(e, bus, count, wrote, write);
             wrote += write;
         }
 
+        trace_begin(event_names[event->type], offset);
+
         switch (event->type)
         {
         case MIXER_NOTEON:
-            patch_trigger(  event->note.chan,
+            patch_trigger(  e,
+                            event->note.chan,
                             event->note.note,
                             event->note.vel,
                             event->ticks);
             break;
 
         case MIXER_NOTEON_WITH_ID:
-            patch_trigger_with_id(  event->id_note.id,
+            patch_trigger_with_id(  e,
+                                    event->id_note.id,
                                     event->id_note.note,
                                     event->id_note.vel,
                                     event->ticks);
             break;
 
         case MIXER_NOTEOFF:
-            patch_release(event->note.chan, event->note.note);
+            patch_release(e, event->note.chan, event->note.note);
             break;
 
         case MIXER_NOTEOFF_WITH_ID:
-            patch_release_with_id(event->id_note.id, event->id_note.note);
+            patch_release_with_id(e, event->id_note.id,
+                                      event->id_note.note);
             break;
 
         case MIXER_CONTROL:
-            patch_control(  event->control.chan,
+            patch_control(  e,
+                            event->control.chan,
                             event->control.param,
                             event->control.value);
             break;
 
         case MIXER_PITCH_BEND:
-            patch_control(  event->control.chan,
+            patch_control(  e,
+                            event->control.chan,
                             CC_PITCH_WHEEL,
                             event->control.value);
             break;
@@ -301,110 +474,144 @@ void mixer_mixdown(float *buf, int frames)
             break;
         }
 
-        /* get next event */
-        if (reader != writer)
-        {
-            if (d < direct_events_end
-             && direct_events[d].ticks < reader->ticks)
-            {
-                event = &direct_events[d++];
-            }
-            else
-            {
-                event = reader;
-                advance_reader();
-            }
-        }
-        else if (d < direct_events_end)
-            event = &direct_events[d++];
-        else
-            event = NULL;
+        trace_end(event_names[event->type]);
     }
 
+    /* events not due yet wait for the next period */
+    for (i = 0; b + i < ms->batch_end; ++i)
+        ms->batch[i] = ms->batch[b + i];
+
+    ms->batch_end = i;
+
     /* reset the direct event buffer */
-    direct_events_end = 0;
+    ms->direct_events_end = 0;
 
     if (wrote < frames)
-        patch_render(buf + wrote*2, frames - wrote);
+        patch_render(e, bus, count, wrote, frames - wrote);
 
-    preview_render(buf, frames);
+    /* there is the one preview, for the default engine */
+    if (ms == &mixer_state_default)
+    {
+        trace_begin("preview", -1);
+        preview_render(bus[0].left, bus[0].right, frames,
+                                    log_amplitude(DEFAULT_AMPLITUDE));
+        trace_end("preview");
+    }
 
     /* scale to master amplitude */
-    logvol = log_amplitude(amplitude);
+    logvol = log_amplitude(ms->amplitude);
+
+    for (n = 0; n < count; ++n)
+    {
+        for (i = 0; i < frames; i++)
+        {
+            bus[n].left[i] *= logvol;
+            bus[n].right[i] *= logvol;
+        }
+    }
+
+    trace_end("mixdown");
+    telemetry_period_end(frames, ms->samplerate);
+    gc_audio_end(e);
 
-    for (i = 0; i < frames * 2; i++)
-        buf[i] *= logvol;
+    current_engine = prev;
 }
 
 
 /* queue a note-off event */
 void mixer_note_off(int chan, int note)
 {
-    writer->type = MIXER_NOTEOFF;
-    writer->ticks = jack_last_frame_time(jc);
-    writer->note.chan = chan;
-    writer->note.note = note;
-    advance_writer();
+    Event ev;
+    ev.type = MIXER_NOTEOFF;
+    ev.ticks = event_time();
+    ev.note.chan = chan;
+    ev.note.note = note;
+    queue_event(&ev);
 }
 
 
 /* queue a note-off event by patch id */
 void mixer_note_off_with_id(int id, int note)
 {
-    writer->type = MIXER_NOTEOFF_WITH_ID;
-    writer->ticks = jack_last_frame_time(jc);
-    writer->id_note.id = id;
-    writer->id_note.note = note;
-    advance_writer();
+    Event ev;
+    ev.type = MIXER_NOTEOFF_WITH_ID;
+    ev.ticks = event_time();
+    ev.id_note.id = id;
+    ev.id_note.note = note;
+    queue_event(&ev);
 }
 
 
 /* queue a note-on event */
 void mixer_note_on(int chan, int note, float vel)
 {
-    writer->type = MIXER_NOTEON;
-    writer->ticks = jack_last_frame_time(jc);
-    writer->note.chan = chan;
-    writer->note.note = note;
-    writer->note.vel = vel;
-    advance_writer();
+    Event ev;
+    ev.type = MIXER_NOTEON;
+    ev.ticks = event_time();
+    ev.note.chan = chan;
+    ev.note.note = note;
+    ev.note.vel = vel;
+    queue_event(&ev);
 }
 
 
 /* queue a note-on event by patch id */
 void mixer_note_on_with_id(int id, int note, float vel)
 {
-    writer->type = MIXER_NOTEON_WITH_ID;
-    writer->ticks = jack_last_frame_time(jc);
-    writer->id_note.id = id;
-    writer->id_note.note = note;
-    writer->id_note.vel = vel;
-    advance_writer();
+    Event ev;
+    ev.type = MIXER_NOTEON_WITH_ID;
+    ev.ticks = event_time();
+    ev.id_note.id = id;
+    ev.id_note.note = note;
+    ev.id_note.vel = vel;
+    queue_event(&ev);
 }
 
 
 /* queue control change event */
 void mixer_control(int chan, int param, float value)
 {
-    writer->type = MIXER_CONTROL;
-    writer->ticks = jack_last_frame_time(jc);
-    writer->control.chan = chan;
-    writer->control.param = param;
-    writer->control.value = value;
-    advance_writer();
+    Event ev;
+    ev.type = MIXER_CONTROL;
+    ev.ticks = event_time();
+    ev.control.chan = chan;
+    ev.control.param = param;
+    ev.control.value = value;
+    queue_event(&ev);
+}
+
+
+void mixer_get_event_stats(MixerEventStats* stats)
+{
+    MixerState* ms = current_engine->mixer;
+
+    stats->queued = __atomic_load_n(&ms->event_stats.queued,
+                                                    __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&ms->event_stats.dropped,
+                                                    __ATOMIC_RELAXED);
+    stats->high_water = __atomic_load_n(&ms->event_stats.high_water,
+                                                    __ATOMIC_RELAXED);
+    stats->depth = __atomic_load_n(&ms->enqueue_pos, __ATOMIC_RELAXED)
+                 - __atomic_load_n(&ms->dequeue_pos, __ATOMIC_RELAXED);
+
+    if (stats->depth < 0)   /* read mid-update */
+        stats->depth = 0;
 }
 
 
 /* queue a note-off event from the audio thread */
 void mixer_direct_note_off(int chan, int note, Tick tick)
 {
-    if (direct_events_end < EVENTMAX)
+    MixerState* ms = current_engine->mixer;
+    Event* ev;
+
+    if (ms->direct_events_end < EVENTMAX)
     {
-        direct_events[direct_events_end].type = MIXER_NOTEOFF;
-        direct_events[direct_events_end].ticks = tick;
-        direct_events[direct_events_end].note.chan = chan;
-        direct_events[direct_events_end].note.note = note;
-        ++direct_events_end;
+        ev = &ms->direct_events[ms->direct_events_end++];
+        ev->type = MIXER_NOTEOFF;
+        ev->ticks = tick;
+        ev->note.chan = chan;
+        ev->note.note = note;
     }
 }
 
@@ -412,14 +619,17 @@ void mixer_direct_note_off(int chan, int note, Tick tick)
 /* queue a note-on event from the audio thread */
 void mixer_direct_note_on(int chan, int note, float vel, Tick tick)
 {
-    if (direct_events_end < EVENTMAX)
+    MixerState* ms = current_engine->mixer;
+    Event* ev;
+
+    if (ms->direct_events_end < EVENTMAX)
     {
-        direct_events[direct_events_end].type = MIXER_NOTEON;
-        direct_events[direct_events_end].ticks = tick;
-        direct_events[direct_events_end].note.chan = chan;
-        direct_events[direct_events_end].note.note = note;
-        direct_events[direct_events_end].note.vel = vel;
-        ++direct_events_end;
+        ev = &ms->direct_events[ms->direct_events_end++];
+        ev->type = MIXER_NOTEON;
+        ev->ticks = tick;
+        ev->note.chan = chan;
+        ev->note.note = note;
+        ev->note.vel = vel;
     }
 }
 
@@ -427,14 +637,17 @@ void mixer_direct_note_on(int chan, int note, float vel, Tick tick)
 /* queue control change event from the audio thread */
 void mixer_direct_control(int chan, int param, float value, Tick tick)
 {
-    if (direct_events_end < EVENTMAX)
+    MixerState* ms = current_engine->mixer;
+    Event* ev;
+
+    if (ms->direct_events_end < EVENTMAX)
     {
-        direct_events[direct_events_end].type = MIXER_CONTROL;
-        direct_events[direct_events_end].ticks = tick;
-        direct_events[direct_events_end].control.chan = chan;
-        direct_events[direct_events_end].control.param = param;
-        direct_events[direct_events_end].control.value = value;
-        ++direct_events_end;
+        ev = &ms->direct_events[ms->direct_events_end++];
+        ev->type = MIXER_CONTROL;
+        ev->ticks = tick;
+        ev->control.chan = chan;
+        ev->control.param = param;
+        ev->control.value = value;
     }
 }
 
@@ -444,53 +657,30 @@ void mixer_preview(char *name,  int raw_samplerate,
                                     int sndfile_format,
                                     int resample_sndfile)
 {
-    pthread_mutex_lock(&preview.mutex);
-    preview.active = 0;
-
-    if (sample_load_file(preview.sample, name,  samplerate,
-                                                raw_samplerate,
-                                                raw_channels,
-                                                sndfile_format,
-                                                resample_sndfile) == -1)
-    {
-        /*  sample_load_file might call pf_error via sample_open etc
-            so we must call pf_error_get to reset any error that
-            might have occurred :-/
-        */
-        pf_error_get();
-        pthread_mutex_unlock(&preview.mutex);
-        return;
-    }
+    MixerState* ms = current_engine->mixer;
 
-    preview.next_frame = 0;
-    preview.active = 1;
-    pthread_mutex_unlock(&preview.mutex);
+    preview_start(name, ms->samplerate, raw_samplerate,
+                                    raw_channels,
+                                    sndfile_format,
+                                    resample_sndfile);
 }
 
 
 void mixer_flush_preview(void)
 {
-    /* stop any previews */
-    pthread_mutex_lock(&preview.mutex);
-
-    if (preview.active && preview.sample->sp)
-    {
-        /* this will "mark" the preview sample for deletion next
-         * mixdown */
-        preview.next_frame = preview.sample->frames;
-    }
-
-    pthread_mutex_unlock(&preview.mutex);
+    preview_stop();
 }
 
 
 /* set the master amplitude */
 int mixer_set_amplitude(float vol)
 {
+    MixerState* ms = current_engine->mixer;
+
     if (vol < 0.0 || vol > 1.0)
         return -1;
 
-    amplitude = vol;
+    ms->amplitude = vol;
 
     return 0;
 }
@@ -499,14 +689,18 @@ int mixer_set_amplitude(float vol)
 /* return the master amplitude */
 float mixer_get_amplitude(void)
 {
-    return amplitude;
+    MixerState* ms = current_engine->mixer;
+
+    return ms->amplitude;
 }
 
 
 /* set internally assumed samplerate */
 void mixer_set_samplerate(int rate)
 {
-    samplerate = rate;
+    MixerState* ms = current_engine->mixer;
+
+    ms->samplerate = rate;
 }
 
 
@@ -514,7 +708,7 @@ void mixer_set_samplerate(int rate)
 void mixer_shutdown(void)
 {
     debug ("shutting down...\n");
-    sample_free(preview.sample);
+    preview_shutdown();
     debug ("done\n");
 }
 
@@ -25,18 +25,60 @@
 #ifndef __MIXER_H__
 #define __MIXER_H__
 
+#include "engine.h"
 #include "ticks.h"
 
 
-#include <jack/jack.h>
+/* magic numbers */
+enum
+{
+    MIXER_MAX_BUSES = 8
+};
+
+
+/*  a stereo output for the mixdown to render into: a period's frames
+    for each side, laid out as JACK port buffers are */
+typedef struct _MixerBus
+{
+    float*  left;
+    float*  right;
+
+} MixerBus;
+
+
+/*  the note and control events queued by mixer_note_on and friends
+    (from any thread) on their way to the audio thread */
+typedef struct _MixerEventStats
+{
+    unsigned long   queued;     /* events queued */
+    unsigned long   dropped;    /* events lost to a full queue */
+    int             high_water; /* most events ever waiting at once */
+    int             depth;      /* events waiting for the audio thread
+                                   to take them now */
+
+} MixerEventStats;
 
 
 void    mixer_flush             (void);
 void    mixer_init              (void);
 
-void    mixer_set_jack_client   (jack_client_t*);
+/*  the driver's clock: period gives the frame the current period
+    started at (called only during mixer_mixdown), now the frame it
+    is now (called from any thread). */
+typedef Tick (*MixerClock)(void);
+
+void    mixer_set_clock         (MixerClock period, MixerClock now);
 
-void    mixer_mixdown           (float* buf, int frames);
+/*  the number of buses the driver is to give the mixdown, from one
+    to MIXER_MAX_BUSES. only takes effect when the driver is started.
+    patches sent to a bus the driver doesn't have play on the first. */
+void    mixer_set_buses         (int count);
+int     mixer_get_buses         (void);
+
+/*  RT thread only: renders a period of engine e into buses, with e
+    selected for the calling thread while it does */
+void    mixer_mixdown           (Engine* e, const MixerBus* buses,
+                                 int count, int frames);
 void    mixer_note_off          (int chan, int note);
 void    mixer_note_off_with_id  (int id,   int note);
 void    mixer_note_on           (int chan, int note,  float vel);
@@ -52,6 +94,8 @@ void    mixer_preview           (char* name,
                                     int resample_sndfile);
 void    mixer_flush_preview     (void);
 
+void    mixer_get_event_stats   (MixerEventStats*);
+
 int     mixer_set_amplitude     (float amplitude);
 float   mixer_get_amplitude     (void);
 void    mixer_set_samplerate    (int rate);
@@ -0,0 +1,174 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "offlinedriver.h"
+
+#include <stdlib.h>
+
+#include "petri-foo.h"
+#include "driver.h"
+#include "mixer.h"
+#include "pf_error.h"
+#include "rtaudit.h"
+
+
+static float*   buffer = 0;     /* interleaved, for the caller */
+static MixerBus bus = { 0, 0 };
+
+
+static int stop(void);
+static int      rate = 44100;
+static int      periodsize = 1024;
+static Tick     frame = 0;
+static int      running = 0;
+static Engine*  engine = 0;     /* the one started with */
+
+
+/*  the mixer plays events stamped during the period before last at
+    the same offsets into the period it is rendering (see event_time in
+    mixer.c). here there is no time between periods, so events queued
+    from other threads are stamped with the frame the next period
+    starts at, and the mixer told the period ends where it really does
+    so that they are played at its start. */
+static Tick period_time(void)
+{
+    return __atomic_load_n(&frame, __ATOMIC_RELAXED) + periodsize;
+}
+
+
+static Tick frame_time(void)
+{
+    return __atomic_load_n(&frame, __ATOMIC_RELAXED);
+}
+
+
+static void init(void)
+{
+}
+
+
+static int start(void)
+{
+    debug("offline driver starting at %d Hz, %d frames\n",
+                                                rate, periodsize);
+
+    if (!(buffer = malloc(sizeof(float) * periodsize * 2))
+     || !(bus.left = malloc(sizeof(float) * periodsize))
+     || !(bus.right = malloc(sizeof(float) * periodsize)))
+    {
+        pf_error(PF_ERR_JACK_BUF_ALLOC);
+        stop();
+        return -1;
+    }
+
+    frame = 0;
+    engine = engine_current();
+
+    driver_set_samplerate(rate);
+    driver_set_buffersize(periodsize);
+    mixer_set_clock(period_time, frame_time);
+    mixer_flush();
+
+    running = 1;
+
+    return 0;
+}
+
+
+static int stop(void)
+{
+    free(buffer);
+    free(bus.left);
+    free(bus.right);
+    buffer = bus.left = bus.right = 0;
+    running = 0;
+
+    return 0;
+}
+
+
+static int getrate(void)
+{
+    return rate;
+}
+
+
+static int getperiodsize(void)
+{
+    return periodsize;
+}
+
+
+static const char* getname(void)
+{
+    return "offline";
+}
+
+
+static void* getid(void)
+{
+    return (void*)PACKAGE;
+}
+
+
+void offline_driver_set_format(int r, int p)
+{
+    rate = r;
+    periodsize = p;
+}
+
+
+const float* offline_driver_render(void)
+{
+    int i;
+
+    if (!running)
+        return 0;
+
+    /* a single bus, the patches sent to any other play on it too */
+    rt_audit_enter();
+    mixer_mixdown(engine, &bus, 1, periodsize);
+    rt_audit_leave();
+
+    for (i = 0; i < periodsize; ++i)
+    {
+        buffer[i * 2] = bus.left[i];
+        buffer[i * 2 + 1] = bus.right[i];
+    }
+
+    __atomic_store_n(&frame, frame + periodsize, __ATOMIC_RELAXED);
+
+    return buffer;
+}
+
+
+Tick offline_driver_get_frame(void)
+{
+    return frame;
+}
+
+
+Driver offline_driver = {
+     init,
+     start,
+     stop,
+     getrate,
+     getperiodsize,
+     getname,
+     getid
+};
@@ -0,0 +1,52 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __OFFLINEDRIVER_H__
+#define __OFFLINEDRIVER_H__
+
+
+#include "ticks.h"
+
+
+/*  offline driver
+        runs the engine without an audio server or device. rather than
+        a callback from the audio hardware, the caller renders one
+        period at a time, as fast as it likes, by calling
+        offline_driver_render. the thread calling it *is* the audio
+        thread, and may use the mixer_direct_* functions to place
+        events within the period about to be rendered.
+
+        started with driver_start_named("offline").
+ */
+
+
+/* call before starting the driver */
+void    offline_driver_set_format(int rate, int periodsize);
+
+
+/*  renders the next period and returns it, interleaved stereo. there
+    is only the one bus, see mixer_set_buses. the buffer belongs to
+    the driver and is overwritten next call */
+const float*    offline_driver_render(void);
+
+
+/* frame the next period rendered will start at */
+Tick    offline_driver_get_frame(void);
+
+
+#endif /* __OFFLINEDRIVER_H__ */
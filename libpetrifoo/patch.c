@@ -25,7 +25,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <pthread.h>
 
 #include "petri-foo.h"
 #include "maths.h"
@@ -36,20 +35,18 @@
 #include "lfo.h"
 #include "driver.h" /* for DRIVER_DEFAULT_SAMPLERATE    */
 #include "midi.h"   /* for MIDI_CHANS                   */
+#include "telemetry.h"
+#include "rtlog.h"
+#include "trace.h"
 
 
+#include "engine_private.h"
+
 #include "patch_private/patch_data.h"
 #include "patch_private/patch_defs.h"
 #include "patch_private/patch_macros.h"
 
 
-/*  MIDI controller outputs 
- *      pitch wheel =           index 0
- *      CC x =                  index x + 1
- */
-static float cc[16][CC_ARR_SIZE];
-
-
 /**************************************************************************/
 /********************** PRIVATE GENERAL HELPER FUNCTIONS*******************/
 /**************************************************************************/
@@ -59,9 +56,89 @@ static float cc[16][CC_ARR_SIZE];
  *                          (see private/patch_data.h)
  */
 INLINE_PATCHOK_DEF
-INLINE_PATCH_LOCK_DEF
-INLINE_PATCH_TRYLOCK_DEF
-INLINE_PATCH_UNLOCK_DEF
+
+
+/*  patch_destroy may take a patch away from under the audio thread at
+ *  any time (the gc keeps it from being freed until the period is
+ *  over), so the audio thread takes each slot once, and checks it.
+ */
+inline static Patch* patch_rt_get(PatchState* ps, int id)
+{
+    return __atomic_load_n(&ps->patches[id], __ATOMIC_ACQUIRE);
+}
+
+
+/* (re)starts global LFO i from the parameters in the snapshot */
+inline static void patch_trigger_global_lfo(Patch* p, int i)
+{
+    const LFOParams* lfopar = &p->rt->glfo_params[i];
+    LFO* lfo = p->glfo[i];
+
+    lfo_set_fm1(lfo, patch_mod_id_to_pointer(lfopar->fm1_id, p, NULL));
+    lfo_set_fm2(lfo, patch_mod_id_to_pointer(lfopar->fm2_id, p, NULL));
+    lfo_set_am1(lfo, patch_mod_id_to_pointer(lfopar->am1_id, p, NULL));
+    lfo_set_am2(lfo, patch_mod_id_to_pointer(lfopar->am2_id, p, NULL));
+    lfo_trigger(lfo, lfopar);
+}
+
+
+/*  the audio thread never locks a patch. everything it does with a
+ *  patch starts here, taking up the latest snapshot of the sample,
+ *  points and parameters (see PatchPlay in private/patch_data.h),
+ *  after which p->rt may be used until the end of the period. the
+ *  global LFOs are the audio thread's alone, so it is here they are
+ *  updated from the snapshot's parameters.
+ */
+inline static void patch_play_sync(Patch* p)
+{
+    const PatchPlay* play = __atomic_load_n(&p->play, __ATOMIC_ACQUIRE);
+    unsigned int trigger_all = __atomic_load_n(&p->state->glfo_trigger,
+                                                    __ATOMIC_ACQUIRE);
+    int i;
+
+    p->rt = play;
+
+    if (trigger_all != p->rt_glfo_trigger_all)
+    {
+        for (i = 0; i < PATCH_MAX_LFOS; ++i)
+            patch_trigger_global_lfo(p, i);
+
+        p->rt_glfo_trigger_all = trigger_all;
+    }
+
+    if (play->serial == p->rt_serial)
+        return;
+
+    for (i = 0; i < PATCH_MAX_LFOS; ++i)
+    {
+        if (play->glfo_trigger[i] != p->rt_glfo_trigger[i])
+            patch_trigger_global_lfo(p, i);
+        else if (play->glfo_update[i] != p->rt_glfo_update[i])
+            lfo_update_params(p->glfo[i], &play->glfo_params[i]);
+
+        p->rt_glfo_trigger[i] = play->glfo_trigger[i];
+        p->rt_glfo_update[i] = play->glfo_update[i];
+    }
+
+    if (play->flush != p->rt_flush)
+    {
+        for (i = 0; i < PATCH_VOICE_COUNT; i++)
+            p->voices[i]->active = false;
+
+        p->rt_flush = play->flush;
+        __atomic_add_fetch(&patch_snapshot_stats.flushes, 1,
+                                                    __ATOMIC_RELAXED);
+    }
+
+    if (play->sample != p->rt_sample)
+    {
+        trace_instant("sample swap", play->sample->frames);
+        p->rt_sample = play->sample;
+    }
+
+    p->rt_serial = play->serial;
+    __atomic_add_fetch(&patch_snapshot_stats.updates, 1, __ATOMIC_RELAXED);
+}
 
 
 /**************************************************************************/
@@ -71,7 +148,7 @@ INLINE_PATCH_UNLOCK_DEF
 
 inline static void playstate_init_fade_in(Patch* p, PatchVoice* v)
 {
-    if (p->fade_samples)
+    if (p->rt->fade_samples)
     {
         v->playstate = PLAYSTATE_FADE_IN;
         v->fade_posi = 0;
@@ -88,24 +165,24 @@ inline static void playstate_init_fade_in(Patch* p, PatchVoice* v)
 
     if (p->play_mode & PATCH_PLAY_REVERSE)
     {
-        v->posi = p->play_stop;
+        v->posi = p->rt->play_stop;
         v->posf = 0;
         v->dir = -1;
-        v->fade_out_start_pos = p->play_start + p->fade_samples;
+        v->fade_out_start_pos = p->rt->play_start + p->rt->fade_samples;
     }
     else
     {
-        v->posi = p->play_start;
+        v->posi = p->rt->play_start;
         v->posf = 0;
         v->dir = 1;
-        v->fade_out_start_pos = p->play_stop - p->fade_samples;
+        v->fade_out_start_pos = p->rt->play_stop - p->rt->fade_samples;
     }
 }
 
 
 inline static void playstate_init_x_fade(Patch* p, PatchVoice* v)
 {
-    if (!p->xfade_samples)
+    if (!p->rt->xfade_samples)
         return;
 
     v->xfade = true;
@@ -123,7 +200,7 @@ inline static void playstate_init_fade_out(Patch* p, PatchVoice* v)
     if (v->playstate == PLAYSTATE_FADE_OUT)
         return;
 
-    if (!p->fade_samples)
+    if (!p->rt->fade_samples)
     {
         v->playstate = PLAYSTATE_OFF;
         v->fade_declick = 0.0;
@@ -132,7 +209,7 @@ inline static void playstate_init_fade_out(Patch* p, PatchVoice* v)
 
     if (v->playstate == PLAYSTATE_FADE_IN)
     {
-        v->fade_posi = p->fade_samples - v->fade_posi;
+        v->fade_posi = p->rt->fade_samples - v->fade_posi;
     }
     else
     {
@@ -159,7 +236,7 @@ inline static void patch_release_patch(Patch* p, int note, release_t mode)
              * advance( ); we just tell it *when* to release */
             p->voices[i]->relmode = mode;
             p->voices[i]->relset = (p->mono && p->voices[i]->legato)
-                                        ? patch_legato_lag
+                                        ? p->state->legato_lag
                                         : 0;
         }
     }
@@ -179,12 +256,10 @@ inline static void patch_cut_patch (Patch* p)
 
     for (i = 0; i < PATCH_COUNT; i++)
     {
-        if (patches[i]
-         && patches[i]->active
-         && patches[i]->cut_by == p->cut)
-        {
-            patch_release_patch(patches[i], -69, RELEASE_CUTOFF);
-        }
+        Patch* q = patch_rt_get(p->state, i);
+
+        if (q && q->active && q->cut_by == p->cut)
+            patch_release_patch(q, -69, RELEASE_CUTOFF);
     }
 }
 
@@ -193,6 +268,8 @@ inline static void patch_cut_patch (Patch* p)
 inline static void prepare_pitch(Patch* p, PatchVoice* v, int note)
 {
     double scale; /* base pitch scaling factor */
+    double pitch;
+    const Sample* s;
 
     /* this applies the tuning factor */
     scale = pow(2, (p->pitch.val * p->pitch_steps) / 12.0);
@@ -222,6 +299,15 @@ inline static void prepare_pitch(Patch* p, PatchVoice* v, int note)
         v->porta_ticks = 0;
     }
 
+    /* samples not resampled to our rate are played back faster or
+     * slower by however much their rate differs from ours */
+    s = p->rt->sample;
+
+    if (s->samplerate > 0 && s->samplerate != p->state->samplerate)
+        v->rate_ratio = s->samplerate / (double)p->state->samplerate;
+    else
+        v->rate_ratio = 1.0;
+
     /* store the note that called us as the last note that was played
      * (it's important that we do this *after* we use the
      * p->last_note variable, otherwise we'll be comparing ourself
@@ -229,8 +315,9 @@ inline static void prepare_pitch(Patch* p, PatchVoice* v, int note)
     p->last_note = note;
 
     /* give our step variables their initial values */
-    v->stepi = v->pitch;
-    v->stepf = (v->pitch - v->stepi) * (0xFFFFFFFFU); /* max of guint32 */
+    pitch = v->pitch * v->rate_ratio;
+    v->stepi = pitch;
+    v->stepf = (pitch - v->stepi) * (0xFFFFFFFFU); /* max of guint32 */
 }
 
 
@@ -267,8 +354,15 @@ patch_trigger_patch (Patch* p, int note, float vel, Tick ticks)
     int index;          /* the index we ended up settling on */
     float key_track;
     bool legato;
+    const Sample* s;
+
+    /* an evicted sample is reloaded once it's wanted again */
+    __atomic_store_n(&p->last_used, p->state->notes, __ATOMIC_RELAXED);
 
-    if (p->sample->sp == NULL)
+    patch_play_sync(p);
+    s = p->rt->sample;
+
+    if (s->sp == NULL)
         return;
 
     if (p->upper_note == p->lower_note)
@@ -330,7 +424,14 @@ patch_trigger_patch (Patch* p, int note, float vel, Tick ticks)
 
         /* take the oldest running voice's slot if we couldn't find an
          * empty one */
-        index = (i == PATCH_VOICE_COUNT) ? oldest : i;
+        if (i == PATCH_VOICE_COUNT)
+        {
+            index = oldest;
+            telemetry_voice_stolen();
+            trace_instant("voice steal", p->voices[oldest]->note);
+        }
+        else
+            index = i;
     }
 
     v = p->voices[index];
@@ -375,34 +476,38 @@ patch_trigger_patch (Patch* p, int note, float vel, Tick ticks)
 
     for (i = 0; i < VOICE_MAX_ENVS; i++)
     {
-        if (p->env_params[i].active)
+        if (p->rt->env_params[i].active)
         {
-            adsr_set_params(v->env[i], &p->env_params[i]);
+            adsr_set_params(v->env[i], &p->rt->env_params[i]);
             adsr_trigger(v->env[i], key_track, vel);
         }
     }
 
     for (i = 0; i < VOICE_MAX_LFOS; i++)
     {
-        if (p->vlfo_params[i].active)
+        const LFOParams* lfopar = &p->rt->vlfo_params[i];
+
+        if (lfopar->active)
         {
             float const* src;
 
-            src = patch_mod_id_to_pointer(p->vlfo_params[i].fm1_id, p, v);
+            src = patch_mod_id_to_pointer(lfopar->fm1_id, p, v);
             lfo_set_fm1(v->lfo[i], src);
-            src = patch_mod_id_to_pointer(p->vlfo_params[i].fm2_id, p, v);
+            src = patch_mod_id_to_pointer(lfopar->fm2_id, p, v);
             lfo_set_fm2(v->lfo[i], src);
 
-            src = patch_mod_id_to_pointer(p->vlfo_params[i].am1_id, p, v);
+            src = patch_mod_id_to_pointer(lfopar->am1_id, p, v);
             lfo_set_am1(v->lfo[i], src);
-            src = patch_mod_id_to_pointer(p->vlfo_params[i].am2_id, p, v);
+            src = patch_mod_id_to_pointer(lfopar->am2_id, p, v);
             lfo_set_am2(v->lfo[i], src);
-            lfo_trigger(v->lfo[i], &p->vlfo_params[i]);
+            lfo_trigger(v->lfo[i], lfopar);
         }
     }
 
     /* mark our territory */
     v->active = true;
+
+    trace_instant("voice trigger", note);
 }
 
 
@@ -410,7 +515,8 @@ patch_trigger_patch (Patch* p, int note, float vel, Tick ticks)
  *  for a frame
  */
 inline static void
-pitchscale (Patch * p, PatchVoice * v, float *l, float *r)
+pitchscale (Patch * p, const Sample* s, PatchVoice * v,
+                                                    float *l, float *r)
 {
     int y0, y1, y2, y3;
 
@@ -420,25 +526,25 @@ pitchscale (Patch * p, PatchVoice * v, float *l, float *r)
     y2 = (v->posi + 1 * v->dir) * 2;
     y3 = (v->posi + 2 * v->dir) * 2;
 
-    if (y0 < 0 || y0 >= p->sample->frames * 2)
+    if (y0 < 0 || y0 >= s->frames * 2)
         y0 = 0;
 
-    if (y2 < 0 || y2 >= p->sample->frames * 2)
+    if (y2 < 0 || y2 >= s->frames * 2)
         y2 = 0;
 
-    if (y3 < 0 || y3 >= p->sample->frames * 2)
+    if (y3 < 0 || y3 >= s->frames * 2)
         y3 = 0;
 
     /* interpolate */
-    *l = cerp(  p->sample->sp[y0],
-                p->sample->sp[y1],
-                p->sample->sp[y2],
-                p->sample->sp[y3],      v->posf >> 24);
+    *l = cerp(  s->sp[y0],
+                s->sp[y1],
+                s->sp[y2],
+                s->sp[y3],      v->posf >> 24);
 
-    *r = cerp(  p->sample->sp[y0 + 1],
-                p->sample->sp[y1 + 1],
-                p->sample->sp[y2 + 1],
-                p->sample->sp[y3 + 1],  v->posf >> 24);
+    *r = cerp(  s->sp[y0 + 1],
+                s->sp[y1 + 1],
+                s->sp[y2 + 1],
+                s->sp[y3 + 1],  v->posf >> 24);
 
     if (v->xfade)
     {
@@ -452,36 +558,36 @@ pitchscale (Patch * p, PatchVoice * v, float *l, float *r)
         y2 = (v->xfade_point_posi + 1 * v->xfade_dir) * 2;
         y3 = (v->xfade_point_posi + 2 * v->xfade_dir) * 2;
 
-        if (y0 < 0 || y0 >= p->sample->frames * 2)
+        if (y0 < 0 || y0 >= s->frames * 2)
             y0 = 0;
 
-        if (y1 < 0 || y1 >= p->sample->frames * 2)
+        if (y1 < 0 || y1 >= s->frames * 2)
         {
-            debug("xfade:%s xfade_point_posi out of range:%d frames:%d\n",
-                    (v->xfade ? "YES" : "NO"),
-                    v->xfade_point_posi, p->sample->frames);
-            debug("xfade_samples:%d xfade_posi:%d\n",
-                    p->xfade_samples, v->xfade_posi);
+            rtdebug("xfade:%s xfade_point_posi out of range:%d "
+                    "frames:%d\n", (v->xfade ? "YES" : "NO"),
+                    v->xfade_point_posi, s->frames);
+            rtdebug("xfade_samples:%d xfade_posi:%d\n",
+                    p->rt->xfade_samples, v->xfade_posi);
             y1 = 0;
         }
 
-        if (y2 < 0 || y2 >= p->sample->frames * 2)
+        if (y2 < 0 || y2 >= s->frames * 2)
             y2 = 0;
 
-        if (y3 < 0 || y3 >= p->sample->frames * 2)
+        if (y3 < 0 || y3 >= s->frames * 2)
             y3 = 0;
 
         /* interpolate */
-        *l += cerp( p->sample->sp[y0],
-                    p->sample->sp[y1],
-                    p->sample->sp[y2],
-                    p->sample->sp[y3],      v->xfade_point_posf >> 24)
+        *l += cerp( s->sp[y0],
+                    s->sp[y1],
+                    s->sp[y2],
+                    s->sp[y3],      v->xfade_point_posf >> 24)
                                             * (1.0 - v->xfade_declick);
 
-        *r += cerp( p->sample->sp[y0 + 1],
-                    p->sample->sp[y1 + 1],
-                    p->sample->sp[y2 + 1],
-                    p->sample->sp[y3 + 1],  v->xfade_point_posf >> 24)
+        *r += cerp( s->sp[y0 + 1],
+                    s->sp[y1 + 1],
+                    s->sp[y2 + 1],
+                    s->sp[y3 + 1],  v->xfade_point_posf >> 24)
                                             * (1.0 - v->xfade_declick);
     }
 }
@@ -778,6 +884,7 @@ inline static int advance (Patch* p, PatchVoice* v, int index)
 
     if (recalc)
     {
+        pitch *= v->rate_ratio;
         v->stepi = pitch;
         v->stepf = (pitch - v->stepi) * (0xFFFFFFFFU);
     }
@@ -790,13 +897,13 @@ inline static int advance (Patch* p, PatchVoice* v, int index)
     {
         advance_fwd(&v->fade_posi, &v->fade_posf, v->stepi, v->stepf);
 
-        if (v->fade_posi >= p->fade_samples)
+        if (v->fade_posi >= p->rt->fade_samples)
         {
            v->playstate = PLAYSTATE_PLAY;
             v->fade_declick = 1.0;
         }
         else
-            v->fade_declick = ((float)v->fade_posi / p->fade_samples);
+            v->fade_declick = ((float)v->fade_posi / p->rt->fade_samples);
     }
 
     if (v->loop)
@@ -804,30 +911,30 @@ inline static int advance (Patch* p, PatchVoice* v, int index)
         /* adjust our indices according to our play mode */
         if (p->play_mode & PATCH_PLAY_PINGPONG)
         {
-            if ((v->dir > 0) && (v->posi >= p->loop_stop))
+            if ((v->dir > 0) && (v->posi >= p->rt->loop_stop))
             {
                 playstate_init_x_fade(p, v);
-                v->posi = p->loop_stop;
+                v->posi = p->rt->loop_stop;
                 v->dir = -1;
             }
-            else if ((v->dir < 0) && (v->posi <= p->loop_start))
+            else if ((v->dir < 0) && (v->posi <= p->rt->loop_start))
             {
                 playstate_init_x_fade(p, v);
-                v->posi = p->loop_start;
+                v->posi = p->rt->loop_start;
                 v->dir = 1;
             }
         }
         else
         {
-            if ((v->dir > 0) && (v->posi >= p->loop_stop))
+            if ((v->dir > 0) && (v->posi >= p->rt->loop_stop))
             {
                 playstate_init_x_fade(p, v);
-                v->posi = p->loop_start;
+                v->posi = p->rt->loop_start;
             }
-            else if ((v->dir < 0) && (v->posi <= p->loop_start))
+            else if ((v->dir < 0) && (v->posi <= p->rt->loop_start))
             {
                 playstate_init_x_fade(p, v);
-                v->posi = p->loop_stop;
+                v->posi = p->rt->loop_stop;
             }
         }
     }
@@ -856,7 +963,7 @@ inline static int advance (Patch* p, PatchVoice* v, int index)
     {
         advance_fwd(&v->fade_posi, &v->fade_posf, v->stepi, v->stepf);
 
-        if (v->fade_posi >= p->fade_samples)
+        if (v->fade_posi >= p->rt->fade_samples)
         {
             v->playstate = PLAYSTATE_OFF;
             /*debug("fadeout end at %f\n", v->fade_declick);*/
@@ -864,7 +971,7 @@ inline static int advance (Patch* p, PatchVoice* v, int index)
             return -1;
         }
 
-        v->fade_declick = 1.0 - ((float)v->fade_posi / p->fade_samples);
+        v->fade_declick = 1.0 - ((float)v->fade_posi / p->rt->fade_samples);
     }
 
     if (v->xfade)
@@ -875,13 +982,13 @@ inline static int advance (Patch* p, PatchVoice* v, int index)
 
         advance_fwd(&v->xfade_posi, &v->xfade_posf, v->stepi, v->stepf);
 
-        if (v->xfade_posi >= p->xfade_samples)
+        if (v->xfade_posi >= p->rt->xfade_samples)
         {
             v->xfade = false;
             v->xfade_declick = 1.0;
         }
         else
-            v->xfade_declick = ((float)v->xfade_posi / p->xfade_samples);
+            v->xfade_declick = ((float)v->xfade_posi / p->rt->xfade_samples);
     }
 
     /* check to see if it's time to release
@@ -921,10 +1028,10 @@ inline static int advance (Patch* p, PatchVoice* v, int index)
                         {
                             if (v->dir == -1)
                                 v->fade_out_start_pos =
-                                        p->play_start + p->fade_samples;
+                                    p->rt->play_start + p->rt->fade_samples;
                             else
                                 v->fade_out_start_pos =
-                                        p->play_stop - p->fade_samples;
+                                    p->rt->play_stop - p->rt->fade_samples;
                         }
                     }
                 }
@@ -950,9 +1057,10 @@ inline static int advance (Patch* p, PatchVoice* v, int index)
 
 
 /*  a helper rountine to render all active voices of
-    a given patch into buf
+    a given patch into left and right
 */
-inline static void patch_render_patch (Patch* p, float* buf, int nframes)
+inline static void patch_render_patch (Patch* p, float* left, float* right,
+                                                            int nframes)
 {
     register int i;
     register int j;
@@ -960,14 +1068,20 @@ inline static void patch_render_patch (Patch* p, float* buf, int nframes)
     float l, r;
     bool done;
     register int k;
+    const Sample* s;
 
+    patch_play_sync(p);
+    s = p->rt->sample;
+
+    if (s->sp == NULL)
+        return;
 
     /*  calculate global LFO output tables first: */
     for (i = 0; i < nframes; ++i)
     {
         for (j = 0; j < PATCH_MAX_LFOS; ++j)
         {
-            if (p->glfo_params[j].active)
+            if (p->rt->glfo_params[j].active)
                 p->glfo_table[j][i] = lfo_tick(p->glfo[j]);
         }
     }
@@ -979,7 +1093,7 @@ inline static void patch_render_patch (Patch* p, float* buf, int nframes)
             continue;
 
         /* sanity check */
-        if (p->voices[i]->posi < p->sample->frames)
+        if (p->voices[i]->posi < s->frames)
             v = p->voices[i];
         else
         {
@@ -996,19 +1110,19 @@ inline static void patch_render_patch (Patch* p, float* buf, int nframes)
                 the correct value for the frame.
             */
             for (k = 0; k < PATCH_MAX_LFOS; ++k)
-                if (p->glfo_params[k].active)
+                if (p->rt->glfo_params[k].active)
                     lfo_set_output(p->glfo[k], p->glfo_table[k][j]);
 
             for (k = 0; k < VOICE_MAX_ENVS; ++k)
-                if (p->env_params[k].active)
+                if (p->rt->env_params[k].active)
                     adsr_tick(v->env[k]);
 
             for (k = 0; k < VOICE_MAX_LFOS; ++k)
-                if (p->vlfo_params[k].active)
+                if (p->rt->vlfo_params[k].active)
                     lfo_tick(v->lfo[k]);
 
             /* process samples */
-            pitchscale (p, v,    &l, &r);
+            pitchscale (p, s, v, &l, &r);
             pan        (p, v, j, &l, &r);
             filter     (p, v, j, &l, &r);
 
@@ -1017,8 +1131,8 @@ inline static void patch_render_patch (Patch* p, float* buf, int nframes)
             if (gain   (p, v, j, &l, &r) < 0)
                 done = true;
 
-            buf[j * 2] += l;
-            buf[j * 2 + 1] += r;
+            left[j] += l;
+            right[j] += r;
 
             /* advance our position and stop rendering if we
              * run out of samples */
@@ -1031,31 +1145,46 @@ inline static void patch_render_patch (Patch* p, float* buf, int nframes)
             v->active = false;
 
         /* overflows bad, OVERFLOWS BAD! */
-        if (v->active && (v->posi < 0 || v->posi >= p->sample->frames))
+        if (v->active && (v->posi < 0 || v->posi >= s->frames))
         {
-            debug ("overflow! NO! BAD CODE! DIE DIE DIE!\n");
-            debug ("v->posi == %d, p->sample.frames == %d\n",
-                    v->posi, p->sample->frames);
+            rtdebug("overflow! NO! BAD CODE! DIE DIE DIE!\n");
+            rtdebug("v->posi == %d, p->sample.frames == %d\n",
+                    v->posi, s->frames);
             v->active = 0;
         }
     }
 }
 
 
+inline static int patch_voices_active(const Patch* p)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < PATCH_VOICE_COUNT; i++)
+        if (p->voices[i]->active)
+            ++count;
+
+    return count;
+}
+
+
 /* deactivate all active patches matching given criteria */
-void patch_release (int chan, int note)
+void patch_release (Engine* e, int chan, int note)
 {
     int i;
 
     for (i = 0; i < PATCH_COUNT; i++)
     {
-        if (patches[i]
-         && patches[i]->active
-         && patches[i]->channel == chan
-         && (note >= patches[i]->lower_note
-         &&  note <= patches[i]->upper_note))
+        Patch* p = patch_rt_get(e->patch, i);
+
+        if (p
+         && p->active
+         && p->channel == chan
+         && (note >= p->lower_note
+         &&  note <= p->upper_note))
         {
-            patch_release_patch(patches[i], note, RELEASE_NOTEOFF);
+            patch_release_patch(p, note, RELEASE_NOTEOFF);
         }
     }
 
@@ -1064,51 +1193,61 @@ void patch_release (int chan, int note)
 
 
 /* deactivate a single patch with a given id */
-void patch_release_with_id (int id, int note)
+void patch_release_with_id (Engine* e, int id, int note)
 {
+    Patch* p;
+
     if (id < 0 || id >= PATCH_COUNT)
         return;
 
-    if (!patches[id]->active)
+    if (!(p = patch_rt_get(e->patch, id)) || !p->active)
         return;
 
-    patch_release_patch(patches[id], note, RELEASE_NOTEOFF);
+    patch_release_patch(p, note, RELEASE_NOTEOFF);
     return;
 }
 
 
-/* render nframes of all active patches into buf */
-void patch_render (float *buf, int nframes)
+/*  render nframes of all active patches, from offset frames into the
+    buses they are sent to */
+void patch_render (Engine* e, const MixerBus* buses, int count,
+                                        int offset, int nframes)
 {
+    unsigned long t;
     int i;
+    int b;
 
     /* render potatos */
     for (i = 0; i < PATCH_COUNT; i++)
     {
-        if (patches[i] && patches[i]->active)
+        Patch* p = patch_rt_get(e->patch, i);
+
+        if (p && p->active)
         {
-            if (patch_trylock (i) != 0)
-            {
-                continue;
-            }
+            t = telemetry_now_ns();
 
-            if (patches[i]->sample->sp == NULL)
-            {
-                patch_unlock(i);
-                continue;
-            }
+            /* on the first bus if the driver hasn't got the patch's */
+            if ((b = p->bus) >= count)
+                b = 0;
 
-            patch_render_patch(patches[i], buf, nframes);
-            patch_unlock(i);
+            trace_begin("render patch", i);
+            patch_render_patch(p, buses[b].left + offset,
+                                  buses[b].right + offset, nframes);
+            trace_end("render patch");
+
+            telemetry_patch_rendered(i, telemetry_now_ns() - t,
+                                        patch_voices_active(p));
         }
     }
 }
 
 
 /* triggers all patches matching criteria */
-void patch_trigger (int chan, int note, float vel, Tick ticks)
+void patch_trigger (Engine* e, int chan, int note, float vel,
+                                                    Tick ticks)
 {
-    static int idp[PATCH_COUNT]; /* holds all patches to be activated */
+    PatchState* ps = e->patch;
+    Patch* idp[PATCH_COUNT]; /* all patches to be activated */
     int i, j;
 
     /* We gather up all of the patches that need to be activated here
@@ -1119,71 +1258,114 @@ void patch_trigger (int chan, int note, float vel, Tick ticks)
      * stepping over each other before they both are heard.
      */
     int int_vel = (int)(vel * 127.0);
+
+    __atomic_store_n(&ps->channel_used[chan], ++ps->notes,
+                                                    __ATOMIC_RELAXED);
     for (i = j = 0; i < PATCH_COUNT; i++)
     {
-        if (patches[i]
-         && patches[i]->active
-         && patches[i]->channel == chan
-         && (note >= patches[i]->lower_note
-          && note <= patches[i]->upper_note)
-         && (int_vel >= patches[i]->lower_vel
-          && int_vel <= patches[i]->upper_vel))
+        Patch* p = patch_rt_get(ps, i);
+
+        if (p
+         && p->active
+         && p->channel == chan
+         && (note >= p->lower_note
+          && note <= p->upper_note)
+         && (int_vel >= p->lower_vel
+          && int_vel <= p->upper_vel))
         {
-            idp[j++] = i;
+            idp[j++] = p;
         }
     }
 
     /* do cuts */
     for (i = 0; i < j; i++)
-        patch_cut_patch(patches[idp[i]]);
+        patch_cut_patch(idp[i]);
 
     /* do triggers */
     for (i = 0; i < j; i++)
     {    
-        patch_trigger_patch(patches[idp[i]], note, vel, ticks);
+        patch_trigger_patch(idp[i], note, vel, ticks);
     }
 }
 
 
 /* activate a single patch with given id */
-void patch_trigger_with_id (int id, int note, float vel, Tick ticks)
+void patch_trigger_with_id (Engine* e, int id, int note, float vel,
+                                                    Tick ticks)
 {
+    Patch* p;
+
     if (id < 0 || id >= PATCH_COUNT)
         return;
 
-    if (!patches[id]->active)
+    if (!(p = patch_rt_get(e->patch, id)) || !p->active)
         return;
 
-    if (note < patches[id]->lower_note || note > patches[id]->upper_note)
+    if (note < p->lower_note || note > p->upper_note)
         return;
 
-    patch_cut_patch(patches[id]);
-    patch_trigger_patch(patches[id], note, vel, ticks);
+    ++e->patch->notes;
+    patch_cut_patch(p);
+    patch_trigger_patch(p, note, vel, ticks);
     return;
 }
 
 
+int patch_active_voices(void)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < PATCH_COUNT; i++)
+    {
+        Patch* p = patch_rt_get(current_engine->patch, i);
+
+        if (p && p->active)
+            count += patch_voices_active(p);
+    }
+
+    return count;
+}
+
+
+unsigned long patch_channel_last_used(int chan)
+{
+    return __atomic_load_n(&CUR_CHANNEL_USED[chan], __ATOMIC_RELAXED);
+}
+
+
+void patch_get_snapshot_stats(PatchSnapshotStats* stats)
+{
+    stats->published = __atomic_load_n(&patch_snapshot_stats.published,
+                                                    __ATOMIC_RELAXED);
+    stats->overlaps = __atomic_load_n(&patch_snapshot_stats.overlaps,
+                                                    __ATOMIC_RELAXED);
+    stats->updates = __atomic_load_n(&patch_snapshot_stats.updates,
+                                                    __ATOMIC_RELAXED);
+    stats->flushes = __atomic_load_n(&patch_snapshot_stats.flushes,
+                                                    __ATOMIC_RELAXED);
+}
+
+
 void patch_control_init(void)
 {
     int c, p;
 
     debug("initializing control change array\n");
 
-    patch_set_control_array(&cc);
-
     for (c = 0; c < 16; ++c)
     {
         for (p = 0; p < CC_ARR_SIZE; ++p)
-            cc[c][p] = 0.0f;
+            CUR_CC[c][p] = 0.0f;
     }
 }
 
 
-void patch_control(int chan, int param, float value)
+void patch_control(Engine* e, int chan, int param, float value)
 {
     /* FIXME: this could probably be put back into mixer and
                 a function call could be saved ?
      */
-    cc[chan][1 + param] = value;
+    e->patch->cc[chan][1 + param] = value;
 }
 
@@ -29,8 +29,10 @@
 #include <stdint.h>
 
 
+#include "engine.h"
 #include "ticks.h"
 #include "lfo.h"
+#include "mixer.h"
 
 
 typedef struct _Patch Patch;
@@ -188,16 +190,47 @@ typedef enum
 
 
 
-void patch_control_init    (void);
+/*  counts of how the sample, its points and the LFO and envelope
+    parameters get to the audio thread (see PatchPlay in
+    patch_private/patch_data.h). overlaps are the snapshots published
+    while the audio thread was part way through a period, which is
+    when a writer and the audio thread actually contend for a patch.
+ */
+typedef struct _PatchSnapshotStats
+{
+    unsigned long   published;  /* snapshots published              */
+    unsigned long   overlaps;   /* of those, published mid-period   */
+    unsigned long   updates;    /* snapshots taken up by audio thread */
+    unsigned long   flushes;    /* voice flushes done by audio thread */
 
-/* playback and rendering functions  */
+} PatchSnapshotStats;
+
+
+void patch_control_init    (void);
 
-void patch_control         (int chan, int param, float value);
-void patch_release         (int chan, int note);
-void patch_release_with_id (int id, int note);
-void patch_render          (float* buf, int nframes);
-void patch_trigger         (int chan, int note, float vel, Tick ticks);
-void patch_trigger_with_id (int id, int note, float vel, Tick ticks);
+/*  playback and rendering functions, RT thread only: they work on the
+    engine they are given, which must also be the calling thread's
+    (as it is during mixer_mixdown) */
+
+void patch_control         (Engine*, int chan, int param, float value);
+void patch_release         (Engine*, int chan, int note);
+void patch_release_with_id (Engine*, int id, int note);
+void patch_render          (Engine*, const MixerBus* buses, int count,
+                                        int offset, int nframes);
+void patch_trigger         (Engine*, int chan, int note, float vel,
+                                        Tick ticks);
+void patch_trigger_with_id (Engine*, int id, int note, float vel,
+                                        Tick ticks);
+
+/* RT thread only: voices sounding in all patches */
+int  patch_active_voices   (void);
+
+/* not for usage by RT thread */
+void patch_get_snapshot_stats(PatchSnapshotStats*);
+
+/*  not for usage by RT thread: how recently channel chan was played,
+    as a count of note-ons which only goes up (0 if never) */
+unsigned long patch_channel_last_used(int chan);
 
 
 #endif /* __PATCH_H__ */
@@ -26,8 +26,10 @@
 
 
 #include "patch_defs.h"
+#include "engine_private.h"
 #include "midi_control.h"
 #include "mixer.h"
+#include "gc.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -35,7 +37,6 @@
 
 static int      start_frame = 0;
 static float    one = 1.0;
-static float    (*cc_arr)[16][CC_ARR_SIZE];
 
 
 Patch* patch_new(void)
@@ -57,6 +58,7 @@ Patch* patch_new(void)
     p->name[0] = '\0';
 
     p->channel =        0;
+    p->bus =            0;
     p->root_note =      60;
     p->lower_note =     60;
     p->upper_note =     60;
@@ -146,11 +148,13 @@ Patch* patch_new(void)
     {
         lfo_params_init(&p->glfo_params[i], 1.0, LFO_SHAPE_SINE);
         p->glfo[i] = lfo_new();
+        p->glfo_update[i] = p->rt_glfo_update[i] = 0;
+        p->glfo_trigger[i] = p->rt_glfo_trigger[i] = 0;
         /* init tables to NULL */
         p->glfo_table[i] = 0;
     }
 
-    patch_set_global_lfo_buffers(p, patch_buffersize);
+    patch_set_global_lfo_buffers(p, CUR_BUFFERSIZE);
 
     /* only the params for the voice lfo can be set at this stage */
     for (i = 0; i < VOICE_MAX_LFOS; ++i)
@@ -166,8 +170,24 @@ Patch* patch_new(void)
 
     p->last_note = -1;
 
+    p->play = 0;
+    p->play_epoch = 0;
+    p->rt = 0;
+    p->rt_serial = 0;
+    p->rt_flush = 0;
+    p->rt_sample = 0;
+    p->rt_glfo_trigger_all = current_engine->patch->glfo_trigger;
+
+    p->state = current_engine->patch;
+    p->last_used = 0;
+    p->evicted = false;
+    p->evicted_used = 0;
+    p->reloading = false;
+
     pthread_mutex_init(&p->mutex, NULL);
 
+    patch_play_publish(p, false);
+
     debug("********************************\n");
     debug("created patch:%s [%p]\n", p->name, p);
     debug("********************************\n");
@@ -204,9 +224,45 @@ void patch_free(Patch* p)
 }
 
 
-void patch_set_control_array(float (*ccs)[16][CC_ARR_SIZE])
+void patch_play_publish(Patch* p, bool flush)
 {
-    cc_arr = ccs;
+    PatchPlay* prev = p->play;
+    PatchPlay* next = (prev == &p->play_buf[0]) ? &p->play_buf[1]
+                                                : &p->play_buf[0];
+
+    /*  next was last published two snapshots ago: the audio thread
+        might still be reading it until the period it was in when
+        prev replaced it is over */
+    gc_wait(p->play_epoch);
+
+    next->sample =          p->sample;
+    next->play_start =      p->play_start;
+    next->play_stop =       p->play_stop;
+    next->loop_start =      p->loop_start;
+    next->loop_stop =       p->loop_stop;
+    next->sample_stop =     p->sample_stop;
+    next->fade_samples =    p->fade_samples;
+    next->xfade_samples =   p->xfade_samples;
+
+    memcpy(next->glfo_params, p->glfo_params, sizeof(p->glfo_params));
+    memcpy(next->vlfo_params, p->vlfo_params, sizeof(p->vlfo_params));
+    memcpy(next->env_params, p->env_params, sizeof(p->env_params));
+    memcpy(next->glfo_update, p->glfo_update, sizeof(p->glfo_update));
+    memcpy(next->glfo_trigger, p->glfo_trigger, sizeof(p->glfo_trigger));
+
+    next->serial =          (prev) ? prev->serial + 1 : 1;
+    next->flush =           (prev) ? prev->flush + (flush ? 1 : 0) : 0;
+
+    __atomic_store_n(&p->play, next, __ATOMIC_SEQ_CST);
+    p->play_epoch = gc_epoch();
+
+    __atomic_add_fetch(&patch_snapshot_stats.published, 1,
+                                                    __ATOMIC_RELAXED);
+
+    /* an odd epoch is a period under way (see gc.c) */
+    if (p->play_epoch & 1)
+        __atomic_add_fetch(&patch_snapshot_stats.overlaps, 1,
+                                                    __ATOMIC_RELAXED);
 }
 
 
@@ -221,7 +277,7 @@ void patch_set_global_lfo_buffers(Patch* p, int buffersize)
     {
         free(p->glfo_table[i]);
         p->glfo_table[i] =
-            malloc(sizeof(*p->glfo_table[i]) * patch_buffersize);
+            malloc(sizeof(*p->glfo_table[i]) * CUR_BUFFERSIZE);
     }
 }
 
@@ -235,7 +291,7 @@ float const* patch_mod_id_to_pointer(int id, Patch* p, PatchVoice* v)
     case MOD_SRC_VELOCITY:  return (v) ? &v->vel :          NULL;
     case MOD_SRC_KEY:       return (v) ? &v->key_track :    NULL;
     case MOD_SRC_PITCH_WHEEL:
-        return &((*cc_arr)[p->channel][0]);
+        return &p->state->cc[p->channel][0];
     }
 
     if ((id & MOD_SRC_EG) && v)
@@ -265,7 +321,7 @@ float const* patch_mod_id_to_pointer(int id, Patch* p, PatchVoice* v)
     if (id & MOD_SRC_MIDI_CC)
     {
         id &= ~MOD_SRC_MIDI_CC;
-        return &((*cc_arr)[p->channel][id + 1]);
+        return &p->state->cc[p->channel][id + 1];
     }
 
     debug("unknown modulation source:%d\n", id);
@@ -283,6 +339,7 @@ void patch_copy(Patch* dest, Patch* src)
     strcpy(dest->name, src->name);
 
     dest->channel =         src->channel;
+    dest->bus =             src->bus;
     dest->root_note =       src->root_note;
     dest->lower_note =      src->lower_note;
     dest->upper_note =      src->upper_note;
@@ -319,7 +376,7 @@ void patch_copy(Patch* dest, Patch* src)
     for (i = 0; i < PATCH_MAX_LFOS; ++i)
     {
         dest->glfo_params[i] = src->glfo_params[i];
-        lfo_update_params(dest->glfo[i], &dest->glfo_params[i]);
+        ++dest->glfo_update[i];  /* by the audio thread, once published */
     }
 
     for (i = 0; i < VOICE_MAX_LFOS; ++i)
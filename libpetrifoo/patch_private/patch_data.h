@@ -80,6 +80,43 @@ typedef struct _PatchBool
 } PatchBool;
 
 
+/*  PatchPlay
+        the sample a patch plays from and the points it plays between,
+        and the LFO and envelope parameters, which are no good to the
+        audio thread unless they agree with each other. the audio
+        thread only ever sees them as a snapshot published by
+        patch_play_publish.
+
+        a flush count differing from the last one the audio thread saw
+        tells it to silence the voices before playing from the snapshot.
+        likewise the counts for each global LFO tell it to update the
+        LFO from its parameters, or to retrigger it.
+ */
+typedef struct _PatchPlay
+{
+    const Sample*   sample;
+
+    int     play_start;
+    int     play_stop;
+    int     loop_start;
+    int     loop_stop;
+    int     sample_stop;
+    int     fade_samples;
+    int     xfade_samples;
+
+    LFOParams   glfo_params[PATCH_MAX_LFOS];
+    LFOParams   vlfo_params[VOICE_MAX_LFOS];
+    ADSRParams  env_params[VOICE_MAX_ENVS];
+
+    unsigned int    glfo_update[PATCH_MAX_LFOS];
+    unsigned int    glfo_trigger[PATCH_MAX_LFOS];
+
+    unsigned int    serial;
+    unsigned int    flush;
+
+} PatchPlay;
+
+
 /* type for array of instruments (called patches) */
 struct _Patch
 {
@@ -90,6 +127,7 @@ struct _Patch
     char    name[PATCH_MAX_NAME + 1];
 
     int     channel;        /* midi channel to listen on */
+    int     bus;            /* mixer bus to play on */
     int     root_note;      /* midi note to listen on */
     int     lower_note;     /* lowest note in range */
     int     upper_note;     /* highest note in range */
@@ -129,10 +167,14 @@ struct _Patch
     double mod_pitch_min[MAX_MOD_SLOTS];
     double mod_pitch_max[MAX_MOD_SLOTS];
 
-    LFO*        glfo[PATCH_MAX_LFOS];
+    LFO*        glfo[PATCH_MAX_LFOS];   /* the audio thread's */
     LFOParams   glfo_params[PATCH_MAX_LFOS];
     LFOParams   vlfo_params[VOICE_MAX_LFOS];
 
+    /* bumped to have the audio thread update/retrigger glfo[i] */
+    unsigned int    glfo_update[PATCH_MAX_LFOS];
+    unsigned int    glfo_trigger[PATCH_MAX_LFOS];
+
     /*  use tables to store output values of global LFOs
     */
     float*      glfo_table[PATCH_MAX_LFOS];
@@ -142,9 +184,44 @@ struct _Patch
     /* each patch is responsible for its own voices */
     PatchVoice* voices[PATCH_VOICE_COUNT];
     int         last_note;	/* the last MIDI note value that played us */
-     
-    /* used exclusively by patch_lock functions to ensure that
-     * patch_render ignores this patch */
+
+    /*  the fields above (sample, points, LFO and envelope parameters)
+        are only for the GUI and the other non-RT threads, which
+        publish them to the audio thread through play. the two buffers
+        take turns so the one being written is never the one the audio
+        thread might be reading (see patch_play_publish). */
+    PatchPlay       play_buf[2];
+    PatchPlay*      play;
+    unsigned long   play_epoch;
+
+    /*  the audio thread's own: rt is the snapshot it is working from,
+        only to be trusted after patch_play_sync in patch.c */
+    const PatchPlay*    rt;
+    unsigned int        rt_serial;
+    unsigned int        rt_flush;
+    const Sample*       rt_sample;  /* last taken up, for the trace */
+    unsigned int        rt_glfo_update[PATCH_MAX_LFOS];
+    unsigned int        rt_glfo_trigger[PATCH_MAX_LFOS];
+    unsigned int        rt_glfo_trigger_all;    /* see PatchState */
+
+    /*  the state of the engine the patch was made for (see
+        patch_defs.h), for the audio thread */
+    struct _PatchState* state;
+
+    /*  set by the audio thread to the engine's count of note-ons
+        whenever the patch is triggered, for the sample budget */
+    unsigned long       last_used;
+
+    /*  the sample budget's, kept under the engine's sample_mutex:
+        whether the sample data has been evicted, last_used when it
+        was, and whether a reload has been queued */
+    bool                evicted;
+    unsigned long       evicted_used;
+    bool                reloading;
+
+    /*  used by the non-RT threads to keep out of each other's way
+     *  while changing the sample and points and publishing them.
+     *  never touched by the audio thread. */
     pthread_mutex_t mutex;
 
 };
@@ -154,7 +231,13 @@ Patch*          patch_new(void);
 void            patch_free(Patch*);
 void            patch_copy(Patch* dest, Patch* src);
 
-void            patch_set_control_array(float (*ccs)[16][CC_ARR_SIZE]);
+/*  *** NOT for usage by RT thread ***
+    publishes the sample and points to the audio thread, which will
+    silence the patch's voices first if flush is true. unless the
+    patch is yet to be placed in the patches array the caller must
+    hold the patch lock (see patch_macros.h). */
+void            patch_play_publish(Patch*, bool flush);
+
 
 void            patch_set_global_lfo_buffers(Patch*, int buffersize);
 
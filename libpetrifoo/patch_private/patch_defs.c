@@ -27,10 +27,17 @@
 #include "sample.h"
 */
 
+#include <pthread.h>
+
+#include "engine_private.h"
+#include "midi_control.h"
+#include "patch.h"
 #include "patch_defs.h"
 
 #include "driver.h"
-#include "patch.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 /*#include "patch_data.h"
 #include "patch_defs.h"
@@ -41,11 +48,43 @@ const float PATCH_LEGATO_LAG = 0.005;
 const float ALMOST_ZERO = 1e-6;
 
 
-int         patch_samplerate = -1;
-int         patch_buffersize = -1;
+PatchState  patch_state_default =
+{
+    .sample_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .fast_resample = true,
+    .native_rate =  false,
+    .samplerate =   -1,
+    .buffersize =   -1,
+    .legato_lag =   20,     /* bogus initial value */
+};
+
+PatchSnapshotStats  patch_snapshot_stats;
+
+
+PatchState* patch_state_new(void)
+{
+    PatchState* ps = malloc(sizeof(*ps));
+
+    if (!ps)
+        return 0;
+
+    memset(ps, 0, sizeof(*ps));
+    pthread_mutex_init(&ps->sample_mutex, NULL);
+    ps->fast_resample = true;
+    ps->native_rate = false;
+    ps->samplerate = -1;
+    ps->buffersize = -1;
+    ps->legato_lag = 20;
 
-int         patch_legato_lag = 20;     /* bogus initial value */
+    return ps;
+}
 
 
-Patch*      patches[PATCH_COUNT];
+void patch_state_free(PatchState* ps)
+{
+    if (!ps)
+        return;
 
+    pthread_mutex_destroy(&ps->sample_mutex);
+    free(ps);
+}
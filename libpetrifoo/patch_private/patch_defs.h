@@ -48,19 +48,71 @@ extern const float  PATCH_LEGATO_LAG;
 extern const float  ALMOST_ZERO;
 
 
-/* what sample rate we think the audio interface is running at */
-extern int      patch_samplerate;
-extern int      patch_buffersize;
-
-
-/* how many ticks legato releases lag; calculated to take
- * PATCH_LEGATO_LAG seconds */
-extern int      patch_legato_lag;
-
-
-
-/* the patches */
-extern Patch*   patches[PATCH_COUNT];
+/*  one for each engine (see engine.h). the audio thread is handed its
+ *  engine and reaches the state through it, or through the patch (see
+ *  Patch.state). everything else works on the calling thread's engine,
+ *  through the CUR_ macros below (needs engine_private.h and
+ *  midi_control.h)
+ */
+struct _PatchState
+{
+    /* the patches */
+    Patch*          patches[PATCH_COUNT];
+
+    /*  MIDI controller outputs
+     *      pitch wheel =           index 0
+     *      CC x =                  index x + 1
+     */
+    float           cc[16][CC_ARR_SIZE];
+
+    /* see patch_util.c */
+    pthread_mutex_t sample_mutex;
+    unsigned int    sample_serial[PATCH_COUNT];
+
+    /*  how samples are loaded (see patch_set_fast_resample and
+     *  patch_set_native_rate), only ever touched atomically */
+    bool            fast_resample;
+    bool            native_rate;
+
+    /*  note-ons counted by the audio thread, and the count at the last
+     *  one on each channel (0 for none) */
+    unsigned long   notes;
+    unsigned long   channel_used[16];
+
+    /* bytes of sample data to keep resident, 0 for no limit */
+    unsigned long   sample_budget;
+
+    /* what sample rate we think the audio interface is running at */
+    int             samplerate;
+    int             buffersize;
+
+    /* how many ticks legato releases lag; calculated to take
+     * PATCH_LEGATO_LAG seconds */
+    int             legato_lag;
+
+    /*  bumped (atomically) to have the audio thread retrigger every
+     *  global LFO, after the tempo or sample rate changes */
+    unsigned int    glfo_trigger;
+};
+
+
+/* the calling thread's engine's, see engine_select */
+#define CUR_PATCHES         (current_engine->patch->patches)
+#define CUR_CC              (current_engine->patch->cc)
+#define CUR_SAMPLE_MUTEX    (current_engine->patch->sample_mutex)
+#define CUR_SAMPLE_SERIAL   (current_engine->patch->sample_serial)
+#define CUR_FAST_RESAMPLE   (current_engine->patch->fast_resample)
+#define CUR_NATIVE_RATE     (current_engine->patch->native_rate)
+#define CUR_NOTES           (current_engine->patch->notes)
+#define CUR_CHANNEL_USED    (current_engine->patch->channel_used)
+#define CUR_SAMPLE_BUDGET   (current_engine->patch->sample_budget)
+#define CUR_SAMPLERATE      (current_engine->patch->samplerate)
+#define CUR_BUFFERSIZE      (current_engine->patch->buffersize)
+#define CUR_LEGATO_LAG      (current_engine->patch->legato_lag)
+
+
+/* see patch_get_snapshot_stats, only ever touched atomically */
+extern PatchSnapshotStats   patch_snapshot_stats;
 
 
 
@@ -30,44 +30,17 @@
 inline static bool patchok(int id)  \
 {                                   \
     return (id >= 0 && id < PATCH_COUNT     \
-                    && patches[id] != 0     \
-                    && patches[id]->active);\
-}
-
-
-#define INLINE_PATCH_TRIGGER_GLOBAL_LFO_DEF                 \
-inline static void                                          \
-patch_trigger_global_lfo(int patch_id, LFO* lfo, LFOParams* lfopar) \
-{                                                           \
-    Patch* p = patches[patch_id];                           \
-    float const* src;                                       \
-    src = patch_mod_id_to_pointer(lfopar->fm1_id, p, NULL); \
-    lfo_set_fm1(lfo, src);                                  \
-    src = patch_mod_id_to_pointer(lfopar->fm2_id, p, NULL); \
-    lfo_set_fm2(lfo, src);                                  \
-    src = patch_mod_id_to_pointer(lfopar->am1_id, p, NULL); \
-    lfo_set_am1(lfo, src);                                  \
-    src = patch_mod_id_to_pointer(lfopar->am2_id, p, NULL); \
-    lfo_set_am2(lfo, src);                                  \
-    lfo_trigger(lfo, lfopar);                               \
+                    && CUR_PATCHES[id] != 0 \
+                    && CUR_PATCHES[id]->active);\
 }
 
 
 #define INLINE_PATCH_LOCK_DEF                                       \
-/* locks a patch so that it will be ignored by patch_render() */    \
+/* locks a patch against other non-RT threads (never the RT one) */ \
 inline static void patch_lock (int id)                              \
 {                                                                   \
 /*    debug("locking %d\n",id);                               */    \
-    pthread_mutex_lock(&patches[id]->mutex);                        \
-}
-
-
-#define INLINE_PATCH_TRYLOCK_DEF                                    \
-/*  same as above, but returns immediately with EBUSY if mutex      \
- *  is already held */                                              \
-inline static int patch_trylock (int id)                            \
-{                                                                   \
-    return pthread_mutex_trylock(&patches[id]->mutex);              \
+    pthread_mutex_lock(&CUR_PATCHES[id]->mutex);                    \
 }
 
 
@@ -76,7 +49,7 @@ inline static int patch_trylock (int id)                            \
 inline static void patch_unlock (int id)                            \
 {                                                                   \
  /*   debug("unlocking %d\n",id);                             */    \
-    pthread_mutex_unlock(&patches[id]->mutex);                      \
+    pthread_mutex_unlock(&CUR_PATCHES[id]->mutex);                  \
 }
 
 
@@ -48,6 +48,7 @@ PatchVoice* patch_voice_new(void)
     pv->note =          0;
     pv->pitch =         0;
     pv->pitch_step =    0;
+    pv->rate_ratio =    1.0;
 
     pv->porta_ticks =   0;
 
@@ -75,6 +75,8 @@ typedef struct _PatchVoice
     double      pitch;      /* what pitch ratio to play at */
     double      pitch_step; /* how much to increment pitch by each
                              * porta_tick */
+    double      rate_ratio; /* sample's rate / our rate, applied to
+                             * the step but not to the pitch */
     bool        legato;
     bool        portamento;
     float       porta_secs;
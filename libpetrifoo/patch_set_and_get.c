@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -36,6 +37,8 @@
 #include "pf_error.h"
 
 
+#include "engine_private.h"
+
 #include "patch_private/err_msg.h"
 #include "patch_private/patch_data.h"
 #include "patch_private/patch_defs.h"
@@ -43,6 +46,8 @@
 
 
 INLINE_PATCHOK_DEF
+INLINE_PATCH_LOCK_DEF
+INLINE_PATCH_UNLOCK_DEF
 
 inline static bool markok(int id)
 {
@@ -56,15 +61,19 @@ inline static bool marksetok(int id)
 }
 
 
+/* the points are only seen by the audio thread once published */
 static inline void set_mark_frame(int patch_id, int mark, int frame)
 {
-    *(patches[patch_id]->marks[mark]) = frame;
+    patch_lock(patch_id);
+    *(CUR_PATCHES[patch_id]->marks[mark]) = frame;
+    patch_play_publish(CUR_PATCHES[patch_id], false);
+    patch_unlock(patch_id);
 }
 
 
 static inline int get_mark_frame(int patch_id, int mark)
 {
-    return *(patches[patch_id]->marks[mark]);
+    return *(CUR_PATCHES[patch_id]->marks[mark]);
 }
 
 
@@ -75,7 +84,7 @@ static int get_mark_frame_range(int patch_id, int mark, int* min, int* max)
     assert(patchok(patch_id));
     assert(markok(mark));
 
-    xfade = patches[patch_id]->xfade_samples;
+    xfade = CUR_PATCHES[patch_id]->xfade_samples;
 
     if (mark == WF_MARK_START || mark == WF_MARK_STOP)
     {
@@ -117,11 +126,11 @@ static PatchParam* get_patch_param(int patch_id, PatchParamType param)
 {
     switch(param)
     {
-    case PATCH_PARAM_AMPLITUDE: return &patches[patch_id]->amp;
-    case PATCH_PARAM_PANNING:   return &patches[patch_id]->pan;
-    case PATCH_PARAM_CUTOFF:    return &patches[patch_id]->ffreq;
-    case PATCH_PARAM_RESONANCE: return &patches[patch_id]->freso;
-    case PATCH_PARAM_PITCH:     return &patches[patch_id]->pitch;
+    case PATCH_PARAM_AMPLITUDE: return &CUR_PATCHES[patch_id]->amp;
+    case PATCH_PARAM_PANNING:   return &CUR_PATCHES[patch_id]->pan;
+    case PATCH_PARAM_CUTOFF:    return &CUR_PATCHES[patch_id]->ffreq;
+    case PATCH_PARAM_RESONANCE: return &CUR_PATCHES[patch_id]->freso;
+    case PATCH_PARAM_PITCH:     return &CUR_PATCHES[patch_id]->pitch;
     default:
         assert(0);
     }
@@ -134,8 +143,8 @@ static PatchBool* get_patch_bool(int patch_id, PatchBoolType booltype)
     assert(patchok(patch_id));
     switch(booltype)
     {
-    case PATCH_BOOL_PORTAMENTO: return &patches[patch_id]->porta;
-    case PATCH_BOOL_LEGATO:     return &patches[patch_id]->legato;
+    case PATCH_BOOL_PORTAMENTO: return &CUR_PATCHES[patch_id]->porta;
+    case PATCH_BOOL_LEGATO:     return &CUR_PATCHES[patch_id]->legato;
     default:
         assert(0);
     }
@@ -149,7 +158,7 @@ static PatchFloat* get_patch_float(int patch_id, PatchFloatType floattype)
     switch(floattype)
     {
     case PATCH_FLOAT_PORTAMENTO_TIME:
-        return &patches[patch_id]->porta_secs;
+        return &CUR_PATCHES[patch_id]->porta_secs;
     default:
         assert(0);
     }
@@ -157,8 +166,22 @@ static PatchFloat* get_patch_float(int patch_id, PatchFloatType floattype)
 }
 
 
-/* inline static function def macro, see private/patch_data.h */
-INLINE_PATCH_TRIGGER_GLOBAL_LFO_DEF
+/*  the LFO and envelope parameters are only seen by the audio thread
+ *  once published. the global LFOs are the audio thread's, so a
+ *  changed one (glfo >= 0) is also marked for the audio thread to
+ *  update from its parameters, or retrigger (see patch_play_sync).
+ *  call with the patch locked. */
+static void params_publish(int patch_id, int glfo, bool retrigger)
+{
+    Patch* p = CUR_PATCHES[patch_id];
+
+    if (glfo >= 0 && retrigger)
+        ++p->glfo_trigger[glfo];
+    else if (glfo >= 0)
+        ++p->glfo_update[glfo];
+
+    patch_play_publish(p, false);
+}
 
 
 
@@ -179,7 +202,10 @@ int patch_set_env_active(int patch_id, int eg, bool state)
 {
     assert(patchok(patch_id));
     eg = mod_src_to_eg_index(eg);
-    patches[patch_id]->env_params[eg].active = state;
+    patch_lock(patch_id);
+    CUR_PATCHES[patch_id]->env_params[eg].active = state;
+    params_publish(patch_id, -1, false);
+    patch_unlock(patch_id);
     return 0;
 }
 
@@ -194,7 +220,10 @@ int patch_set_env_##_EGPAR(int patch_id, int eg, float secs)    \
         return -1;                                      \
     }                                                   \
     eg = mod_src_to_eg_index(eg);                       \
-    patches[patch_id]->env_params[eg]._EGPAR = secs;    \
+    patch_lock(patch_id);                               \
+    CUR_PATCHES[patch_id]->env_params[eg]._EGPAR = secs;\
+    params_publish(patch_id, -1, false);                \
+    patch_unlock(patch_id);                             \
     return 0;                                           \
 }
 
@@ -214,7 +243,10 @@ int patch_set_env_sustain (int patch_id, int eg, float level)
         return -1;
     }
     eg = mod_src_to_eg_index(eg);
-    patches[patch_id]->env_params[eg].sustain = level;
+    patch_lock(patch_id);
+    CUR_PATCHES[patch_id]->env_params[eg].sustain = level;
+    params_publish(patch_id, -1, false);
+    patch_unlock(patch_id);
     return 0;
 }
 
@@ -231,7 +263,10 @@ int patch_set_env_release (int patch_id, int eg, float secs)
     /* use of min release time should remain hidden */
     if (secs < PATCH_MIN_RELEASE)
         secs = PATCH_MIN_RELEASE;
-    patches[patch_id]->env_params[eg].release = secs;
+    patch_lock(patch_id);
+    CUR_PATCHES[patch_id]->env_params[eg].release = secs;
+    params_publish(patch_id, -1, false);
+    patch_unlock(patch_id);
     return 0;
 }
 
@@ -245,7 +280,10 @@ int patch_set_env_key_amt(int patch_id, int eg, float val)
         return -1;
     }
     eg = mod_src_to_eg_index(eg);
-    patches[patch_id]->env_params[eg].key_amt = val;
+    patch_lock(patch_id);
+    CUR_PATCHES[patch_id]->env_params[eg].key_amt = val;
+    params_publish(patch_id, -1, false);
+    patch_unlock(patch_id);
     return 0;
 }
 
@@ -259,7 +297,7 @@ _EGPARTYPE patch_get_env_##_EGPAR(int patch_id, int eg) \
 {                                                       \
     assert(patchok(patch_id));                             \
     eg = mod_src_to_eg_index(eg);                       \
-    return patches[patch_id]->env_params[eg]._EGPAR;    \
+    return CUR_PATCHES[patch_id]->env_params[eg]._EGPAR;\
 }
 
 PATCH_GET_ENV_PARAM( active,    bool  )
@@ -276,7 +314,7 @@ float patch_get_env_release (int patch_id, int eg)
     float val;
     assert(patchok(patch_id));
     eg = mod_src_to_eg_index(eg);
-    val = patches[patch_id]->env_params[eg].release;
+    val = CUR_PATCHES[patch_id]->env_params[eg].release;
     /* hide usage of min-release-value from outside world */
     if (val <= PATCH_MIN_RELEASE)
         val = 0;
@@ -288,41 +326,44 @@ float patch_get_env_release (int patch_id, int eg)
 /*************************** LFO SETTERS ********************************/
 /************************************************************************/
 
-static LFOParams* lfopar_from_id(int patch_id, int id, LFO** lfo)
+/* glfo is set to the index of a global LFO, or -1 for a voice LFO */
+static LFOParams* lfopar_from_id(int patch_id, int id, int* glfo)
 {
     assert(patchok(patch_id));
     assert( ((id & MOD_SRC_VLFO) && (id & MOD_SRC_GLFO)) == 0);
     assert( ((id & MOD_SRC_VLFO) || (id & MOD_SRC_GLFO)) != 0);
 
-    if (lfo)
-        *lfo = 0;
+    if (glfo)
+        *glfo = -1;
 
     if (id & MOD_SRC_VLFO)
     {
         id -= MOD_SRC_VLFO;
         assert (id < VOICE_MAX_LFOS);
-        return &patches[patch_id]->vlfo_params[id];
+        return &CUR_PATCHES[patch_id]->vlfo_params[id];
     }
 
     id -= MOD_SRC_GLFO;
     assert(id < PATCH_MAX_LFOS);
 
-    if (lfo)
-        *lfo = patches[patch_id]->glfo[id];
+    if (glfo)
+        *glfo = id;
 
-    return &patches[patch_id]->glfo_params[id];
+    return &CUR_PATCHES[patch_id]->glfo_params[id];
 }
 
 
 #define PATCH_SET_LFO_VAR( _LFOVAR, _LFOVARTYPE )                       \
 int patch_set_lfo_##_LFOVAR(int patch_id, int lfo_id, _LFOVARTYPE val)  \
 {                                                   \
-    LFO*        lfo;                                \
+    int         glfo;                               \
     LFOParams*  lfopar;                             \
-    lfopar = lfopar_from_id(patch_id, lfo_id, &lfo);\
+    lfopar = lfopar_from_id(patch_id, lfo_id,       \
+                                        &glfo);     \
+    patch_lock(patch_id);                           \
     lfopar->_LFOVAR = val;                          \
-    if (lfo)                                        \
-        lfo_update_params(lfo, lfopar);             \
+    params_publish(patch_id, glfo, false);          \
+    patch_unlock(patch_id);                         \
     return 0;                                       \
 }
 
@@ -335,17 +376,19 @@ PATCH_SET_LFO_VAR( sync,     bool)
 #define PATCH_SET_LFO_VAR_BOUNDED( _LFOVAR, _LFOVARTYPE )               \
 int patch_set_lfo_##_LFOVAR(int patch_id, int lfo_id, _LFOVARTYPE val)  \
 {                                                   \
-    LFO*        lfo;                                \
+    int         glfo;                               \
     LFOParams*  lfopar;                             \
-    lfopar = lfopar_from_id(patch_id, lfo_id, &lfo);\
+    lfopar = lfopar_from_id(patch_id, lfo_id,       \
+                                        &glfo);     \
     if (val < 0.0)                                  \
     {                                               \
         pf_error(PF_ERR_PATCH_VALUE_NEGATIVE);      \
         return -1;                                  \
     }                                               \
+    patch_lock(patch_id);                           \
     lfopar->_LFOVAR = val;                          \
-    if (lfo)                                        \
-        lfo_update_params(lfo, lfopar);             \
+    params_publish(patch_id, glfo, false);          \
+    patch_unlock(patch_id);                         \
     return 0;                                       \
 }
 
@@ -383,7 +426,7 @@ PATCH_GET_LFO_VAR( sync,       bool )
 int patch_set_cut (int patch_id, int cut)
 {
     assert(patchok(patch_id));
-    patches[patch_id]->cut = cut;
+    CUR_PATCHES[patch_id]->cut = cut;
     return 0;
 }
 
@@ -391,7 +434,7 @@ int patch_set_cut (int patch_id, int cut)
 int patch_set_cut_by (int patch_id, int cut_by)
 {
     assert(patchok(patch_id));
-    patches[patch_id]->cut_by = cut_by;
+    CUR_PATCHES[patch_id]->cut_by = cut_by;
     return 0;
 }
 
@@ -399,7 +442,7 @@ int patch_set_cut_by (int patch_id, int cut_by)
 int patch_set_legato(int patch_id, bool val)
 {
     assert(patchok(patch_id));
-    patches[patch_id]->legato.active = val;
+    CUR_PATCHES[patch_id]->legato.active = val;
     return 0;
 }
 
@@ -408,7 +451,7 @@ int patch_set_fade_samples(int patch_id, int samples)
 {
     assert(patchok(patch_id));
 
-    if (patches[patch_id]->sample->sp == NULL)
+    if (CUR_PATCHES[patch_id]->sample->sp == NULL)
         return 0;
 
     if (samples < 0)
@@ -417,14 +460,17 @@ int patch_set_fade_samples(int patch_id, int samples)
         return -1;
     }
 
-    if (patches[patch_id]->play_start + samples * 2
-        >= patches[patch_id]->play_stop)
+    if (CUR_PATCHES[patch_id]->play_start + samples * 2
+        >= CUR_PATCHES[patch_id]->play_stop)
     {
         pf_error(PF_ERR_PATCH_PARAM_VALUE);
         return -1;
     }
 
-    patches[patch_id]->fade_samples = samples;
+    patch_lock(patch_id);
+    CUR_PATCHES[patch_id]->fade_samples = samples;
+    patch_play_publish(CUR_PATCHES[patch_id], false);
+    patch_unlock(patch_id);
     return 0;
 }
 
@@ -432,7 +478,7 @@ int patch_set_xfade_samples(int patch_id, int samples)
 {
     assert(patchok(patch_id));
 
-    if (patches[patch_id]->sample->sp == NULL)
+    if (CUR_PATCHES[patch_id]->sample->sp == NULL)
         return 0;
 
     if (samples < 0)
@@ -441,21 +487,24 @@ int patch_set_xfade_samples(int patch_id, int samples)
         return -1;
     }
 
-    if (patches[patch_id]->loop_start + samples
-      > patches[patch_id]->loop_stop)
+    if (CUR_PATCHES[patch_id]->loop_start + samples
+      > CUR_PATCHES[patch_id]->loop_stop)
     {
         pf_error(PF_ERR_PATCH_PARAM_VALUE);
         return -1;
     }
 
-    if (patches[patch_id]->loop_stop + samples
-      > patches[patch_id]->play_stop)
+    if (CUR_PATCHES[patch_id]->loop_stop + samples
+      > CUR_PATCHES[patch_id]->play_stop)
     {
         pf_error(PF_ERR_PATCH_PARAM_VALUE);
         return -1;
     }
 
-    patches[patch_id]->xfade_samples = samples;
+    patch_lock(patch_id);
+    CUR_PATCHES[patch_id]->xfade_samples = samples;
+    patch_play_publish(CUR_PATCHES[patch_id], false);
+    patch_unlock(patch_id);
     return 0;
 }
 
@@ -466,7 +515,7 @@ int patch_set_mark_frame(int patch_id, int mark, int frame)
     assert(patchok(patch_id));
     assert(marksetok(mark));
 
-    if (patches[patch_id]->sample->sp == NULL)
+    if (CUR_PATCHES[patch_id]->sample->sp == NULL)
     {   /* FIXME: assert here? */
         errmsg("sample not set\n");
         return -1;
@@ -496,12 +545,12 @@ int patch_set_mark_frame_expand(int patch_id, int mark, int frame,
 {
     int also = 0;
     int also_frame = -1;
-    int xfade = patches[patch_id]->xfade_samples;
-    int fade = patches[patch_id]->fade_samples;
+    int xfade = CUR_PATCHES[patch_id]->xfade_samples;
+    int fade = CUR_PATCHES[patch_id]->fade_samples;
 
     assert(patchok(patch_id));
 
-    if (patches[patch_id]->sample->sp == NULL)
+    if (CUR_PATCHES[patch_id]->sample->sp == NULL)
         return -1;
 
     /*  if callee wishes not to be informed about which marks get changed
@@ -605,7 +654,7 @@ int patch_set_mark_frame_expand(int patch_id, int mark, int frame,
 int patch_set_name (int patch_id, const char *name)
 {
     assert(patchok(patch_id));
-    strncpy (patches[patch_id]->name, name, PATCH_MAX_NAME);
+    strncpy (CUR_PATCHES[patch_id]->name, name, PATCH_MAX_NAME);
     return 0;
 }
 
@@ -619,11 +668,12 @@ int patch_set_##_VAR(int patch_id, int val)     \
         pf_error(PF_ERR_PATCH_PARAM_VALUE);     \
         return -1;                              \
     }                                           \
-    patches[patch_id]->_VAR = val;              \
+    CUR_PATCHES[patch_id]->_VAR = val;          \
     return 0;                                   \
 }
 
 PATCH_SET_VAR( channel,     0,  15 )
+PATCH_SET_VAR( bus,         0,  MIXER_MAX_BUSES - 1 )
 PATCH_SET_VAR( root_note,   0,  127 )
 PATCH_SET_VAR( lower_note,  0,  127 )
 PATCH_SET_VAR( upper_note,  0,  127 )
@@ -636,7 +686,7 @@ PATCH_SET_VAR( pitch_steps, -PATCH_MAX_PITCH_STEPS, PATCH_MAX_PITCH_STEPS )
 int patch_set_monophonic(int patch_id, bool val)
 {
     assert(patchok(patch_id));
-    patches[patch_id]->mono = val;
+    CUR_PATCHES[patch_id]->mono = val;
     return 0;
 }
 
@@ -650,7 +700,7 @@ int patch_set_##_PARAM(int patch_id, float val)     \
         pf_error(PF_ERR_PATCH_PARAM_VALUE);         \
         return -1;                                  \
     }                                               \
-    patches[patch_id]->_PARAM.val = val;            \
+    CUR_PATCHES[patch_id]->_PARAM.val = val;        \
     return 0;                                       \
 }
 
@@ -688,7 +738,7 @@ int patch_set_play_mode (int patch_id, PatchPlayMode mode)
                | (mode & PATCH_PLAY_TO_END)) == 0);
     }
 
-    patches[patch_id]->play_mode = mode;
+    CUR_PATCHES[patch_id]->play_mode = mode;
     return 0;
 }
 
@@ -696,7 +746,7 @@ int patch_set_play_mode (int patch_id, PatchPlayMode mode)
 int patch_set_portamento (int patch_id, bool val)
 {
     assert(patchok(patch_id));
-    patches[patch_id]->porta.active = val;
+    CUR_PATCHES[patch_id]->porta.active = val;
     return 0;
 }
 
@@ -709,7 +759,7 @@ int patch_set_portamento_time (int patch_id, float secs)
         pf_error(PF_ERR_PATCH_PARAM_VALUE);
         return -1;
     }
-    patches[patch_id]->porta_secs.val = secs;
+    CUR_PATCHES[patch_id]->porta_secs.val = secs;
     return 0;
 }
 
@@ -724,10 +774,11 @@ int patch_set_portamento_time (int patch_id, float secs)
 int patch_get_##_VAR(int patch_id)  \
 {                                   \
     assert(patchok(patch_id));         \
-    return patches[patch_id]->_VAR; \
+    return CUR_PATCHES[patch_id]->_VAR; \
 }
 
 PATCH_GET_VAR( channel )
+PATCH_GET_VAR( bus )
 PATCH_GET_VAR( cut )
 PATCH_GET_VAR( cut_by )
 PATCH_GET_VAR( display_index )
@@ -744,7 +795,7 @@ PATCH_GET_VAR( pitch_steps )
 float patch_get_cutoff(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->ffreq.val;
+    return CUR_PATCHES[patch_id]->ffreq.val;
 }
 
 
@@ -752,16 +803,16 @@ float patch_get_cutoff(int patch_id)
 int patch_get_frames(int patch_id)
 {
     assert(patchok(patch_id));
-    if (patches[patch_id]->sample->sp == NULL)
+    if (CUR_PATCHES[patch_id]->sample->sp == NULL)
         return -1;
-    return patches[patch_id]->sample->frames;
+    return CUR_PATCHES[patch_id]->sample->frames;
 }
 
 /* get whether this patch is played legato or not */
 bool patch_get_legato(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->legato.active;
+    return CUR_PATCHES[patch_id]->legato.active;
 }
 
 
@@ -771,7 +822,7 @@ int patch_get_mark_frame(int patch_id, int mark)
     assert(markok(mark));
 
     /* FIXME: should this be an assert or not ? */
-    assert(patches[patch_id]->sample->sp != NULL);
+    assert(CUR_PATCHES[patch_id]->sample->sp != NULL);
 
     return get_mark_frame(patch_id, mark);
 }
@@ -784,7 +835,7 @@ int patch_get_mark_frame_range(int patch_id, int mark, int* frame_min,
     assert(markok(mark));
 
     /* FIXME: should this be an assert or not ? */
-    assert(patches[patch_id]->sample->sp != NULL);
+    assert(CUR_PATCHES[patch_id]->sample->sp != NULL);
 
     return get_mark_frame_range(patch_id, mark, frame_min, frame_max);
 }
@@ -793,14 +844,14 @@ int patch_get_mark_frame_range(int patch_id, int mark, int* frame_min,
 bool patch_get_monophonic(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->mono;
+    return CUR_PATCHES[patch_id]->mono;
 }
 
 /* get the name */
 const char *patch_get_name(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->name;
+    return CUR_PATCHES[patch_id]->name;
 }
 
 
@@ -808,35 +859,35 @@ const char *patch_get_name(int patch_id)
 float patch_get_panning(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->pan.val;
+    return CUR_PATCHES[patch_id]->pan.val;
 }
 
 /* get the pitch */
 float patch_get_pitch(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->pitch.val;
+    return CUR_PATCHES[patch_id]->pitch.val;
 }
 
 /* get the play mode */
 PatchPlayMode patch_get_play_mode(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->play_mode;
+    return CUR_PATCHES[patch_id]->play_mode;
 }
 
 /* get whether portamento is used or not */
 bool patch_get_portamento(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->porta.active;
+    return CUR_PATCHES[patch_id]->porta.active;
 }
 
 /* get length of portamento slides in seconds */
 float patch_get_portamento_time(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->porta_secs.val;
+    return CUR_PATCHES[patch_id]->porta_secs.val;
 }
 
 
@@ -844,21 +895,21 @@ float patch_get_portamento_time(int patch_id)
 float patch_get_resonance(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->freso.val;
+    return CUR_PATCHES[patch_id]->freso.val;
 }
 
 /* get a pointer to the sample data */
 const float *patch_get_sample(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->sample->sp;
+    return CUR_PATCHES[patch_id]->sample->sp;
 }
 
 /* get the name of the sample file */
 const char *patch_get_sample_name(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->sample->filename;
+    return CUR_PATCHES[patch_id]->sample->filename;
 }
 
 
@@ -866,47 +917,52 @@ const char *patch_get_sample_name(int patch_id)
 float patch_get_amplitude(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->amp.val;
+    return CUR_PATCHES[patch_id]->amp.val;
 }
 
 
 int patch_get_fade_samples(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->fade_samples;
+    return CUR_PATCHES[patch_id]->fade_samples;
 }
 
 
 int patch_get_xfade_samples(int patch_id)
 {
     assert(patchok(patch_id));
-    return patches[patch_id]->xfade_samples;
+    return CUR_PATCHES[patch_id]->xfade_samples;
 }
 
 
 int patch_get_max_fade_samples(int patch_id)
 {
+    Patch* p;
+
     assert(patchok(patch_id));
-    return (patches[patch_id]->play_stop - patches[patch_id]->play_start) / 2;
+    p = CUR_PATCHES[patch_id];
+    return (p->play_stop - p->play_start) / 2;
 }
 
 
 int patch_get_max_xfade_samples(int patch_id)
 {
+    Patch* p;
     int min;
     int tmp;
 
     assert(patchok(patch_id));
 
-    min = patches[patch_id]->sample->frames;
+    p = CUR_PATCHES[patch_id];
+    min = p->sample->frames;
 
-    tmp = patches[patch_id]->loop_stop - patches[patch_id]->loop_start;
+    tmp = p->loop_stop - p->loop_start;
     min = (tmp < min) ? tmp : min;
 
-    tmp = patches[patch_id]->play_stop - patches[patch_id]->loop_stop;
+    tmp = p->play_stop - p->loop_stop;
     min = (tmp < min) ? tmp : min;
 
-    tmp = patches[patch_id]->loop_start - patches[patch_id]->play_start;
+    tmp = p->loop_start - p->play_start;
     min = (tmp < min) ? tmp : min;
 
     return min;
@@ -923,11 +979,11 @@ float patch_param_get_value(int patch_id, PatchParamType param)
 
     switch(param)
     {
-    case PATCH_PARAM_AMPLITUDE: return patches[patch_id]->amp.val;
-    case PATCH_PARAM_PANNING:   return patches[patch_id]->pan.val;
-    case PATCH_PARAM_CUTOFF:    return patches[patch_id]->ffreq.val;
-    case PATCH_PARAM_RESONANCE: return patches[patch_id]->freso.val;
-    case PATCH_PARAM_PITCH:     return patches[patch_id]->pitch.val;
+    case PATCH_PARAM_AMPLITUDE: return CUR_PATCHES[patch_id]->amp.val;
+    case PATCH_PARAM_PANNING:   return CUR_PATCHES[patch_id]->pan.val;
+    case PATCH_PARAM_CUTOFF:    return CUR_PATCHES[patch_id]->ffreq.val;
+    case PATCH_PARAM_RESONANCE: return CUR_PATCHES[patch_id]->freso.val;
+    case PATCH_PARAM_PITCH:     return CUR_PATCHES[patch_id]->pitch.val;
     default:
         assert(0);
     }
@@ -942,11 +998,11 @@ void patch_param_set_value(int patch_id, PatchParamType param, float v)
 
     switch(param)
     {
-    case PATCH_PARAM_AMPLITUDE: patches[patch_id]->amp.val = v;     break;
-    case PATCH_PARAM_PANNING:   patches[patch_id]->pan.val = v;     break;
-    case PATCH_PARAM_CUTOFF:    patches[patch_id]->ffreq.val = v;   break;
-    case PATCH_PARAM_RESONANCE: patches[patch_id]->freso.val = v;   break;
-    case PATCH_PARAM_PITCH:     patches[patch_id]->pitch.val = v;   break;
+    case PATCH_PARAM_AMPLITUDE: CUR_PATCHES[patch_id]->amp.val = v;     break;
+    case PATCH_PARAM_PANNING:   CUR_PATCHES[patch_id]->pan.val = v;     break;
+    case PATCH_PARAM_CUTOFF:    CUR_PATCHES[patch_id]->ffreq.val = v;   break;
+    case PATCH_PARAM_RESONANCE: CUR_PATCHES[patch_id]->freso.val = v;   break;
+    case PATCH_PARAM_PITCH:     CUR_PATCHES[patch_id]->pitch.val = v;   break;
     default:
         assert(0);
     }
@@ -990,9 +1046,9 @@ patch_param_set_mod_amt(int patch_id, PatchParamType param, int slot,
 
     if (param == PATCH_PARAM_PITCH)
     {
-        patches[patch_id]->mod_pitch_max[slot] =
+        CUR_PATCHES[patch_id]->mod_pitch_max[slot] =
                         pow(2, (amt * PATCH_MAX_PITCH_STEPS) / 12.0);
-        patches[patch_id]->mod_pitch_min[slot] =
+        CUR_PATCHES[patch_id]->mod_pitch_min[slot] =
                         pow(2, -(amt * PATCH_MAX_PITCH_STEPS) / 12.0);
     }
 
@@ -1179,9 +1235,9 @@ int patch_float_get_mod_src(int patch_id, PatchFloatType floattype)
 /**************************************************************************/
 
 #define PATCH_LFO_CHECKS                                    \
-    LFO* lfo;                                               \
+    int glfo;                                               \
     LFOParams* lfopar;                                      \
-    if (!(lfopar = lfopar_from_id(patch_id, lfo_id, &lfo))) \
+    if (!(lfopar = lfopar_from_id(patch_id, lfo_id, &glfo)))\
         return -1;
 
 #define PATCH_NULL_LFO_CHECKS                               \
@@ -1193,10 +1249,10 @@ int patch_float_get_mod_src(int patch_id, PatchFloatType floattype)
 int patch_set_lfo_fm1_src(int patch_id, int lfo_id, int modsrc_id)
 {
     PATCH_LFO_CHECKS
+    patch_lock(patch_id);
     lfopar->fm1_id = modsrc_id;
-
-    if (lfo)
-        patch_trigger_global_lfo(patch_id, lfo, lfopar);
+    params_publish(patch_id, glfo, true);
+    patch_unlock(patch_id);
 
     return 0;
 }
@@ -1204,10 +1260,10 @@ int patch_set_lfo_fm1_src(int patch_id, int lfo_id, int modsrc_id)
 int patch_set_lfo_fm2_src(int patch_id, int lfo_id, int modsrc_id)
 {
     PATCH_LFO_CHECKS
+    patch_lock(patch_id);
     lfopar->fm2_id = modsrc_id;
-
-    if (lfo)
-        patch_trigger_global_lfo(patch_id, lfo, lfopar);
+    params_publish(patch_id, glfo, true);
+    patch_unlock(patch_id);
 
     return 0;
 }
@@ -1215,10 +1271,10 @@ int patch_set_lfo_fm2_src(int patch_id, int lfo_id, int modsrc_id)
 int patch_set_lfo_fm1_amt(int patch_id, int lfo_id, float amount)
 {
     PATCH_LFO_CHECKS
+    patch_lock(patch_id);
     lfopar->fm1_amt = amount;
-
-    if (lfo)
-        patch_trigger_global_lfo(patch_id, lfo, lfopar);
+    params_publish(patch_id, glfo, true);
+    patch_unlock(patch_id);
 
     return 0;
 }
@@ -1226,10 +1282,10 @@ int patch_set_lfo_fm1_amt(int patch_id, int lfo_id, float amount)
 int patch_set_lfo_fm2_amt(int patch_id, int lfo_id, float amount)
 {
     PATCH_LFO_CHECKS
+    patch_lock(patch_id);
     lfopar->fm2_amt = amount;
-
-    if (lfo)
-        patch_trigger_global_lfo(patch_id, lfo, lfopar);
+    params_publish(patch_id, glfo, true);
+    patch_unlock(patch_id);
 
     return 0;
 }
@@ -1272,10 +1328,10 @@ float patch_get_lfo_fm2_amt(int patch_id, int lfo_id)
 int patch_set_lfo_am1_src(int patch_id, int lfo_id, int modsrc_id)
 {
     PATCH_LFO_CHECKS
+    patch_lock(patch_id);
     lfopar->am1_id = modsrc_id;
-
-    if (lfo)
-        patch_trigger_global_lfo(patch_id, lfo, lfopar);
+    params_publish(patch_id, glfo, true);
+    patch_unlock(patch_id);
 
     return 0;
 }
@@ -1283,10 +1339,10 @@ int patch_set_lfo_am1_src(int patch_id, int lfo_id, int modsrc_id)
 int patch_set_lfo_am2_src(int patch_id, int lfo_id, int modsrc_id)
 {
     PATCH_LFO_CHECKS
+    patch_lock(patch_id);
     lfopar->am2_id = modsrc_id;
-
-    if (lfo)
-        patch_trigger_global_lfo(patch_id, lfo, lfopar);
+    params_publish(patch_id, glfo, true);
+    patch_unlock(patch_id);
 
     return 0;
 }
@@ -1294,10 +1350,10 @@ int patch_set_lfo_am2_src(int patch_id, int lfo_id, int modsrc_id)
 int patch_set_lfo_am1_amt(int patch_id, int lfo_id, float amount)
 {
     PATCH_LFO_CHECKS
+    patch_lock(patch_id);
     lfopar->am1_amt = amount;
-
-    if (lfo)
-        patch_trigger_global_lfo(patch_id, lfo, lfopar);
+    params_publish(patch_id, glfo, true);
+    patch_unlock(patch_id);
 
     return 0;
 }
@@ -1305,10 +1361,10 @@ int patch_set_lfo_am1_amt(int patch_id, int lfo_id, float amount)
 int patch_set_lfo_am2_amt(int patch_id, int lfo_id, float amount)
 {
     PATCH_LFO_CHECKS
+    patch_lock(patch_id);
     lfopar->am2_amt = amount;
-
-    if (lfo)
-        patch_trigger_global_lfo(patch_id, lfo, lfopar);
+    params_publish(patch_id, glfo, true);
+    patch_unlock(patch_id);
 
     return 0;
 }
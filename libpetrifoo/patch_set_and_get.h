@@ -90,6 +90,7 @@ bool        patch_get_lfo_sync      (int patch_id, int lfo_id);
 
 /* parameter setters */
 int patch_set_channel   (int patch_id, int channel);
+int patch_set_bus       (int patch_id, int bus);
 int patch_set_cut       (int patch_id, int cut);
 int patch_set_cut_by    (int patch_id, int cut_by);
 int patch_set_cutoff    (int patch_id, float freq);
@@ -127,6 +128,7 @@ int patch_set_xfade_samples(int id, int samples);
 
 /* parameter getters */
 int     patch_get_channel       (int id);
+int     patch_get_bus           (int id);
 int     patch_get_cut           (int id);
 int     patch_get_cut_by        (int id);
 float   patch_get_cutoff        (int id);
@@ -43,7 +43,11 @@
 #include "midi.h"       /* for MIDI_CHANS */
 #include "patch_set_and_get.h"
 #include "midi_control.h"
-
+#include "gc.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "worker.h"
+#include "engine_private.h"
 
 #include "patch_private/patch_data.h"
 #include "patch_private/patch_defs.h"
@@ -60,32 +64,376 @@
  */
 INLINE_PATCHOK_DEF
 INLINE_PATCH_LOCK_DEF
-INLINE_PATCH_TRYLOCK_DEF
 INLINE_PATCH_UNLOCK_DEF
-INLINE_PATCH_TRIGGER_GLOBAL_LFO_DEF
 
 
-/* triggers all global LFOs if they are used with amounts greater than 0 */
-void patch_trigger_global_lfos ( )
+/*  samples which need resampling are first loaded using the fast
+ *  converter, so the patch is playable straight away, and are then
+ *  reloaded at best quality by a background job.
+ *
+ *  CUR_SAMPLE_SERIAL[id] is bumped whenever the sample of patch id
+ *  is replaced or the patch destroyed, so the job can tell whether the
+ *  sample it was upgrading is still the one in the patch.
+ *  the engine's sample_mutex (CUR_SAMPLE_MUTEX) protects the serials
+ *  and keeps patch_destroy out of the way while the upgraded sample
+ *  is swapped in. the jobs run with the engine they were queued for
+ *  selected (see worker.h), so they take the same mutex.
+ */
+
+/* upgrade and reload jobs queued and not yet done, of every engine */
+static int sample_jobs_pending = 0;
+
+
+/*  samples (and patches) are published to the audio thread by atomic
+ *  pointer swaps and whatever they replace is handed to the gc rather
+ *  than freed, as the audio thread might still be reading it.
+ *
+ *  a new sample only reaches the audio thread along with its points
+ *  through patch_play_publish, which must be called (with the patch
+ *  locked) before the old sample is retired.
+ */
+static void free_sample(void* s)
+{
+    sample_free(s);
+}
+
+
+static void free_patch(void* p)
+{
+    patch_free(p);
+}
+
+
+static Sample* publish_sample(int id, Sample* s)
+{
+    return __atomic_exchange_n(&CUR_PATCHES[id]->sample, s, __ATOMIC_SEQ_CST);
+}
+
+
+typedef struct _sample_upgrade
+{
+    int             id;
+    unsigned int    serial;
+    int             rate;
+    char*           filename;
+    int             raw_samplerate;
+    int             raw_channels;
+    int             sndfile_format;
+
+} sample_upgrade;
+
+
+static void sample_upgrade_job(void* data)
 {
-    int patch_id, lfo_id;
+    sample_upgrade* up = data;
+    Sample* s = 0;
+    Sample* old = 0;
+
+    if (worker_quitting())
+        goto done;
 
-    debug ("retriggering global LFOs...\n");
+    trace_begin("sample upgrade", up->id);
 
-    for (patch_id = 0; patch_id < PATCH_COUNT; patch_id++)
+    if (!(s = sample_new())
+     || sample_load_file(s, up->filename, up->rate, up->raw_samplerate,
+                                                    up->raw_channels,
+                                                    up->sndfile_format,
+                                                    1,
+                                                    SAMPLE_QUALITY_BEST) < 0)
     {
-        if (!patches[patch_id] || !patches[patch_id]->active)
-            continue;
+        debug("failed to upgrade sample %s\n", up->filename);
+        pf_error_get();
+        trace_end("sample upgrade");
+        goto done;
+    }
+
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+
+    if (up->serial == CUR_SAMPLE_SERIAL[up->id]
+     && CUR_PATCHES[up->id]
+     && CUR_PATCHES[up->id]->sample->frames == s->frames)
+    {
+        debug("upgraded sample %s for patch %d\n", up->filename, up->id);
+
+        /* same length, the voices can carry on as they were */
+        patch_lock(up->id);
+        old = publish_sample(up->id, s);
+        patch_play_publish(CUR_PATCHES[up->id], false);
+        patch_unlock(up->id);
+        s = 0;
+    }
+
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    gc_retire(free_sample, old);
+    trace_end("sample upgrade");
+
+done:
+    if (s)
+        sample_free(s);
+
+    free(up->filename);
+    free(up);
+    __atomic_sub_fetch(&sample_jobs_pending, 1, __ATOMIC_RELEASE);
+}
+
+
+/* queues an upgrade or reload job, which is pending until it's done */
+static int sample_job_submit(WorkerFunc func, sample_upgrade* up)
+{
+    __atomic_add_fetch(&sample_jobs_pending, 1, __ATOMIC_RELAXED);
+
+    if (worker_submit(func, up) < 0)
+    {
+        __atomic_sub_fetch(&sample_jobs_pending, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static SampleQuality load_quality(void)
+{
+    /* no point loading fast if there's nobody to upgrade it later */
+    if (__atomic_load_n(&CUR_FAST_RESAMPLE, __ATOMIC_RELAXED)
+     && worker_get_thread_count() > 0)
+        return SAMPLE_QUALITY_FAST;
+
+    return SAMPLE_QUALITY_BEST;
+}
+
+
+/*  describes a best quality reload of patch id's (resampled) sample
+ *  s, with sample_mutex held: once it is let go s may be retired */
+static sample_upgrade* sample_upgrade_new(int id, unsigned int serial,
+                                                    const Sample* s)
+{
+    sample_upgrade* up;
+
+    if (!s->filename || !(up = malloc(sizeof(*up))))
+        return 0;
+
+    up->id = id;
+    up->serial = serial;
+    up->rate = CUR_SAMPLERATE;
+    up->filename = strdup(s->filename);
+    up->raw_samplerate = s->raw_samplerate;
+    up->raw_channels = s->raw_channels;
+    up->sndfile_format = s->sndfile_format;
+
+    if (!up->filename)
+    {
+        free(up);
+        return 0;
+    }
+
+    return up;
+}
+
+
+/* queues what sample_upgrade_new describes, any lock held or not */
+static void sample_upgrade_queue(sample_upgrade* up)
+{
+    if (up && sample_job_submit(sample_upgrade_job, up) < 0)
+    {
+        free(up->filename);
+        free(up);
+    }
+}
+
+
+/* queues a best quality reload of s, with sample_mutex held */
+static void sample_upgrade_submit(int id, unsigned int serial,
+                                                    const Sample* s)
+{
+    sample_upgrade_queue(sample_upgrade_new(id, serial, s));
+}
+
+
+static size_t sample_bytes(const Sample* s)
+{
+    size_t frames = 0;
+
+    if (s->sp)
+        frames += s->frames * 2;
+
+    if (s->source)
+        frames += s->source_frames * s->source_channels;
+
+    return frames * sizeof(float);
+}
+
+
+static int scale_frame(int frame, double ratio, int last);
+
+
+/*  reloads an evicted sample, once the patch has been played again.
+ *  the sample might have been evicted at another rate, in which case
+ *  the points are scaled as they would have been by the rate change.
+ */
+static void sample_reload_job(void* data)
+{
+    sample_upgrade* up = data;
+    sample_upgrade* next = 0;
+    Sample* s = 0;
+    Sample* old = 0;
+    Patch* p;
+    int val = -1;
 
-        for (lfo_id = 0; lfo_id < PATCH_MAX_LFOS; lfo_id++)
+    if (worker_quitting())
+        goto done;
+
+    trace_begin("sample reload", up->id);
+
+    if ((s = sample_new()))
+        val = patch_sample_load_data(s, up->filename, up->raw_samplerate,
+                                                      up->raw_channels,
+                                                      up->sndfile_format);
+    if (val < 0)
+    {
+        debug("failed to reload sample %s\n", up->filename);
+        pf_error_get();
+    }
+
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+
+    if ((p = CUR_PATCHES[up->id]))
+    {
+        /* a stale job can only make way for another */
+        p->reloading = false;
+
+        if (val >= 0 && up->serial == CUR_SAMPLE_SERIAL[up->id])
         {
-            LFO* lfo =          patches[patch_id]->glfo[lfo_id];
-            LFOParams* lfopar = &patches[patch_id]->glfo_params[lfo_id];
-            patch_trigger_global_lfo(patch_id, lfo, lfopar);
+            double ratio = (p->sample->frames > 0)
+                                ? s->frames / (double)p->sample->frames
+                                : 1.0;
+            int last = s->frames - 1;
+
+            debug("reloaded sample %s for patch %d\n", up->filename,
+                                                        up->id);
+            ++CUR_SAMPLE_SERIAL[up->id];
+
+            patch_lock(up->id);
+            old = publish_sample(up->id, s);
+            p->evicted = false;
+
+            if (ratio != 1.0)
+            {
+                p->sample_stop = last;
+                p->play_start = scale_frame(p->play_start, ratio, last);
+                p->play_stop = scale_frame(p->play_stop, ratio, last);
+                p->loop_start = scale_frame(p->loop_start, ratio, last);
+                p->loop_stop = scale_frame(p->loop_stop, ratio, last);
+                p->fade_samples = scale_frame(p->fade_samples, ratio,
+                                                                last);
+                p->xfade_samples = scale_frame(p->xfade_samples, ratio,
+                                                                last);
+            }
+
+            patch_play_publish(p, false);
+            patch_unlock(up->id);
+
+            if (s->quality != SAMPLE_QUALITY_BEST)
+                next = sample_upgrade_new(up->id,
+                                        CUR_SAMPLE_SERIAL[up->id], s);
+            s = 0;
+            telemetry_sample_reloaded();
+        }
+        else if (p->evicted)
+        {   /* not until it's played again */
+            p->evicted_used = __atomic_load_n(&p->last_used,
+                                                    __ATOMIC_RELAXED);
         }
     }
 
-    debug ("done\n");
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    gc_retire(free_sample, old);
+
+    if (s)
+        sample_free(s);
+
+    sample_upgrade_queue(next);
+
+    trace_end("sample reload");
+
+done:
+    free(up->filename);
+    free(up);
+    __atomic_sub_fetch(&sample_jobs_pending, 1, __ATOMIC_RELEASE);
+}
+
+
+/* queues a reload of patch id's evicted sample, with sample_mutex held */
+static void sample_reload_submit(int id)
+{
+    const Sample* s = CUR_PATCHES[id]->sample;
+    sample_upgrade* up = malloc(sizeof(*up));
+
+    if (!up)
+        return;
+
+    up->id = id;
+    up->serial = CUR_SAMPLE_SERIAL[id];
+    up->rate = CUR_SAMPLERATE;
+    up->filename = strdup(s->filename);
+    up->raw_samplerate = s->raw_samplerate;
+    up->raw_channels = s->raw_channels;
+    up->sndfile_format = s->sndfile_format;
+
+    if (!up->filename || sample_job_submit(sample_reload_job, up) < 0)
+    {
+        free(up->filename);
+        free(up);
+        return;
+    }
+
+    CUR_PATCHES[id]->reloading = true;
+}
+
+
+/* frees the data of patch id's sample, with sample_mutex held */
+static size_t sample_evict(int id)
+{
+    Patch* p = CUR_PATCHES[id];
+    size_t bytes = sample_bytes(p->sample);
+    Sample* s;
+    Sample* old;
+
+    if (!(s = sample_new()))
+        return 0;
+
+    debug("evicting sample %s from patch %d\n", p->sample->filename, id);
+
+    /* everything but the data, so it can be reloaded (and saved) */
+    sample_shallow_copy(s, p->sample);
+
+    ++CUR_SAMPLE_SERIAL[id];
+
+    patch_lock(id);
+    old = publish_sample(id, s);
+    p->evicted = true;
+    p->evicted_used = __atomic_load_n(&p->last_used, __ATOMIC_RELAXED);
+    p->reloading = false;
+    patch_play_publish(p, true);
+    patch_unlock(id);
+
+    gc_retire(free_sample, old);
+    telemetry_sample_evicted();
+
+    return bytes;
+}
+
+
+/*  has the audio thread trigger all global LFOs as it next renders
+ *  each patch (see patch_play_sync); safe from any thread, the audio
+ *  thread included */
+void patch_trigger_global_lfos ( )
+{
+    debug ("retriggering global LFOs\n");
+    __atomic_add_fetch(&current_engine->patch->glfo_trigger, 1,
+                                                    __ATOMIC_RELEASE);
 }
 
 
@@ -95,24 +443,25 @@ void patch_do_display_index(int id)
 
     debug("calculating display index for patch id:%d\n", id);
 
-    assert(patches[id]->display_index == -1);
+    assert(CUR_PATCHES[id]->display_index == -1);
 
     for (i = 0; i < PATCH_COUNT; i++)
     {
         if (i == id)
             continue;
 
-        if (patches[i] && patches[i]->active
-         && patches[i]->display_index >= patches[id]->display_index)
+        if (CUR_PATCHES[i] && CUR_PATCHES[i]->active
+         && CUR_PATCHES[i]->display_index >= CUR_PATCHES[id]->display_index)
         {
-            patches[id]->display_index = patches[i]->display_index + 1;
+            CUR_PATCHES[id]->display_index =
+                                    CUR_PATCHES[i]->display_index + 1;
         }
     }
 
-    if (patches[id]->display_index == -1)
-        patches[id]->display_index = 0;
+    if (CUR_PATCHES[id]->display_index == -1)
+        CUR_PATCHES[id]->display_index = 0;
 
-    debug("chosen display: %d\n", patches[id]->display_index);
+    debug("chosen display: %d\n", CUR_PATCHES[id]->display_index);
 }
 
 /**************************************************************************/
@@ -125,20 +474,23 @@ int patch_count()
     int id, count;
 
     for (id = count = 0; id < PATCH_COUNT; id++)
-        if (patches[id] && patches[id]->active)
+        if (CUR_PATCHES[id] && CUR_PATCHES[id]->active)
             count++;
 
     return count;
 }
 
 
-int patch_create(void)
+/*  finds a free slot for a new patch. the patch is not active, and so
+ *  is ignored by the audio thread, until patch_activate is called.
+ */
+static int patch_new_inactive(void)
 {
     Patch* p;
     int id;
 
     /* find first unused patch */
-    for (id = 0; patches[id] && patches[id]->active; ++id)
+    for (id = 0; CUR_PATCHES[id] && CUR_PATCHES[id]->active; ++id)
     {
         if (id == PATCH_COUNT)
         {
@@ -155,11 +507,27 @@ int patch_create(void)
 
     debug("creating patch id:%d (%p)\n", id, p);
 
-    patches[id] = p;
-    patch_lock(id);
-    p->active = true;
+    CUR_PATCHES[id] = p;
     patch_do_display_index(id);
-    patch_unlock(id);
+
+    return id;
+}
+
+
+static void patch_activate(int id)
+{
+    __atomic_store_n(&CUR_PATCHES[id]->active, true, __ATOMIC_RELEASE);
+}
+
+
+int patch_create(void)
+{
+    int id;
+
+    if ((id = patch_new_inactive()) < 0)
+        return -1;
+
+    patch_activate(id);
 
     return id;
 }
@@ -170,17 +538,24 @@ int patch_duplicate(int src_id)
     int id;
 
     assert(patchok(src_id));
-    assert(patches[src_id]->active);
+    assert(CUR_PATCHES[src_id]->active);
 
     debug("\n\nDuplicating patch %s id:%d...\n",
-                patches[src_id]->name, src_id);
+                CUR_PATCHES[src_id]->name, src_id);
 
-    if ((id = patch_create()) < 0)
+    if ((id = patch_new_inactive()) < 0)
         return -1;
 
-    patch_lock(id);
-    patch_copy(patches[id], patches[src_id]);
-    patch_unlock(id);
+    /* the copy is finished before the audio thread gets to see it */
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+    patch_copy(CUR_PATCHES[id], CUR_PATCHES[src_id]);
+
+    /* an evicted sample is copied evicted, to be reloaded when played */
+    CUR_PATCHES[id]->evicted = CUR_PATCHES[src_id]->evicted;
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    patch_play_publish(CUR_PATCHES[id], false);
+    patch_activate(id);
 
     return id;
 }
@@ -195,9 +570,7 @@ int patch_create_default(void)
     if ((id = patch_create()) < 0)
         return id;
 
-    p = patches[id];
-
-    patch_lock(id);
+    p = CUR_PATCHES[id];
 
     p->play_mode = PATCH_PLAY_LOOP;
     p->fade_samples =  DEFAULT_FADE_SAMPLES;
@@ -255,8 +628,6 @@ int patch_create_default(void)
                                 MOD_SRC_MIDI_CC | CC_MOD_WHEEL);
     patch_set_lfo_am1_amt(  id, MOD_SRC_VLFO, 1.0);
 
-    patch_unlock(id);
-
     patch_sample_load(id, "Default", 0, 0, 0);
     p->lower_note = 36;
     p->upper_note = 83;
@@ -278,15 +649,17 @@ void patch_destroy(int id)
 
     debug ("Removing patch: %d\n", id);
 
-    index = patches[id]->display_index;
+    index = CUR_PATCHES[id]->display_index;
 
-    patch_lock(id);
-    p = patches[id];
-    patches[id]->active = false;
-    patch_unlock(id);
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+    ++CUR_SAMPLE_SERIAL[id];
 
-    patches[id] = 0;
-    patch_free(p);
+    p = CUR_PATCHES[id];
+    __atomic_store_n(&p->active, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&CUR_PATCHES[id], 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    gc_retire(free_patch, p);
 
     /* every active patch with a display_index greater than this
      * patch's needs to have it's value decremented so that we
@@ -295,10 +668,10 @@ void patch_destroy(int id)
 
     for (id = 0; id < PATCH_COUNT; id++)
     {
-        if (patches[id] && patches[id]->active
-                        && patches[id]->display_index > index)
+        if (CUR_PATCHES[id] && CUR_PATCHES[id]->active
+                        && CUR_PATCHES[id]->display_index > index)
         {
-            --patches[id]->display_index;
+            --CUR_PATCHES[id]->display_index;
         }
     }
 }
@@ -311,7 +684,7 @@ void patch_destroy_all(void)
     int id;
 
     for (id = 0; id < PATCH_COUNT; id++)
-        if (patches[id])
+        if (CUR_PATCHES[id])
             patch_destroy (id);
 
     return;
@@ -342,7 +715,7 @@ int patch_dump(int **dump)
 
     /* place active patches into dump array */
     for (id = i = 0; id < PATCH_COUNT; id++)
-        if (patches[id] && patches[id]->active)
+        if (CUR_PATCHES[id] && CUR_PATCHES[id]->active)
             (*dump)[i++] = id;
 
     /* sort dump array by channel in ascending order */
@@ -350,8 +723,8 @@ int patch_dump(int **dump)
     {
         for (j = i; j < count; j++)
         {
-            if (patches[(*dump)[j]]->channel <
-                patches[(*dump)[i]]->channel)
+            if (CUR_PATCHES[(*dump)[j]]->channel <
+                CUR_PATCHES[(*dump)[i]]->channel)
             {
                 tmp = (*dump)[i];
                 (*dump)[i] = (*dump)[j];
@@ -366,16 +739,16 @@ int patch_dump(int **dump)
     {
         for (j = 0; j < count; j++)
         {
-            if (patches[(*dump)[j]]->channel != i)
+            if (CUR_PATCHES[(*dump)[j]]->channel != i)
                 continue;
 
             for (k = j; k < count; k++)
             {
-                if (patches[(*dump)[k]]->channel != i)
+                if (CUR_PATCHES[(*dump)[k]]->channel != i)
                     continue;
 
-                if (patches[(*dump)[k]]->root_note <
-                    patches[(*dump)[j]]->root_note)
+                if (CUR_PATCHES[(*dump)[k]]->root_note <
+                    CUR_PATCHES[(*dump)[j]]->root_note)
                 {
                     tmp = (*dump)[j];
                     (*dump)[j] = (*dump)[k];
@@ -389,32 +762,18 @@ int patch_dump(int **dump)
 }
 
 
-/* stop all currently playing voices in given patch */
+/* stop all currently playing voices in given patch; the voices
+ * belong to the audio thread, so it is asked to do it */
 int patch_flush (int id)
 {
-    int i;
-
     assert(patchok(id));
 
     debug("flusing:%d\n",id);
 
     patch_lock (id);
-
-    if (patches[id]->sample->sp == NULL)
-    {
-        patch_unlock (id);
-        return 0;
-    }
-
-    for (i = 0; i < PATCH_VOICE_COUNT; i++)
-    {
-        debug("flushing voice:%d\n",i);
-        patches[id]->voices[i]->active = false;
-    }
-
+    patch_play_publish(CUR_PATCHES[id], true);
     patch_unlock (id);
 
-    debug("done\n");
     return 0;
 }
 
@@ -424,113 +783,204 @@ void patch_flush_all ( )
     int i;
 
     for (i = 0; i < PATCH_COUNT; i++)
-        if (patches[i])
+        if (CUR_PATCHES[i])
             patch_flush (i);
 }
 
 
-/* loads a sample file for a patch */
-int patch_sample_load(int id, const char *name,
+/* loads sample data for a patch without touching any patch, so that
+ * it may be called by worker threads */
+int patch_sample_load_data(Sample* s, const char* name,
                                     int raw_samplerate,
                                     int raw_channels,
                                     int sndfile_format)
 {
-    int val;
-    double ratio = (patch_samplerate == 44100)
+    assert(name != NULL);
+
+    if (strcmp(name, "Default") == 0)
+        return sample_default(s, CUR_SAMPLERATE);
+
+    /* in native rate mode the voices make up the difference */
+    return sample_load_file(s, name, CUR_SAMPLERATE,
+                        raw_samplerate,
+                        raw_channels,
+                        sndfile_format,
+                        !__atomic_load_n(&CUR_NATIVE_RATE, __ATOMIC_RELAXED),
+                        load_quality());
+}
+
+
+/* gives the sample data loaded by patch_sample_load_data to a patch;
+ * val is the value patch_sample_load_data returned. if it indicates
+ * failure s is freed and the patch keeps its old sample data. */
+int patch_sample_install(int id, Sample* s, int val)
+{
+    double ratio = (CUR_SAMPLERATE == 44100)
                             ? 1
-                            : (patch_samplerate / 44100.0f);
+                            : (CUR_SAMPLERATE / 44100.0f);
     int frames;
-
-    bool defsample = (strcmp(name, "Default") == 0);
+    bool defsample = (val >= 0 && s->default_sample);
+    bool upgrade = (val >= 0 && s->quality != SAMPLE_QUALITY_BEST);
+    sample_upgrade* up = 0;
+    unsigned int serial;
+    Sample* old = 0;
 
     assert(patchok(id));
-    assert(name != NULL);
 
-    debug("Loading sample %s for patch %d\n", name, id);
-    patch_flush (id);
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+    serial = ++CUR_SAMPLE_SERIAL[id];
 
-    /* we lock *after* we call patch_flush because patch_flush does
-     * its own locking */
     patch_lock (id);
 
-    if (defsample)
-        val = sample_default(patches[id]->sample, patch_samplerate);
-    else
-        val = sample_load_file(patches[id]->sample, name,
-                                            patch_samplerate,
-                                            raw_samplerate,
-                                            raw_channels,
-                                            sndfile_format,
-                                            1);
-
     if (val < 0)
+    {
+        sample_free(s);
         frames = 0;
+    }
     else
-        frames = patches[id]->sample->frames - 1;
+    {
+        old = publish_sample(id, s);
+        CUR_PATCHES[id]->evicted = CUR_PATCHES[id]->reloading = false;
+        frames = s->frames - 1;
+
+        if (upgrade)
+            up = sample_upgrade_new(id, serial, s);
+    }
 
-    patches[id]->sample_stop = frames;
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
 
-    patches[id]->play_start = 0;
-    patches[id]->play_stop = patches[id]->sample_stop;
+    CUR_PATCHES[id]->sample_stop = frames;
+
+    CUR_PATCHES[id]->play_start = 0;
+    CUR_PATCHES[id]->play_stop = CUR_PATCHES[id]->sample_stop;
 
     if (defsample)
     {
-        patches[id]->loop_start = 296 * ratio;
-        patches[id]->loop_stop = 5203 * ratio;
-        patches[id]->fade_samples = 100 * ratio;
-        patches[id]->xfade_samples = 0;
+        CUR_PATCHES[id]->loop_start = 296 * ratio;
+        CUR_PATCHES[id]->loop_stop = 5203 * ratio;
+        CUR_PATCHES[id]->fade_samples = 100 * ratio;
+        CUR_PATCHES[id]->xfade_samples = 0;
     }
     else
     {
-        patches[id]->fade_samples = (frames / 2 > 100) ? 100 * ratio : 0;
-        patches[id]->xfade_samples = (frames / 2 > 100) ? 100 * ratio : 0;
-        patches[id]->loop_start = patches[id]->xfade_samples;
-        patches[id]->loop_stop = patches[id]->sample_stop -
-                                    patches[id]->xfade_samples;
+        CUR_PATCHES[id]->fade_samples = (frames / 2 > 100) ? 100 * ratio : 0;
+        CUR_PATCHES[id]->xfade_samples = (frames / 2 > 100) ? 100 * ratio : 0;
+        CUR_PATCHES[id]->loop_start = CUR_PATCHES[id]->xfade_samples;
+        CUR_PATCHES[id]->loop_stop = CUR_PATCHES[id]->sample_stop -
+                                    CUR_PATCHES[id]->xfade_samples;
     }
 
-    if (patches[id]->sample_stop < patches[id]->fade_samples)
-        patches[id]->fade_samples = patches[id]->xfade_samples = 0;
+    if (CUR_PATCHES[id]->sample_stop < CUR_PATCHES[id]->fade_samples)
+        CUR_PATCHES[id]->fade_samples = CUR_PATCHES[id]->xfade_samples = 0;
 
+    /* the voices are flushed before the new sample is played */
+    patch_play_publish(CUR_PATCHES[id], true);
     patch_unlock (id);
+
+    gc_retire(free_sample, old);
+
+    /* s may already be on its way out, up has all that's needed */
+    sample_upgrade_queue(up);
+
     return val;
 }
 
 
+/* loads a sample file for a patch */
+int patch_sample_load(int id, const char *name,
+                                    int raw_samplerate,
+                                    int raw_channels,
+                                    int sndfile_format)
+{
+    Sample* s;
+
+    assert(patchok(id));
+    assert(name != NULL);
+
+    debug("Loading sample %s for patch %d\n", name, id);
+
+    if (!(s = sample_new()))
+        return -1;
+
+    return patch_sample_install(id, s,
+                    patch_sample_load_data(s, name, raw_samplerate,
+                                                    raw_channels,
+                                                    sndfile_format));
+}
+
+
 int patch_sample_load_from(int dest_id, int src_id)
 {
     int val;
-    const char* name;
-    bool defsample;
+    const Sample* from;
+    Sample* s;
+    Sample* old;
+    sample_upgrade* up = 0;
+    unsigned int serial;
+    char* filename;
+    bool default_sample;
+    int raw_samplerate;
+    int raw_channels;
+    int sndfile_format;
 
     assert(patchok(dest_id));
     assert(patchok(src_id));
 
-    name = patches[src_id]->sample->filename;
-    defsample = (strcmp(name, "Default") == 0);
-
+    /*  the source patch's sample may be replaced, and freed, while
+        this one loads, so what's needed of it is copied first */
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+    from = CUR_PATCHES[src_id]->sample;
+    filename = from->filename ? strdup(from->filename) : 0;
+    default_sample = from->default_sample;
+    raw_samplerate = from->raw_samplerate;
+    raw_channels = from->raw_channels;
+    sndfile_format = from->sndfile_format;
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    if (!default_sample && !filename)
+        return -1;
 
     debug ("Duplicating sample %s from patch %d to patch %d\n",
-            name,   src_id,     dest_id);
+            default_sample ? "Default" : filename, src_id, dest_id);
 
-    /* lock *after* calling patch_flush because patch_flush
-     * does its own locking
-     */
-    patch_flush(dest_id);
-    patch_lock(dest_id);
+    if (!(s = sample_new()))
+    {
+        free(filename);
+        return -1;
+    }
 
-    sample_shallow_copy(patches[dest_id]->sample, patches[src_id]->sample);
+    /*  no locks are held while loading, which goes as any other
+        load does: not resampled at native rate, and fast first if
+        it's to be upgraded later */
+    val = patch_sample_load_data(s, default_sample ? "Default" : filename,
+                                    raw_samplerate,
+                                    raw_channels,
+                                    sndfile_format);
+    free(filename);
 
-    if (defsample)
-        val = sample_default(patches[dest_id]->sample, patch_samplerate);
-    else
-        val = sample_load_file( patches[dest_id]->sample,
-                                name, patch_samplerate,
-                                patches[src_id]->sample->raw_samplerate,
-                                patches[src_id]->sample->raw_channels,
-                                patches[src_id]->sample->sndfile_format,
-                                1);
+    if (val < 0)
+    {
+        sample_free(s);
+        return val;
+    }
+
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+    serial = ++CUR_SAMPLE_SERIAL[dest_id];
+
+    patch_lock(dest_id);
+    old = publish_sample(dest_id, s);
+    CUR_PATCHES[dest_id]->evicted = CUR_PATCHES[dest_id]->reloading = false;
+    patch_play_publish(CUR_PATCHES[dest_id], true);
     patch_unlock(dest_id);
+
+    if (s->quality != SAMPLE_QUALITY_BEST)
+        up = sample_upgrade_new(dest_id, serial, s);
+
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    gc_retire(free_sample, old);
+    sample_upgrade_queue(up);
+
     return val;
 }
 
@@ -539,12 +989,15 @@ int patch_sample_set_points(int id, int play_start,     int play_stop,
                                     int fade, int xfade)
 {
     assert(patchok(id));
-    patches[id]->play_start = play_start;
-    patches[id]->play_stop = play_stop;
-    patches[id]->loop_start = loop_start;
-    patches[id]->loop_stop = loop_stop;
-    patches[id]->fade_samples = fade;
-    patches[id]->xfade_samples = xfade;
+    patch_lock(id);
+    CUR_PATCHES[id]->play_start = play_start;
+    CUR_PATCHES[id]->play_stop = play_stop;
+    CUR_PATCHES[id]->loop_start = loop_start;
+    CUR_PATCHES[id]->loop_stop = loop_stop;
+    CUR_PATCHES[id]->fade_samples = fade;
+    CUR_PATCHES[id]->xfade_samples = xfade;
+    patch_play_publish(CUR_PATCHES[id], false);
+    patch_unlock(id);
     return 0;
 }
 
@@ -552,26 +1005,53 @@ int patch_sample_set_points(int id, int play_start,     int play_stop,
 const Sample* patch_sample_data(int id)
 {
     assert(patchok(id));
-    return patches[id]->sample;
+    return CUR_PATCHES[id]->sample;
+}
+
+
+unsigned int patch_sample_get_serial(int id)
+{
+    unsigned int serial;
+
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+    serial = CUR_SAMPLE_SERIAL[id];
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    return serial;
 }
 
 
 /* unloads a patch's sample */
 void patch_sample_unload (int id)
 {
+    Sample* s;
+    Sample* old;
+
     assert(patchok(id));
 
     debug ("Unloading sample for patch %d\n", id);
+
+    if (!(s = sample_new()))
+        return;
+
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+    ++CUR_SAMPLE_SERIAL[id];
+
     patch_lock (id);
 
-    sample_free_data(patches[id]->sample);
+    old = publish_sample(id, s);
+    CUR_PATCHES[id]->evicted = CUR_PATCHES[id]->reloading = false;
 
-    patches[id]->play_start = 0;
-    patches[id]->play_stop = 0;
-    patches[id]->loop_start = 0;
-    patches[id]->loop_stop = 0;
+    CUR_PATCHES[id]->play_start = 0;
+    CUR_PATCHES[id]->play_stop = 0;
+    CUR_PATCHES[id]->loop_start = 0;
+    CUR_PATCHES[id]->loop_stop = 0;
 
+    patch_play_publish(CUR_PATCHES[id], true);
     patch_unlock (id);
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    gc_retire(free_sample, old);
 }
 
 /* sets our buffersize and reallocates our lfo_tab; this function
@@ -581,54 +1061,171 @@ void patch_set_buffersize (int nframes)
 {
     int i;
 
-    int oldsize = patch_buffersize;
+    int oldsize = CUR_BUFFERSIZE;
 
     debug ("setting buffersize to %d\n", nframes);
 
-    patch_buffersize = nframes;
+    CUR_BUFFERSIZE = nframes;
 
-    if (patch_buffersize != oldsize)
+    if (CUR_BUFFERSIZE != oldsize)
     {
         for (i = 0; i < PATCH_COUNT; i++)
         {
-            if (patches[i])
-                patch_set_global_lfo_buffers(patches[i], patch_buffersize);
+            if (CUR_PATCHES[i])
+                patch_set_global_lfo_buffers(CUR_PATCHES[i], CUR_BUFFERSIZE);
         }
     }
 }
 
+typedef struct _rate_job
+{
+    int     id;
+    Sample* old;
+    Sample* s;
+    int     val;
+
+} rate_job;
+
+
+/* runs on the worker threads */
+static void rate_change_job(void* data)
+{
+    rate_job* job = data;
+    Sample* old = job->old;
+
+    if (!(job->s = sample_new()))
+    {
+        job->val = -1;
+        pf_error_get();
+        return;
+    }
+
+    if (old->default_sample)
+        job->val = sample_default(job->s, CUR_SAMPLERATE);
+    else if ((job->val = sample_resample(job->s, old, CUR_SAMPLERATE,
+                                                    load_quality())) < 0)
+    {   /* nothing to resample from in memory, back to the file then */
+        job->val = patch_sample_load_data(job->s, old->filename,
+                                                old->raw_samplerate,
+                                                old->raw_channels,
+                                                old->sndfile_format);
+    }
+
+    if (job->val < 0)
+    {
+        debug("failed to resample %s for patch %d\n",
+                                        old->filename, job->id);
+        pf_error_get();
+    }
+}
+
+
+static int scale_frame(int frame, double ratio, int last)
+{
+    int n = frame * ratio;
+    return (n > last) ? last : n;
+}
+
+
 /* sets our samplerate and resamples if necessary; this function
  * doesn't need to do any locking because we have a guarantee that
- * mixing will stop when the samplerate changes */
+ * mixing will stop when the samplerate changes. the samples are
+ * resampled in parallel, from the data in memory where possible,
+ * and keep their play and loop points. */
 void patch_set_samplerate (int rate)
 {
-    int oldrate = patch_samplerate;
+    int oldrate = CUR_SAMPLERATE;
 
     debug ("changing samplerate to %d\n", rate);
 
-    patch_samplerate = rate;
+    CUR_SAMPLERATE = rate;
 
-    if (patch_samplerate != oldrate)
+    if (CUR_SAMPLERATE != oldrate)
     {
+        rate_job jobs[PATCH_COUNT];
+        unsigned int serial[PATCH_COUNT];
         int id;
+        int i;
+        int count = 0;
 
         debug("samplerate changed from %d\n", oldrate);
 
+        if (__atomic_load_n(&CUR_NATIVE_RATE, __ATOMIC_RELAXED))
+        {   /* nothing to resample, prepare_pitch compensates */
+            CUR_LEGATO_LAG = PATCH_LEGATO_LAG * rate;
+            patch_trigger_global_lfos();
+            return;
+        }
+
+        /* holding sample_mutex stops any upgrades being swapped in,
+         * and the serials are bumped so they're all discarded */
+        pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+
         for (id = 0; id < PATCH_COUNT; id++)
         {
-            if (!patches[id] || !patches[id]->active)
+            if (!CUR_PATCHES[id] || !CUR_PATCHES[id]->active)
                 continue;
 
-            if (patches[id]->sample->sp != NULL)
+            serial[id] = ++CUR_SAMPLE_SERIAL[id];
+
+            if (CUR_PATCHES[id]->sample->sp != NULL)
+            {
+                jobs[count].id = id;
+                jobs[count].old = CUR_PATCHES[id]->sample;
+                jobs[count].s = 0;
+                jobs[count].val = -1;
+                ++count;
+            }
+        }
+
+        worker_run_batch(rate_change_job, jobs, count, sizeof(rate_job));
+
+        for (i = 0; i < count; ++i)
+        {
+            Patch* p;
+            Sample* s = jobs[i].s;
+            double ratio;
+            int last;
+
+            id = jobs[i].id;
+            p = CUR_PATCHES[id];
+
+            if (jobs[i].val < 0)
             {
-                Sample* s = patches[id]->sample;
-                patch_sample_load(id, s->filename,  s->raw_samplerate,
-                                                    s->raw_channels,
-                                                    s->sndfile_format);
+                if (s)
+                    sample_free(s);
+
+                continue;
             }
+
+            ratio = (jobs[i].old->frames > 0)
+                        ? s->frames / (double)jobs[i].old->frames
+                        : 1.0;
+            last = s->frames - 1;
+
+            patch_lock(id);
+
+            publish_sample(id, s);
+            p->sample_stop = last;
+            p->play_start = scale_frame(p->play_start, ratio, last);
+            p->play_stop = scale_frame(p->play_stop, ratio, last);
+            p->loop_start = scale_frame(p->loop_start, ratio, last);
+            p->loop_stop = scale_frame(p->loop_stop, ratio, last);
+            p->fade_samples = scale_frame(p->fade_samples, ratio, last);
+            p->xfade_samples = scale_frame(p->xfade_samples, ratio, last);
+
+            patch_play_publish(p, true);
+            patch_unlock(id);
+
+            gc_retire(free_sample, jobs[i].old);
+
+            if (s->quality != SAMPLE_QUALITY_BEST)
+                sample_upgrade_submit(id, serial[id], s);
         }
 
-        patch_legato_lag = PATCH_LEGATO_LAG * rate;
+        pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+        CUR_LEGATO_LAG = PATCH_LEGATO_LAG * rate;
         patch_trigger_global_lfos();
     }
 }
@@ -636,7 +1233,104 @@ void patch_set_samplerate (int rate)
 
 int patch_get_samplerate(void)
 {
-    return patch_samplerate;
+    return CUR_SAMPLERATE;
+}
+
+
+void patch_set_fast_resample(bool fast)
+{
+    __atomic_store_n(&CUR_FAST_RESAMPLE, fast, __ATOMIC_RELAXED);
+}
+
+
+bool patch_get_fast_resample(void)
+{
+    return __atomic_load_n(&CUR_FAST_RESAMPLE, __ATOMIC_RELAXED);
+}
+
+
+int patch_sample_jobs_pending(void)
+{
+    return __atomic_load_n(&sample_jobs_pending, __ATOMIC_ACQUIRE);
+}
+
+
+void patch_set_sample_budget(unsigned long bytes)
+{
+    CUR_SAMPLE_BUDGET = bytes;
+}
+
+
+unsigned long patch_get_sample_budget(void)
+{
+    return CUR_SAMPLE_BUDGET;
+}
+
+
+void patch_sample_budget_poll(void)
+{
+    size_t resident = 0;
+    size_t bytes;
+    unsigned long used[PATCH_COUNT];
+    unsigned long latest = 0;
+    int id;
+
+    pthread_mutex_lock(&CUR_SAMPLE_MUTEX);
+
+    for (id = 0; id < PATCH_COUNT; ++id)
+    {
+        Patch* p = CUR_PATCHES[id];
+
+        if (!p || !p->active)
+            continue;
+
+        used[id] = __atomic_load_n(&p->last_used, __ATOMIC_RELAXED);
+
+        if (used[id] > latest)
+            latest = used[id];
+
+        if (p->evicted)
+        {
+            if (!p->reloading && used[id] != p->evicted_used)
+                sample_reload_submit(id);
+        }
+        else
+            resident += sample_bytes(p->sample);
+    }
+
+    /* least recently played first, but never the last one played */
+    while (CUR_SAMPLE_BUDGET && resident > CUR_SAMPLE_BUDGET)
+    {
+        int lru = -1;
+
+        for (id = 0; id < PATCH_COUNT; ++id)
+        {
+            Patch* p = CUR_PATCHES[id];
+
+            if (!p || !p->active || p->evicted || !p->sample->sp
+             || p->sample->default_sample
+             || (latest && used[id] == latest))
+                continue;
+
+            if (lru < 0 || used[id] < used[lru])
+                lru = id;
+        }
+
+        if (lru < 0 || !(bytes = sample_evict(lru)))
+            break;
+
+        resident -= bytes;
+    }
+
+    pthread_mutex_unlock(&CUR_SAMPLE_MUTEX);
+
+    telemetry_samples(resident, CUR_SAMPLE_BUDGET);
+}
+
+
+void patch_set_native_rate(bool native)
+{
+    __atomic_store_n(&CUR_NATIVE_RATE, native, __ATOMIC_RELAXED);
 }
 
 
@@ -648,7 +1342,7 @@ void patch_shutdown(void)
     debug ("shutting down...\n");
 
     for (i = 0; i < PATCH_COUNT; i++)
-        patch_free(patches[i]);
+        patch_free(CUR_PATCHES[i]);
 
     debug ("done\n");
 }
@@ -672,7 +1366,7 @@ void patch_summary_dump(void)
 
     for (i = 0; i < PATCH_COUNT; ++i)
     {
-        Patch* p = patches[i];
+        Patch* p = CUR_PATCHES[i];
         if (p)
         {
             debug("patch (%p), id:%d '%s' display index:%d active:%s\n",
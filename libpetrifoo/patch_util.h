@@ -54,6 +54,18 @@ int         patch_sample_load     (int id, const char* file,
 
 int         patch_sample_load_from(int dest_id, int src_id);
 
+/*  patch_sample_load split in two: patch_sample_load_data only loads
+    (and resamples) the data and is safe to call from worker threads.
+    patch_sample_install then hands the Sample over to the patch, and
+    must be passed the value returned by patch_sample_load_data.
+ */
+int         patch_sample_load_data(Sample*, const char* file,
+            /* 0 for non-raw data */    int raw_samplerate,
+            /* 0 for non-raw data */    int raw_channels,
+            /* 0 for non-raw data */    int sndfile_format);
+
+int         patch_sample_install  (int id, Sample*, int load_result);
+
 int         patch_sample_set_points(int id, int play_start, int play_stop,
                                             int loop_start, int loop_stop,
                                             int fade_samples,
@@ -62,11 +74,54 @@ const Sample* patch_sample_data(int id);
 
 void        patch_sample_unload   (int id);
 
+/*  changes whenever patch id's sample is replaced, or the patch
+    destroyed, so a sample loaded in the background for the patch can
+    tell whether it is still wanted. any id below PATCH_COUNT may be
+    given, whether there is a patch there or not.
+ */
+unsigned int patch_sample_get_serial(int id);
+
+
+/*  with a sample budget set (in bytes, 0 for none, the default) the
+    samples of the patches played least recently are evicted whenever
+    the sample data in memory comes to more than it: the data is
+    freed, the patch is silent, and once the patch is triggered again
+    its sample is reloaded from the file in the background.
+
+    eviction and reloading are only started by patch_sample_budget_poll,
+    which must be called every so often (not by the RT thread). the
+    last patch played is never evicted, so the budget can be exceeded
+    by a sample bigger than it.
+ */
+void        patch_set_sample_budget(unsigned long bytes);
+unsigned long patch_get_sample_budget(void);
+void        patch_sample_budget_poll(void);
+
 
 void        patch_set_buffersize  (int nframes);
 void        patch_set_samplerate  (int rate);
 int         patch_get_samplerate  (void);
 
+/*  when set (the default) samples needing resampling are first loaded
+    with a fast converter and then upgraded to best quality by a
+    background job on the worker pool. like native rate below, this
+    is a setting of the calling thread's engine.
+ */
+void        patch_set_fast_resample(bool);
+bool        patch_get_fast_resample(void);
+
+/*  how many of those upgrades, and of the reloads of evicted samples
+    (see patch_set_sample_budget), are queued or under way, for all
+    engines. may be called from any thread, the RT thread included.
+ */
+int         patch_sample_jobs_pending(void);
+
+/*  when set samples loaded from then on are not resampled at all but
+    played at their own rate, the difference between it and ours being
+    made up by the voices' pitch. changes of rate then cost nothing.
+ */
+void        patch_set_native_rate (bool);
+
 void        patch_shutdown        (void);
 void        patch_sync            (float bpm);
 int         patch_verify          (int id);
@@ -24,7 +24,9 @@
 #include "pf_error.h"
 #include "petri-foo.h"
 
-static int last_error_no = PF_ERR_INVALID_ERROR;
+/*  each thread has its own error, so that worker threads loading
+    samples at the same time don't trip over each other */
+static __thread int last_error_no = PF_ERR_INVALID_ERROR;
 
 /* FIXME: still not happy with this... */
 
@@ -0,0 +1,294 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "preview.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "petri-foo.h"
+#include "pf_error.h"
+#include "sample.h"
+
+
+enum {
+    PREVIEW_CHUNK =     1024,   /* frames per slot */
+    PREVIEW_SLOTS =     32,     /* must be a power of two */
+    PREVIEW_WAIT_US =   5000    /* reader's wait for a free slot */
+};
+
+
+/*  a chunk of the file. slots whose serial is not the current serial
+    belong to a preview since stopped, and are skipped by the audio
+    thread. */
+typedef struct _PreviewSlot
+{
+    unsigned int    serial;
+    int             frames;
+    float           data[PREVIEW_CHUNK * 2];
+
+} PreviewSlot;
+
+
+typedef struct _PreviewRequest
+{
+    char*   name;
+    int     rate;
+    int     raw_samplerate;
+    int     raw_channels;
+    int     sndfile_format;
+    int     resample_sndfile;
+
+} PreviewRequest;
+
+
+/*  the ring: written only by the reader thread, read only by the audio
+    thread. slot_write and slot_read count slots, not wrapping until
+    they overflow. */
+static PreviewSlot      slots[PREVIEW_SLOTS];
+static unsigned long    slot_write = 0;
+static unsigned long    slot_read = 0;
+static int              read_pos = 0;   /* audio thread's, in frames */
+
+/* bumped by every start or stop */
+static unsigned int     serial = 0;
+
+static PreviewRequest   request;
+static bool             pending = false;
+static bool             quit = false;
+static bool             running = false;
+static pthread_t        thread;
+
+/* protects request, pending and quit */
+static pthread_mutex_t  mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   cond = PTHREAD_COND_INITIALIZER;
+
+
+static bool preview_cancelled(unsigned int ser)
+{
+    return __atomic_load_n(&serial, __ATOMIC_ACQUIRE) != ser
+        || __atomic_load_n(&quit, __ATOMIC_ACQUIRE);
+}
+
+
+static void preview_read(const PreviewRequest* req, unsigned int ser)
+{
+    SampleReader* r;
+    PreviewSlot* slot;
+    unsigned long w;
+    long n;
+
+    if (!(r = sample_reader_open(req->name, req->rate,
+                                            req->raw_samplerate,
+                                            req->raw_channels,
+                                            req->sndfile_format,
+                                            req->resample_sndfile,
+                                            SAMPLE_QUALITY_FAST)))
+    {
+        pf_error_get();
+        return;
+    }
+
+    w = slot_write;
+
+    while (!preview_cancelled(ser))
+    {
+        if (w - __atomic_load_n(&slot_read, __ATOMIC_ACQUIRE)
+                                                    >= PREVIEW_SLOTS)
+        {   /* ring is full */
+            usleep(PREVIEW_WAIT_US);
+            continue;
+        }
+
+        slot = &slots[w & (PREVIEW_SLOTS - 1)];
+
+        if ((n = sample_reader_read(r, slot->data, PREVIEW_CHUNK)) <= 0)
+            break;
+
+        slot->serial = ser;
+        slot->frames = n;
+
+        __atomic_store_n(&slot_write, ++w, __ATOMIC_RELEASE);
+    }
+
+    pf_error_get();
+    sample_reader_close(r);
+}
+
+
+static void* preview_thread(void* arg)
+{
+    PreviewRequest req;
+    unsigned int ser;
+
+    (void)arg;
+
+    pthread_mutex_lock(&mutex);
+
+    while (!quit)
+    {
+        if (!pending)
+        {
+            pthread_cond_wait(&cond, &mutex);
+            continue;
+        }
+
+        req = request;
+        request.name = 0;
+        pending = false;
+        ser = __atomic_load_n(&serial, __ATOMIC_ACQUIRE);
+
+        pthread_mutex_unlock(&mutex);
+
+        preview_read(&req, ser);
+        free(req.name);
+
+        pthread_mutex_lock(&mutex);
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return 0;
+}
+
+
+int preview_init(void)
+{
+    if (running)
+        return 0;
+
+    debug("starting preview thread\n");
+
+    quit = false;
+
+    if (pthread_create(&thread, NULL, preview_thread, NULL) != 0)
+        return -1;
+
+    running = true;
+
+    return 0;
+}
+
+
+void preview_shutdown(void)
+{
+    if (!running)
+        return;
+
+    debug("stopping preview thread...\n");
+
+    pthread_mutex_lock(&mutex);
+    __atomic_store_n(&quit, true, __ATOMIC_RELEASE);
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_join(thread, NULL);
+    running = false;
+
+    free(request.name);
+    request.name = 0;
+    pending = false;
+
+    debug("done\n");
+}
+
+
+void preview_start(const char* name, int rate,
+                                        int raw_samplerate,
+                                        int raw_channels,
+                                        int sndfile_format,
+                                        int resample_sndfile)
+{
+    char* copy = strdup(name);
+
+    if (!copy)
+        return;
+
+    pthread_mutex_lock(&mutex);
+
+    /* the audio thread drops whatever was playing straight away */
+    __atomic_add_fetch(&serial, 1, __ATOMIC_RELEASE);
+
+    free(request.name);
+    request.name = copy;
+    request.rate = rate;
+    request.raw_samplerate = raw_samplerate;
+    request.raw_channels = raw_channels;
+    request.sndfile_format = sndfile_format;
+    request.resample_sndfile = resample_sndfile;
+    pending = true;
+
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+
+void preview_stop(void)
+{
+    pthread_mutex_lock(&mutex);
+    __atomic_add_fetch(&serial, 1, __ATOMIC_RELEASE);
+    free(request.name);
+    request.name = 0;
+    pending = false;
+    pthread_mutex_unlock(&mutex);
+}
+
+
+void preview_render(float* left, float* right, int frames,
+                                                float amplitude)
+{
+    unsigned int ser = __atomic_load_n(&serial, __ATOMIC_ACQUIRE);
+    unsigned long r = slot_read;
+    PreviewSlot* slot;
+    int i = 0;
+    int j;
+    int n;
+
+    while (i < frames && r != __atomic_load_n(&slot_write,
+                                                    __ATOMIC_ACQUIRE))
+    {
+        slot = &slots[r & (PREVIEW_SLOTS - 1)];
+
+        if (slot->serial == ser)
+        {
+            n = slot->frames - read_pos;
+
+            if (n > frames - i)
+                n = frames - i;
+
+            for (j = 0; j < n; ++j)
+            {
+                left[i + j] += slot->data[(read_pos + j) * 2] * amplitude;
+                right[i + j] +=
+                            slot->data[(read_pos + j) * 2 + 1] * amplitude;
+            }
+
+            i += n;
+
+            if ((read_pos += n) < slot->frames)
+                break;
+        }
+
+        /* finished with (or skipping) the slot, hand it back */
+        read_pos = 0;
+        __atomic_store_n(&slot_read, ++r, __ATOMIC_RELEASE);
+    }
+}
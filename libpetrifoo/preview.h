@@ -0,0 +1,53 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __PREVIEW_H__
+#define __PREVIEW_H__
+
+
+/*  preview
+        plays sample files (ie those being browsed for) as they are
+        read from disk. a reader thread reads the file a chunk at a
+        time into a small ring of buffers which the audio thread plays
+        from, so playback starts as soon as the first chunk is in and
+        the audio thread never waits, allocates or frees.
+ */
+
+
+int     preview_init(void);
+void    preview_shutdown(void);
+
+
+/*  *** NOT for usage by RT thread ***
+    preview_start stops whatever is playing and returns straight away,
+    the file is opened by the reader thread.
+ */
+void    preview_start(const char* name, int rate,
+    /* zero for non-raw data */         int raw_samplerate,
+    /* zero for non-raw data */         int raw_channels,
+    /* zero for non-raw data */         int sndfile_format,
+                                        int resample_sndfile);
+void    preview_stop(void);
+
+
+/* RT thread only: mixes frames of the preview into left and right */
+void    preview_render(float* left, float* right, int frames,
+                                                float amplitude);
+
+
+#endif /* __PREVIEW_H__ */
@@ -0,0 +1,307 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/* for RTLD_NEXT */
+#define _GNU_SOURCE
+
+#include "rtaudit.h"
+
+
+#if RT_AUDIT
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* magic numbers */
+enum
+{
+    AUDIT_DEPTH =   32,     /* frames of backtrace */
+    AUDIT_SITES =   256,    /* call sites told apart */
+};
+
+
+typedef struct _AuditSite
+{
+    unsigned long   hash;   /* of the backtrace */
+    const char*     what;
+    unsigned long   count;
+
+} AuditSite;
+
+
+/*  initial-exec, so reading them never calls __tls_get_addr, which
+    may itself allocate */
+#define AUDIT_TLS __thread __attribute__((tls_model("initial-exec")))
+
+static AUDIT_TLS bool   in_rt = false;
+static AUDIT_TLS bool   reporting = false;
+
+static int              report_fd = STDERR_FILENO;
+static bool             report_lock = false;
+static unsigned long    violations = 0;
+static AuditSite        sites[AUDIT_SITES];
+static int              site_count = 0;
+
+
+/* glibc's own, which the wrappers below pass on to */
+extern void*    __libc_malloc(size_t);
+extern void*    __libc_calloc(size_t, size_t);
+extern void*    __libc_realloc(void*, size_t);
+extern void     __libc_free(void*);
+
+static int      (*real_mutex_lock)(pthread_mutex_t*) = 0;
+static int      (*real_cond_wait)(pthread_cond_t*, pthread_mutex_t*) = 0;
+static ssize_t  (*real_read)(int, void*, size_t) = 0;
+static ssize_t  (*real_write)(int, const void*, size_t) = 0;
+static int      (*real_usleep)(useconds_t) = 0;
+static int      (*real_nanosleep)(const struct timespec*,
+                                  struct timespec*) = 0;
+
+
+static void resolve(void)
+{
+    real_mutex_lock =   dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    real_cond_wait =    dlsym(RTLD_NEXT, "pthread_cond_wait");
+    real_read =         dlsym(RTLD_NEXT, "read");
+    real_write =        dlsym(RTLD_NEXT, "write");
+    real_usleep =       dlsym(RTLD_NEXT, "usleep");
+    real_nanosleep =    dlsym(RTLD_NEXT, "nanosleep");
+}
+
+
+/* returns the site for hash, or NULL if the table is full */
+static AuditSite* find_site(unsigned long hash, const char* what,
+                                                        bool* is_new)
+{
+    int i;
+
+    *is_new = false;
+
+    for (i = 0; i < site_count; ++i)
+        if (sites[i].hash == hash)
+            return &sites[i];
+
+    if (site_count == AUDIT_SITES)
+        return 0;
+
+    *is_new = true;
+    sites[site_count].hash = hash;
+    sites[site_count].what = what;
+    sites[site_count].count = 0;
+
+    return &sites[site_count++];
+}
+
+
+static void violation(const char* what)
+{
+    void* frames[AUDIT_DEPTH];
+    unsigned long hash = 5381;
+    AuditSite* site;
+    bool is_new;
+    int n;
+    int i;
+
+    if (!in_rt || reporting)
+        return;
+
+    /* anything we call from here on is on us, not the audio thread */
+    reporting = true;
+
+    __atomic_add_fetch(&violations, 1, __ATOMIC_RELAXED);
+
+    n = backtrace(frames, AUDIT_DEPTH);
+
+    for (i = 0; i < n; ++i)
+        hash = hash * 33 + (uintptr_t)frames[i];
+
+    while (__atomic_exchange_n(&report_lock, true, __ATOMIC_ACQUIRE))
+        ;
+
+    site = find_site(hash, what, &is_new);
+
+    if (site)
+        site->count++;
+
+    if (is_new || !site)
+    {
+        dprintf(report_fd, "\n%s in the audio thread:\n", what);
+        backtrace_symbols_fd(frames, n, report_fd);
+    }
+
+    __atomic_store_n(&report_lock, false, __ATOMIC_RELEASE);
+
+    reporting = false;
+}
+
+
+__attribute__((constructor))
+static void audit_init(void)
+{
+    const char* path = getenv("PETRI_FOO_RT_AUDIT");
+    void* frames[1];
+    int fd;
+
+    resolve();
+
+    /* the first backtrace loads libgcc, let that happen here */
+    backtrace(frames, 1);
+
+    if (path && (fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) >= 0)
+        report_fd = fd;
+
+    dprintf(report_fd, "real-time safety audit enabled\n");
+}
+
+
+__attribute__((destructor))
+static void audit_shutdown(void)
+{
+    int i;
+
+    dprintf(report_fd, "\n%lu real-time safety violations at %d call "
+                       "sites\n", rt_audit_violations(), site_count);
+
+    for (i = 0; i < site_count; ++i)
+        dprintf(report_fd, "  site %d: %s x %lu\n", i + 1,
+                                    sites[i].what, sites[i].count);
+
+    if (report_fd != STDERR_FILENO)
+        close(report_fd);
+}
+
+
+void rt_audit_enter(void)
+{
+    in_rt = true;
+}
+
+
+void rt_audit_leave(void)
+{
+    in_rt = false;
+}
+
+
+unsigned long rt_audit_violations(void)
+{
+    return __atomic_load_n(&violations, __ATOMIC_RELAXED);
+}
+
+
+/*  the wrappers: as libpetrifoo is linked statically, these take the
+    place of libc's for the whole program */
+
+void* malloc(size_t size)
+{
+    violation("malloc");
+    return __libc_malloc(size);
+}
+
+
+void* calloc(size_t n, size_t size)
+{
+    violation("calloc");
+    return __libc_calloc(n, size);
+}
+
+
+void* realloc(void* ptr, size_t size)
+{
+    violation("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+
+void free(void* ptr)
+{
+    violation("free");
+    __libc_free(ptr);
+}
+
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    if (!real_mutex_lock)
+        resolve();
+
+    violation("pthread_mutex_lock");
+    return real_mutex_lock(mutex);
+}
+
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
+{
+    if (!real_cond_wait)
+        resolve();
+
+    violation("pthread_cond_wait");
+    return real_cond_wait(cond, mutex);
+}
+
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+    if (!real_read)
+        resolve();
+
+    violation("read");
+    return real_read(fd, buf, count);
+}
+
+
+ssize_t write(int fd, const void* buf, size_t count)
+{
+    if (!real_write)
+        resolve();
+
+    violation("write");
+    return real_write(fd, buf, count);
+}
+
+
+int usleep(useconds_t usec)
+{
+    if (!real_usleep)
+        resolve();
+
+    violation("usleep");
+    return real_usleep(usec);
+}
+
+
+int nanosleep(const struct timespec* req, struct timespec* rem)
+{
+    if (!real_nanosleep)
+        resolve();
+
+    violation("nanosleep");
+    return real_nanosleep(req, rem);
+}
+
+
+#endif /* RT_AUDIT */
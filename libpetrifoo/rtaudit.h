@@ -0,0 +1,58 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __RTAUDIT_H__
+#define __RTAUDIT_H__
+
+
+#include <config.h>
+
+
+/*  rtaudit
+        catches the audio thread doing what it must not: while a thread
+        is between rt_audit_enter and rt_audit_leave, any call it makes
+        to malloc, calloc, realloc, free, pthread_mutex_lock,
+        pthread_cond_wait, read, write, usleep or nanosleep is counted,
+        and the first from each call site is reported with a backtrace.
+
+        the report goes to the file named by the PETRI_FOO_RT_AUDIT
+        environment variable, or to stderr, with a summary of the
+        call sites at exit.
+
+        only built in when configured with RTSafetyAudit, as it
+        replaces the allocator for the whole program. otherwise all of
+        this compiles away to nothing.
+ */
+
+
+#if RT_AUDIT
+
+void            rt_audit_enter(void);
+void            rt_audit_leave(void);
+unsigned long   rt_audit_violations(void);
+
+#else
+
+#define         rt_audit_enter()
+#define         rt_audit_leave()
+#define         rt_audit_violations()   0UL
+
+#endif
+
+
+#endif /* __RTAUDIT_H__ */
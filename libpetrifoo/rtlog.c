@@ -0,0 +1,356 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "rtlog.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/* magic numbers */
+enum
+{
+    RTLOG_QUEUE =       256,    /* must be a power of two */
+    RTLOG_MSG_LEN =     512,
+    RTLOG_SPEC_LEN =    32,
+    RTLOG_THREAD_MS =   50,
+};
+
+
+typedef union _RTLogArg
+{
+    long            l;
+    unsigned long   ul;
+    double          d;
+    const void*     p;
+
+} RTLogArg;
+
+
+/*  a queue slot. like the mixer's event queue, seq says whose turn it
+    is, only less the slot's index, so the queue needs no setting up:
+    it is free for the producer claiming position pos when it equals
+    pos rounded down to a whole lap, and holds a message for the
+    consumer when it is one more than that. */
+typedef struct _RTLogCell
+{
+    unsigned long   seq;
+    int             level;
+    const char*     fmt;
+    int             nargs;
+    char            type[RTLOG_MAX_ARGS];
+    RTLogArg        arg[RTLOG_MAX_ARGS];
+
+} RTLogCell;
+
+
+static RTLogCell        queue[RTLOG_QUEUE];
+static unsigned long    enqueue_pos = 0;
+static unsigned long    dequeue_pos = 0;
+static unsigned long    dropped = 0;
+
+static RTLogSink        sink = 0;
+
+static pthread_t        thread;
+static bool             running = false;
+static bool             quit = false;
+
+
+#define LAP(pos) ((pos) & ~(unsigned long)(RTLOG_QUEUE - 1))
+
+
+/*  moves past the flags, width, precision and length of the conversion
+    at f (just after the '%'), setting *islong for 'l' */
+static const char* skip_spec(const char* f, bool* islong)
+{
+    *islong = false;
+
+    while (*f && strchr("-+ #0123456789.", *f))
+        ++f;
+
+    while (*f == 'l' || *f == 'h')
+    {
+        if (*f == 'l')
+            *islong = true;
+        ++f;
+    }
+
+    return f;
+}
+
+
+/* the argument types: int, long, unsigned, unsigned long, double,
+ * pointer, or 0 for a conversion which isn't supported */
+static char arg_type(char conv, bool islong)
+{
+    switch (conv)
+    {
+    case 'd': case 'i': case 'c':
+        return islong ? 'L' : 'i';
+
+    case 'u': case 'x': case 'X': case 'o':
+        return islong ? 'U' : 'u';
+
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+        return 'f';
+
+    case 's': case 'p':
+        return 'p';
+
+    default:
+        return 0;
+    }
+}
+
+
+void rtlog(int level, const char* fmt, ...)
+{
+    RTLogCell* cell;
+    unsigned long pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    const char* f;
+    bool islong;
+    va_list ap;
+    long diff;
+    char type;
+    int n = 0;
+
+    for (;;)
+    {
+        cell = &queue[pos & (RTLOG_QUEUE - 1)];
+        diff = (long)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE)
+                                                            - LAP(pos));
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1,
+                                            true,   __ATOMIC_RELAXED,
+                                                    __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+        {
+            __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    }
+
+    va_start(ap, fmt);
+
+    for (f = fmt; *f && n < RTLOG_MAX_ARGS; ++f)
+    {
+        if (*f != '%' || *++f == '%')
+            continue;
+
+        f = skip_spec(f, &islong);
+
+        if (!(type = arg_type(*f, islong)))
+            break;
+
+        switch (type)
+        {
+        case 'i':   cell->arg[n].l = va_arg(ap, int);               break;
+        case 'L':   cell->arg[n].l = va_arg(ap, long);              break;
+        case 'u':   cell->arg[n].ul = va_arg(ap, unsigned int);     break;
+        case 'U':   cell->arg[n].ul = va_arg(ap, unsigned long);    break;
+        case 'f':   cell->arg[n].d = va_arg(ap, double);            break;
+        default:    cell->arg[n].p = va_arg(ap, const void*);       break;
+        }
+
+        cell->type[n++] = type;
+    }
+
+    va_end(ap);
+
+    cell->level = level;
+    cell->fmt = fmt;
+    cell->nargs = n;
+
+    __atomic_store_n(&cell->seq, LAP(pos) + 1, __ATOMIC_RELEASE);
+}
+
+
+/* formats cell's message into buf, as printf would have */
+static void format_cell(char* buf, size_t len, const RTLogCell* cell)
+{
+    char spec[RTLOG_SPEC_LEN];
+    const char* f = cell->fmt;
+    const char* start;
+    size_t used = 0;
+    size_t speclen;
+    bool islong;
+    int n = 0;
+    int rc;
+
+    buf[0] = '\0';
+
+    while (*f && used < len - 1)
+    {
+        if (*f != '%' || n == cell->nargs)
+        {
+            /* a literal, or past the last argument kept */
+            if (*f == '%' && f[1] == '%')
+                ++f;
+
+            buf[used++] = *f++;
+            buf[used] = '\0';
+            continue;
+        }
+
+        if (f[1] == '%')
+        {
+            buf[used++] = '%';
+            buf[used] = '\0';
+            f += 2;
+            continue;
+        }
+
+        start = f;
+        f = skip_spec(f + 1, &islong) + 1;
+        speclen = f - start;
+
+        if (speclen >= RTLOG_SPEC_LEN)
+            break;
+
+        memcpy(spec, start, speclen);
+        spec[speclen] = '\0';
+
+        switch (cell->type[n])
+        {
+        case 'i':
+            rc = snprintf(buf + used, len - used, spec, (int)cell->arg[n].l);
+            break;
+        case 'L':
+            rc = snprintf(buf + used, len - used, spec, cell->arg[n].l);
+            break;
+        case 'u':
+            rc = snprintf(buf + used, len - used, spec,
+                                            (unsigned int)cell->arg[n].ul);
+            break;
+        case 'U':
+            rc = snprintf(buf + used, len - used, spec, cell->arg[n].ul);
+            break;
+        case 'f':
+            rc = snprintf(buf + used, len - used, spec, cell->arg[n].d);
+            break;
+        default:
+            rc = snprintf(buf + used, len - used, spec, cell->arg[n].p);
+            break;
+        }
+
+        ++n;
+
+        if (rc < 0)
+            break;
+
+        used += ((size_t)rc < len - used) ? (size_t)rc : len - used - 1;
+    }
+}
+
+
+static void stderr_sink(int level, const char* msg)
+{
+    (void)level;
+    fputs(msg, stderr);
+}
+
+
+void rtlog_set_sink(RTLogSink func)
+{
+    sink = func;
+}
+
+
+int rtlog_dispatch(void)
+{
+    RTLogCell* cell;
+    char msg[RTLOG_MSG_LEN];
+    int count = 0;
+
+    for (;;)
+    {
+        cell = &queue[dequeue_pos & (RTLOG_QUEUE - 1)];
+
+        if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE)
+                                                != LAP(dequeue_pos) + 1)
+            break;
+
+        format_cell(msg, sizeof(msg), cell);
+        (sink ? sink : stderr_sink)(cell->level, msg);
+
+        __atomic_store_n(&cell->seq, LAP(dequeue_pos) + RTLOG_QUEUE,
+                                                    __ATOMIC_RELEASE);
+        ++dequeue_pos;
+        ++count;
+    }
+
+    return count;
+}
+
+
+unsigned long rtlog_dropped(void)
+{
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+
+static void* rtlog_thread(void* arg)
+{
+    (void)arg;
+
+    while (!__atomic_load_n(&quit, __ATOMIC_ACQUIRE))
+    {
+        rtlog_dispatch();
+        usleep(RTLOG_THREAD_MS * 1000);
+    }
+
+    return 0;
+}
+
+
+int rtlog_start(void)
+{
+    if (running)
+        return 0;
+
+    quit = false;
+
+    if (pthread_create(&thread, NULL, rtlog_thread, NULL) != 0)
+        return -1;
+
+    running = true;
+
+    return 0;
+}
+
+
+void rtlog_stop(void)
+{
+    if (!running)
+        return;
+
+    __atomic_store_n(&quit, true, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    running = false;
+
+    rtlog_dispatch();
+}
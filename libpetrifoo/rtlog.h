@@ -0,0 +1,88 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __RTLOG_H__
+#define __RTLOG_H__
+
+
+#include "petri-foo.h"
+
+
+/*  rtlog
+        logging for the engine's own threads (audio, MIDI), which can't
+        afford to format, lock or write. rtlog copies the format and
+        its arguments into a lock-free queue, and they are formatted
+        and passed to the sink later, by whichever thread calls
+        rtlog_dispatch (the GUI's main loop in petri-foo, the thread
+        started by rtlog_start elsewhere).
+
+        the format is kept by pointer, so must be a string literal, as
+        must any %s argument. conversions are limited to d, i, c, u,
+        x, X and o (optionally l), f, e, g, s and p, with flags, width
+        and precision but not '*'. at most RTLOG_MAX_ARGS arguments
+        are kept.
+
+        messages which find the queue full are counted and dropped.
+ */
+
+
+enum
+{
+    RTLOG_DEBUG,
+    RTLOG_MESSAGE,
+    RTLOG_WARNING,
+    RTLOG_ERROR,
+
+    RTLOG_MAX_ARGS = 8
+};
+
+
+/* level is one of the RTLOG_ enums, msg is the formatted message */
+typedef void (*RTLogSink)(int level, const char* msg);
+
+
+/* any thread, RT included */
+void    rtlog(int level, const char* fmt, ...)
+                                __attribute__((format(printf, 2, 3)));
+
+
+/*  *** NOT for usage by RT thread ***
+    the sink defaults to stderr. rtlog_dispatch passes whatever is
+    queued to the sink, returning how many messages it passed; it
+    must not be called by more than one thread at once. */
+void            rtlog_set_sink(RTLogSink);
+int             rtlog_dispatch(void);
+unsigned long   rtlog_dropped(void);
+
+
+/*  *** NOT for usage by RT thread ***
+    for when there is no main loop to call rtlog_dispatch: starts (or
+    stops, dispatching what is left) a thread which does. */
+int     rtlog_start(void);
+void    rtlog_stop(void);
+
+
+/* the RT thread's debug() */
+#if DEBUG
+#define rtdebug(...)    rtlog(RTLOG_DEBUG, __VA_ARGS__)
+#else
+#define rtdebug(...)
+#endif
+
+
+#endif /* __RTLOG_H__ */
@@ -37,6 +37,9 @@
 #include <sys/stat.h>
 
 
+static bool keep_source = false;
+
+
 Sample* sample_new(void)
 {
     Sample* sample = malloc(sizeof(*sample));
@@ -56,6 +59,14 @@ Sample* sample_new(void)
     sample->sndfile_format = 0;
 
     sample->default_sample = false;
+    sample->quality = SAMPLE_QUALITY_BEST;
+
+    sample->samplerate = 0;
+    sample->source_samplerate = 0;
+
+    sample->source = 0;
+    sample->source_frames = 0;
+    sample->source_channels = 0;
 
     return sample;
 }
@@ -65,10 +76,17 @@ void sample_free (Sample* sample)
 {
     free(sample->filename);
     free(sample->sp);
+    free(sample->source);
     free(sample);
 }
 
 
+void sample_set_keep_source(bool keep)
+{
+    __atomic_store_n(&keep_source, keep, __ATOMIC_RELAXED);
+}
+
+
 void sample_shallow_copy(Sample* dest, const Sample* src)
 {
     dest->sp =              0;
@@ -81,6 +99,14 @@ void sample_shallow_copy(Sample* dest, const Sample* src)
 
     dest->filename =        (!src->filename) ? 0 : strdup(src->filename);
     dest->default_sample =  src->default_sample;
+    dest->quality =         src->quality;
+
+    dest->samplerate =          src->samplerate;
+    dest->source_samplerate =   src->source_samplerate;
+
+    dest->source =          0;
+    dest->source_frames =   0;
+    dest->source_channels = 0;
 }
 
 
@@ -127,113 +153,178 @@ int sample_default(Sample* sample, int rate)
 
     sample->filename = strdup("Default");
     sample->default_sample = true;
+    sample->quality = SAMPLE_QUALITY_BEST;
+    sample->samplerate = sample->source_samplerate = rate;
 
     return 0;
 }
 
 
-static float* resample(float* samples, int rate, SF_INFO* sfinfo)
+/*  sample_stream
+        converts audio a chunk at a time: resampling it (if the rates
+        differ) and converting it to stereo, into a buffer allocated
+        up front at exactly the final size. this way loading never
+        holds more than the final data plus a chunk or two.
+ */
+enum { STREAM_CHUNK = 4096 }; /* frames */
+
+
+typedef struct _sample_stream
 {
-    double ratio;
-    int err;
-    SRC_DATA src;
-    float* tmp;
+    SRC_STATE*  src;        /* null if not resampling */
+    double      ratio;
+    int         channels;   /* of the input */
 
-    ratio = rate / (sfinfo->samplerate * 1.0);
+    float*      out;        /* stereo */
+    int         frames;     /* final size of out */
+    int         pos;        /* frames written to out so far */
 
-    debug("Resampling from %d to %d\n", rate, sfinfo->samplerate);
+    float       buf[STREAM_CHUNK * 2];  /* resampler output */
 
-    src.src_ratio = ratio;
-    src.data_in = samples;
-    src.input_frames = sfinfo->frames;
-    src.output_frames = sfinfo->frames * ratio;
+} sample_stream;
 
-    if (src.output_frames >= MAX_SAMPLE_FRAMES)
+
+static int stream_init(sample_stream* st, int channels, int in_rate,
+                                    int out_rate, sf_count_t in_frames,
+                                    SampleQuality quality)
+{
+    sf_count_t frames;
+    int err;
+
+    st->src = 0;
+    st->ratio = 1.0;
+    st->channels = channels;
+    st->pos = 0;
+
+    if (in_rate != out_rate)
     {
-        pf_error(PF_ERR_SAMPLE_RESAMPLE_MAX_FRAMES);
-        return 0;
+        debug("Resampling from %d to %d\n", in_rate, out_rate);
+        st->ratio = out_rate / (in_rate * 1.0);
     }
 
-    tmp = malloc(sizeof(float)
-                * sfinfo->frames * sfinfo->channels * ratio);
-    if (!tmp)
+    /* the length depends only on the ratio, never on the quality */
+    frames = in_frames * st->ratio;
+
+    if (frames >= MAX_SAMPLE_FRAMES)
     {
-        pf_error(PF_ERR_SAMPLE_RESAMPLE_ALLOC);
-        return 0;
+        pf_error((in_rate != out_rate)  ? PF_ERR_SAMPLE_RESAMPLE_MAX_FRAMES
+                                        : PF_ERR_SAMPLE_MAX_FRAMES);
+        return -1;
     }
 
-    src.data_out = tmp;
+    st->frames = frames;
 
-    err = src_simple(&src, SRC_SINC_BEST_QUALITY, sfinfo->channels);
-    if (err)
+    if (!(st->out = malloc(sizeof(float) * (frames ? frames : 1) * 2)))
     {
-        pf_error(PF_ERR_SAMPLE_SRC_SIMPLE);
-        free(tmp);
-        return 0;
+        pf_error(PF_ERR_SAMPLE_ALLOC);
+        return -1;
     }
 
-    sfinfo->frames = src.output_frames;
+    if (in_rate != out_rate)
+    {
+        st->src = src_new((quality == SAMPLE_QUALITY_BEST)
+                                ? SRC_SINC_BEST_QUALITY
+                                : SRC_SINC_FASTEST,
+                                channels, &err);
+        if (!st->src)
+        {
+            pf_error(PF_ERR_SAMPLE_SRC_SIMPLE);
+            free(st->out);
+            return -1;
+        }
+    }
 
-    return tmp;
+    return 0;
 }
 
 
-static float* mono_to_stereo(float* samples, SF_INFO* sfinfo)
+static void to_stereo(float* out, const float* in, long frames,
+                                                    int channels)
 {
-    debug("Converting mono to stereo...\n");
-
-    int i;
-    float* tmp = malloc(sizeof(float) * sfinfo->frames * 2);
+    long i;
 
-    if (!tmp)
+    if (channels == 2)
+        memcpy(out, in, sizeof(float) * frames * 2);
+    else
     {
-        pf_error(PF_ERR_SAMPLE_CHANNEL_ALLOC);
-        return 0;
+        for (i = 0; i < frames; ++i)
+            out[2 * i] = out[2 * i + 1] = in[i];
     }
+}
 
-    for (i = 0; i < sfinfo->frames; i++)
-        tmp[2 * i] = tmp[2 * i + 1] = samples[i];
 
-    return tmp;
+/* appends frames to out, converting mono to stereo */
+static void stream_store(sample_stream* st, const float* in, long frames)
+{
+    if (frames > st->frames - st->pos)
+        frames = st->frames - st->pos;
+
+    to_stereo(st->out + st->pos * 2, in, frames, st->channels);
+
+    st->pos += frames;
 }
 
 
-static float* read_audio(SNDFILE* sfp, SF_INFO* sfinfo)
+static int stream_write(sample_stream* st, const float* in, long frames,
+                                                            bool last)
 {
-    float* tmp;
+    SRC_DATA src;
 
-    if (sfinfo->frames >= MAX_SAMPLE_FRAMES)
+    if (!st->src)
     {
-        pf_error(PF_ERR_SAMPLE_MAX_FRAMES);
+        stream_store(st, in, frames);
         return 0;
     }
 
-    if (sfinfo->channels > 2)
-    {
-        pf_error(PF_ERR_SAMPLE_CHANNEL_COUNT);
-        sf_close (sfp);
-        return 0;
-    }
+    src.src_ratio = st->ratio;
+    src.data_in = in;
+    src.input_frames = frames;
+    src.end_of_input = last;
 
-    /* set aside space for samples */
-    if (!(tmp = malloc(sfinfo->frames * sfinfo->channels * sizeof(*tmp))))
+    do
     {
-        pf_error(PF_ERR_SAMPLE_ALLOC);
-        sf_close (sfp);
-        return 0;
-    }
+        src.data_out = st->buf;
+        src.output_frames = STREAM_CHUNK * 2 / st->channels;
 
-    /* load sample file into memory */
-    if (sf_readf_float(sfp, tmp, sfinfo->frames) != sfinfo->frames)
-    {
-        pf_error(PF_ERR_SAMPLE_SNDFILE_READ);
-        free(tmp);
-        return 0;
-    }
+        if (src_process(st->src, &src) != 0)
+        {
+            pf_error(PF_ERR_SAMPLE_SRC_SIMPLE);
+            return -1;
+        }
+
+        stream_store(st, st->buf, src.output_frames_gen);
+
+        src.data_in += src.input_frames_used * st->channels;
+        src.input_frames -= src.input_frames_used;
+
+    } while (src.input_frames > 0 || (last && src.output_frames_gen > 0));
+
+    return 0;
+}
 
-    debug("Read %d frames into memory.\n", (int) sfinfo->frames);
 
-    return tmp;
+/*  the converters don't all generate quite the same number of frames,
+    so pad with silence to keep to the length stream_init decided on */
+static void stream_finish(sample_stream* st)
+{
+    if (st->pos < st->frames)
+        memset(st->out + st->pos * 2, 0,
+                    sizeof(float) * (st->frames - st->pos) * 2);
+
+    st->pos = st->frames;
+
+    if (st->src)
+        st->src = src_delete(st->src);
+}
+
+
+static void stream_abort(sample_stream* st)
+{
+    if (st->src)
+        st->src = src_delete(st->src);
+
+    free(st->out);
+    st->out = 0;
 }
 
 
@@ -330,11 +421,17 @@ int sample_load_file(Sample* sample, const char* name,
                                         int raw_samplerate,
                                         int raw_channels,
                                         int sndfile_format,
-                                        int resample_sndfile)
+                                        int resample_sndfile,
+                                        SampleQuality quality)
 {
-    float* tmp;
+    float chunk[STREAM_CHUNK * 2];
+    float* source = 0;
     SF_INFO sfinfo;
     SNDFILE* sfp;
+    sample_stream* st;
+    sf_count_t done;
+    sf_count_t n;
+    bool resampled;
 
     if (!(sfp = open_sample(&sfinfo, name,  raw_samplerate,
                                             raw_channels,
@@ -343,10 +440,67 @@ int sample_load_file(Sample* sample, const char* name,
         return -1;
     }
 
-    if (!(tmp = read_audio(sfp, &sfinfo)))
+    if (sfinfo.frames >= MAX_SAMPLE_FRAMES)
+    {
+        pf_error(PF_ERR_SAMPLE_MAX_FRAMES);
+        sf_close(sfp);
         return -1;
+    }
+
+    if (sfinfo.channels > 2)
+    {
+        pf_error(PF_ERR_SAMPLE_CHANNEL_COUNT);
+        sf_close(sfp);
+        return -1;
+    }
+
+    /*  ignore resample if rate is invalid (ie rate == -1 when
+        JACK is not running, useful under debug conditions. */
+    resampled = (resample_sndfile && rate > 0 && sfinfo.samplerate != rate);
+
+    if (!(st = malloc(sizeof(*st))))
+    {
+        pf_error(PF_ERR_SAMPLE_ALLOC);
+        sf_close(sfp);
+        return -1;
+    }
+
+    if (stream_init(st, sfinfo.channels, sfinfo.samplerate,
+                        resampled ? rate : sfinfo.samplerate,
+                        sfinfo.frames, quality) < 0)
+    {
+        free(st);
+        sf_close(sfp);
+        return -1;
+    }
+
+    /* the source data is decoded straight into place if it's kept */
+    if (resampled && __atomic_load_n(&keep_source, __ATOMIC_RELAXED))
+        source = malloc(sizeof(float) * sfinfo.frames * sfinfo.channels);
+
+    for (done = 0; done < sfinfo.frames; done += n)
+    {
+        float* in = source ? source + done * sfinfo.channels : chunk;
+
+        n = sfinfo.frames - done;
+
+        if (n > STREAM_CHUNK)
+            n = STREAM_CHUNK;
+
+        if (sf_readf_float(sfp, in, n) != n)
+        {
+            pf_error(PF_ERR_SAMPLE_SNDFILE_READ);
+            goto fail;
+        }
+
+        if (stream_write(st, in, n, done + n == sfinfo.frames) < 0)
+            goto fail;
+    }
 
     sf_close(sfp);
+    stream_finish(st);
+
+    debug("Read %d frames into memory.\n", (int) sfinfo.frames);
 
     if (raw_samplerate || raw_channels || sndfile_format)
     {
@@ -361,49 +515,271 @@ int sample_load_file(Sample* sample, const char* name,
         sample->sndfile_format = 0;
     }
 
-    if (resample_sndfile)
-    {   /*  ignore resample if rate is invalid (ie rate == -1 when
-            JACK is not running, useful under debug conditions. */
-        if (rate > 0 && sfinfo.samplerate != rate)
-        {
-            float* tmp2 = resample(tmp, rate, &sfinfo);
+    free(sample->sp);
+    free(sample->filename);
+    free(sample->source);
+
+    sample->filename = strdup(name);
+
+    sample->sp = st->out;
+    sample->frames = st->frames;
+
+    sample->default_sample = false;
+    sample->quality = resampled ? quality : SAMPLE_QUALITY_BEST;
+
+    sample->samplerate = resampled ? rate : sfinfo.samplerate;
+    sample->source_samplerate = sfinfo.samplerate;
 
-            if (!tmp2)
-            {
-                free(tmp);
-                return -1;
-            }
+    sample->source = source;
+    sample->source_frames = source ? sfinfo.frames : 0;
+    sample->source_channels = source ? sfinfo.channels : 0;
 
-            free(tmp);
-            tmp = tmp2;
+    free(st);
+
+    return 0;
+
+fail:
+    sf_close(sfp);
+    stream_abort(st);
+    free(st);
+    free(source);
+    return -1;
+}
+
+
+int sample_resample(Sample* dest, Sample* src, int rate,
+                                            SampleQuality quality)
+{
+    sample_stream* st;
+    const float* in;
+    float* source = 0;
+    int frames;
+    int channels;
+    int in_rate = src->source_samplerate;
+    bool resampled;
+
+    if (src->source)
+    {
+        in = src->source;
+        frames = src->source_frames;
+        channels = src->source_channels;
+    }
+    else if (src->sp && src->samplerate == src->source_samplerate)
+    {
+        in = src->sp;
+        frames = src->frames;
+        channels = 2;
+    }
+    else
+        return -1;
+
+    debug("Resampling %s from memory\n", src->filename);
+
+    resampled = (rate > 0 && in_rate != rate);
+
+    if (!(st = malloc(sizeof(*st))))
+    {
+        pf_error(PF_ERR_SAMPLE_ALLOC);
+        return -1;
+    }
+
+    if (stream_init(st, channels, in_rate, resampled ? rate : in_rate,
+                                            frames, quality) < 0)
+    {
+        free(st);
+        return -1;
+    }
+
+    if (stream_write(st, in, frames, true) < 0)
+    {
+        stream_abort(st);
+        free(st);
+        return -1;
+    }
+
+    stream_finish(st);
+
+    if (resampled && __atomic_load_n(&keep_source, __ATOMIC_RELAXED))
+    {
+        if (src->source)
+        {   /* no need to copy what src won't be needing any more */
+            source = src->source;
+            src->source = 0;
         }
+        else if ((source = malloc(sizeof(float) * frames * 2)))
+            memcpy(source, src->sp, sizeof(float) * frames * 2);
     }
 
-    if (sfinfo.channels == 1)
+    sample_shallow_copy(dest, src);
+
+    dest->sp = st->out;
+    dest->frames = st->frames;
+    dest->quality = resampled ? quality : SAMPLE_QUALITY_BEST;
+    dest->samplerate = resampled ? rate : in_rate;
+
+    dest->source = source;
+    dest->source_frames = source ? frames : 0;
+    dest->source_channels = source ? channels : 0;
+
+    free(st);
+
+    return 0;
+}
+
+
+/*  SampleReader
+        reads a sample file a piece at a time, rather than into memory
+        all at once, for playing it while it is still being read.
+ */
+struct _SampleReader
+{
+    SNDFILE*    sfp;
+    int         channels;
+    SRC_STATE*  src;        /* null if not resampling */
+    double      ratio;
+
+    float       in[STREAM_CHUNK * 2];
+    const float* in_pos;    /* the frames of in not yet resampled */
+    long        in_frames;
+    bool        eof;
+
+    float       buf[STREAM_CHUNK * 2];  /* resampler output */
+};
+
+
+SampleReader* sample_reader_open(const char* name, int rate,
+                                        int raw_samplerate,
+                                        int raw_channels,
+                                        int sndfile_format,
+                                        int resample_sndfile,
+                                        SampleQuality quality)
+{
+    SampleReader* r;
+    SF_INFO sfinfo;
+    SNDFILE* sfp;
+    int err;
+
+    if (!(sfp = open_sample(&sfinfo, name,  raw_samplerate,
+                                            raw_channels,
+                                            sndfile_format)))
+    {
+        return 0;
+    }
+
+    if (sfinfo.channels > 2)
     {
-        float* tmp2 = mono_to_stereo(tmp, &sfinfo);
+        pf_error(PF_ERR_SAMPLE_CHANNEL_COUNT);
+        sf_close(sfp);
+        return 0;
+    }
 
-        if (!tmp2)
+    if (!(r = malloc(sizeof(*r))))
+    {
+        pf_error(PF_ERR_SAMPLE_ALLOC);
+        sf_close(sfp);
+        return 0;
+    }
+
+    r->sfp = sfp;
+    r->channels = sfinfo.channels;
+    r->src = 0;
+    r->ratio = 1.0;
+    r->in_pos = r->in;
+    r->in_frames = 0;
+    r->eof = false;
+
+    if (resample_sndfile && rate > 0 && sfinfo.samplerate != rate)
+    {
+        r->ratio = rate / (sfinfo.samplerate * 1.0);
+        r->src = src_new((quality == SAMPLE_QUALITY_BEST)
+                                ? SRC_SINC_BEST_QUALITY
+                                : SRC_SINC_FASTEST,
+                                r->channels, &err);
+        if (!r->src)
         {
-            free(tmp);
+            pf_error(PF_ERR_SAMPLE_SRC_SIMPLE);
+            sf_close(sfp);
+            free(r);
+            return 0;
+        }
+    }
+
+    return r;
+}
+
+
+long sample_reader_read(SampleReader* r, float* out, long frames)
+{
+    SRC_DATA src;
+    long done = 0;
+    long n;
+
+    while (done < frames)
+    {
+        if (!r->in_frames && !r->eof)
+        {
+            n = (r->src) ? STREAM_CHUNK : frames - done;
+
+            if (n > STREAM_CHUNK)
+                n = STREAM_CHUNK;
+
+            if ((r->in_frames = sf_readf_float(r->sfp, r->in, n)) < n)
+                r->eof = true;
+
+            r->in_pos = r->in;
+        }
+
+        if (!r->src)
+        {
+            if (!r->in_frames)
+                break;
+
+            to_stereo(out + done * 2, r->in_pos, r->in_frames, r->channels);
+            done += r->in_frames;
+            r->in_frames = 0;
+            continue;
+        }
+
+        n = STREAM_CHUNK * 2 / r->channels;
+
+        src.src_ratio = r->ratio;
+        src.data_in = r->in_pos;
+        src.input_frames = r->in_frames;
+        src.data_out = r->buf;
+        src.output_frames = (frames - done < n) ? frames - done : n;
+        src.end_of_input = r->eof;
+
+        if (src_process(r->src, &src) != 0)
+        {
+            pf_error(PF_ERR_SAMPLE_SRC_SIMPLE);
             return -1;
         }
 
-        free(tmp);
-        tmp = tmp2;
+        r->in_pos += src.input_frames_used * r->channels;
+        r->in_frames -= src.input_frames_used;
+
+        to_stereo(out + done * 2, r->buf, src.output_frames_gen,
+                                                        r->channels);
+        done += src.output_frames_gen;
+
+        if (r->eof && !r->in_frames && !src.output_frames_gen)
+            break;
     }
 
-    free(sample->sp);
-    free(sample->filename);
+    return done;
+}
 
-    sample->filename = strdup(name);
 
-    sample->sp = tmp;
-    sample->frames = sfinfo.frames;
+void sample_reader_close(SampleReader* r)
+{
+    if (!r)
+        return;
 
-    sample->default_sample = false;
+    if (r->src)
+        src_delete(r->src);
 
-    return 0;
+    sf_close(r->sfp);
+    free(r);
 }
 
 
@@ -423,6 +799,10 @@ int sample_deep_copy(Sample* dest, const Sample* src)
 
     sample_shallow_copy(dest, src);
 
+    /* nothing to copy (ie the data was evicted) */
+    if (!src->sp)
+        return 0;
+
     dest->sp = malloc(bytes);
 
     if (!dest->sp)
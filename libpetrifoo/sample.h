@@ -41,6 +41,18 @@ typedef struct _RAW_FORMAT
 } raw_format;
 
 
+/*  quality of the converter used when a sample is resampled on load.
+    both produce exactly the same number of frames so that one may be
+    swapped for the other without disturbing play or loop points.
+ */
+typedef enum
+{
+    SAMPLE_QUALITY_FAST,    /* SRC_SINC_FASTEST */
+    SAMPLE_QUALITY_BEST     /* SRC_SINC_BEST_QUALITY */
+
+} SampleQuality;
+
+
 typedef struct _Sample Sample;
 
 
@@ -58,6 +70,21 @@ struct _Sample
     char*   filename;
 
     bool    default_sample;
+
+    /* SAMPLE_QUALITY_BEST unless resampled with a lesser converter */
+    SampleQuality   quality;
+
+    int     samplerate;         /* rate of the data in sp */
+    int     source_samplerate;  /* rate of the sample file */
+
+    /*  when sp holds resampled data, and keeping source data is
+        enabled, the data as it was read from the file (ie at the
+        source_samplerate, not converted to stereo) is kept here so
+        that a change of rate need not go back to the file.
+     */
+    float*  source;
+    int     source_frames;
+    int     source_channels;
 };
 
 
@@ -81,7 +108,41 @@ int         sample_load_file(Sample*, const char* name, int rate,
     /* zero for non-raw data */         int raw_samplerate,
     /* zero for non-raw data */         int raw_channels,
     /* zero for non-raw data */         int sndfile_format,
-                                        int resample_sndfile);
+                                        int resample_sndfile,
+                                        SampleQuality);
+
+
+/*  sample_resample gives dest (a new Sample) the data of src resampled
+    to rate. the data is resampled from the source data kept by src,
+    or from src's own data if it has never been resampled. src's
+    source data, if any, is moved to dest. returns -1 if src has
+    nothing suitable to resample from.
+ */
+int         sample_resample (Sample* dest, Sample* src, int rate,
+                                                SampleQuality);
+
+/*  whether loading keeps the source data of resampled samples, off
+    by default as it takes as much memory again as the samples */
+void        sample_set_keep_source(bool);
+
+
+/*  SampleReader
+        for playing a sample file as it is read. sample_reader_read
+        reads up to frames (stereo, at the rate given to
+        sample_reader_open) into out and returns how many it read,
+        which is only less than frames at the end of the file, or -1
+        on error.
+ */
+typedef struct _SampleReader SampleReader;
+
+SampleReader* sample_reader_open(const char* name, int rate,
+    /* zero for non-raw data */         int raw_samplerate,
+    /* zero for non-raw data */         int raw_channels,
+    /* zero for non-raw data */         int sndfile_format,
+                                        int resample_sndfile,
+                                        SampleQuality);
+long        sample_reader_read(SampleReader*, float* out, long frames);
+void        sample_reader_close(SampleReader*);
 
 
 void        sample_free_data(Sample*); /* free's samples and filename */
@@ -0,0 +1,273 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "telemetry.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine_private.h"
+
+
+/*  one for each engine (see engine_private.h). tm is written only by
+    the engine's audio thread (bar the xrun counts), one field at a
+    time, so a reader may see the fields of different periods */
+struct _TelemetryState
+{
+    Telemetry       tm;
+
+    /* the audio thread's own, for the period being rendered */
+    unsigned long   period_start;
+    unsigned long   patch_ns[PATCH_COUNT];
+    int             patch_voices[PATCH_COUNT];
+    bool            period_late;
+
+    bool            reset_pending;
+};
+
+
+TelemetryState  telemetry_state_default;
+
+
+#define TM_LOAD(ts, field) \
+    __atomic_load_n(&(ts)->tm.field, __ATOMIC_RELAXED)
+
+#define TM_STORE(ts, field, val) \
+    __atomic_store_n(&(ts)->tm.field, (val), __ATOMIC_RELAXED)
+
+/* floats need the generic builtins */
+#define TM_LOADF(ts, dest, field) \
+    __atomic_load(&(ts)->tm.field, &(dest), __ATOMIC_RELAXED)
+
+#define TM_STOREF(ts, field, val)                               \
+{                                                               \
+    float tmp_ = (val);                                         \
+    __atomic_store(&(ts)->tm.field, &tmp_, __ATOMIC_RELAXED);   \
+}
+
+
+TelemetryState* telemetry_state_new(void)
+{
+    TelemetryState* ts = malloc(sizeof(*ts));
+
+    if (ts)
+        memset(ts, 0, sizeof(*ts));
+
+    return ts;
+}
+
+
+void telemetry_state_free(TelemetryState* ts)
+{
+    free(ts);
+}
+
+
+unsigned long telemetry_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+
+void telemetry_get(Engine* e, Telemetry* t)
+{
+    TelemetryState* ts = e->telemetry;
+    Engine* prev = current_engine;
+    int i;
+
+    t->periods =        TM_LOAD(ts, periods);
+    t->late =           TM_LOAD(ts, late);
+    TM_LOADF(ts, t->load,       load);
+    TM_LOADF(ts, t->load_peak,  load_peak);
+    t->render_ns =      TM_LOAD(ts, render_ns);
+    t->render_ns_peak = TM_LOAD(ts, render_ns_peak);
+    t->voices =         TM_LOAD(ts, voices);
+    t->voices_peak =    TM_LOAD(ts, voices_peak);
+    t->voices_stolen =  TM_LOAD(ts, voices_stolen);
+    t->xruns =          TM_LOAD(ts, xruns);
+    t->xruns_late =     TM_LOAD(ts, xruns_late);
+    TM_LOADF(ts, t->xrun_load,  xrun_load);
+    t->sample_bytes =   TM_LOAD(ts, sample_bytes);
+    t->sample_budget =  TM_LOAD(ts, sample_budget);
+    t->samples_evicted = TM_LOAD(ts, samples_evicted);
+    t->samples_reloaded = TM_LOAD(ts, samples_reloaded);
+
+    for (i = 0; i < PATCH_COUNT; ++i)
+    {
+        t->patch[i].render_ns =     TM_LOAD(ts, patch[i].render_ns);
+        t->patch[i].render_ns_peak = TM_LOAD(ts, patch[i].render_ns_peak);
+        t->patch[i].voices =        TM_LOAD(ts, patch[i].voices);
+    }
+
+    /* the event queue is the engine's mixer's */
+    current_engine = e;
+    mixer_get_event_stats(&t->events);
+    current_engine = prev;
+}
+
+
+void telemetry_reset_peaks(Engine* e)
+{
+    __atomic_store_n(&e->telemetry->reset_pending, true, __ATOMIC_RELEASE);
+}
+
+
+int telemetry_format(char* buf, size_t len, const Telemetry* t)
+{
+    int busiest = -1;
+    int i;
+
+    for (i = 0; i < PATCH_COUNT; ++i)
+        if (t->patch[i].render_ns
+         && (busiest < 0 || t->patch[i].render_ns
+                                    > t->patch[busiest].render_ns))
+            busiest = i;
+
+    return snprintf(buf, len,
+            "load %.1f%% (peak %.1f%%) late %lu | "
+            "voices %d (peak %d) stolen %lu | "
+            "events waiting %d (peak %d) dropped %lu | "
+            "xruns %lu (%lu late) | busiest patch %d %luus | "
+            "samples %luMB (budget %luMB) evicted %lu reloaded %lu",
+            t->load * 100.0, t->load_peak * 100.0, t->late,
+            t->voices, t->voices_peak, t->voices_stolen,
+            t->events.depth, t->events.high_water, t->events.dropped,
+            t->xruns, t->xruns_late,
+            busiest, busiest < 0 ? 0 : t->patch[busiest].render_ns / 1000,
+            t->sample_bytes >> 20, t->sample_budget >> 20,
+            t->samples_evicted, t->samples_reloaded);
+}
+
+
+void telemetry_period_begin(void)
+{
+    TelemetryState* ts = current_engine->telemetry;
+
+    memset(ts->patch_ns, 0, sizeof(ts->patch_ns));
+    memset(ts->patch_voices, 0, sizeof(ts->patch_voices));
+    ts->period_start = telemetry_now_ns();
+}
+
+
+void telemetry_period_end(int frames, int rate)
+{
+    TelemetryState* ts = current_engine->telemetry;
+    unsigned long ns = telemetry_now_ns() - ts->period_start;
+    float load = (rate > 0) ? ns * (rate / 1e9f) / frames : 0;
+    bool reset;
+    int voices = 0;
+    float peak;
+    int i;
+
+    reset = __atomic_exchange_n(&ts->reset_pending, false,
+                                                    __ATOMIC_ACQUIRE);
+
+    for (i = 0; i < PATCH_COUNT; ++i)
+    {
+        voices += ts->patch_voices[i];
+
+        TM_STORE(ts, patch[i].render_ns, ts->patch_ns[i]);
+        TM_STORE(ts, patch[i].voices, ts->patch_voices[i]);
+
+        if (reset || ts->patch_ns[i] > ts->tm.patch[i].render_ns_peak)
+            TM_STORE(ts, patch[i].render_ns_peak, ts->patch_ns[i]);
+    }
+
+    TM_STORE(ts, periods, ts->tm.periods + 1);
+
+    if (load > 1.0f)
+        TM_STORE(ts, late, ts->tm.late + 1);
+
+    __atomic_store_n(&ts->period_late, load > 1.0f, __ATOMIC_RELAXED);
+
+    TM_STOREF(ts, load, load);
+    TM_STORE(ts, render_ns, ns);
+    TM_STORE(ts, voices, voices);
+
+    TM_LOADF(ts, peak, load_peak);
+
+    if (reset || load > peak)
+        TM_STOREF(ts, load_peak, load);
+
+    if (reset || ns > ts->tm.render_ns_peak)
+        TM_STORE(ts, render_ns_peak, ns);
+
+    if (reset || voices > ts->tm.voices_peak)
+        TM_STORE(ts, voices_peak, voices);
+}
+
+
+void telemetry_patch_rendered(int id, unsigned long ns, int voices)
+{
+    TelemetryState* ts = current_engine->telemetry;
+
+    /* patches may be rendered more than once a period, between events */
+    ts->patch_ns[id] += ns;
+    ts->patch_voices[id] = voices;
+}
+
+
+void telemetry_voice_stolen(void)
+{
+    TelemetryState* ts = current_engine->telemetry;
+
+    TM_STORE(ts, voices_stolen, ts->tm.voices_stolen + 1);
+}
+
+
+void telemetry_xrun(Engine* e)
+{
+    TelemetryState* ts = e->telemetry;
+    float load;
+
+    __atomic_add_fetch(&ts->tm.xruns, 1, __ATOMIC_RELAXED);
+
+    if (__atomic_load_n(&ts->period_late, __ATOMIC_RELAXED))
+        __atomic_add_fetch(&ts->tm.xruns_late, 1, __ATOMIC_RELAXED);
+
+    TM_LOADF(ts, load, load);
+    TM_STOREF(ts, xrun_load, load);
+}
+
+
+void telemetry_samples(unsigned long bytes, unsigned long budget)
+{
+    TelemetryState* ts = current_engine->telemetry;
+
+    TM_STORE(ts, sample_bytes, bytes);
+    TM_STORE(ts, sample_budget, budget);
+}
+
+
+void telemetry_sample_evicted(void)
+{
+    __atomic_add_fetch(&current_engine->telemetry->tm.samples_evicted, 1,
+                                                    __ATOMIC_RELAXED);
+}
+
+
+void telemetry_sample_reloaded(void)
+{
+    __atomic_add_fetch(&current_engine->telemetry->tm.samples_reloaded, 1,
+                                                    __ATOMIC_RELAXED);
+}
@@ -0,0 +1,110 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+
+#include <stddef.h>
+
+#include "engine.h"
+#include "mixer.h"
+#include "patch.h"
+
+
+/*  telemetry
+        counters kept by each engine's audio thread, without locking,
+        on how the engine copes: how long periods take to render against how long
+        they last, where the time goes, and what gets lost. any thread
+        may read them.
+
+        the peaks are held until telemetry_reset_peaks, which takes
+        effect at the end of the engine's next period.
+ */
+
+
+typedef struct _TelemetryPatch
+{
+    unsigned long   render_ns;      /* last period */
+    unsigned long   render_ns_peak;
+    int             voices;         /* last period */
+
+} TelemetryPatch;
+
+
+typedef struct _Telemetry
+{
+    unsigned long   periods;
+    unsigned long   late;           /* periods longer to render than
+                                       to play */
+    float           load;           /* last period: render time over
+                                       the period's length */
+    float           load_peak;
+    unsigned long   render_ns;      /* last period */
+    unsigned long   render_ns_peak;
+
+    int             voices;         /* last period */
+    int             voices_peak;
+    unsigned long   voices_stolen;  /* sounding voices taken for new
+                                       notes */
+
+    MixerEventStats events;
+
+    unsigned long   xruns;          /* reported by the driver */
+    unsigned long   xruns_late;     /* of them, right after a late
+                                       period (ie our fault) */
+    float           xrun_load;      /* load of the period before the
+                                       last xrun */
+
+    /* see patch_set_sample_budget */
+    unsigned long   sample_bytes;   /* in memory, at the last poll */
+    unsigned long   sample_budget;  /* 0 for none */
+    unsigned long   samples_evicted;
+    unsigned long   samples_reloaded;
+
+    TelemetryPatch  patch[PATCH_COUNT];
+
+} Telemetry;
+
+
+void    telemetry_get(Engine* e, Telemetry*);
+void    telemetry_reset_peaks(Engine* e);
+
+/*  writes a one line summary of t into buf, with the busiest patch,
+    returns what snprintf does */
+int     telemetry_format(char* buf, size_t len, const Telemetry* t);
+
+
+/* RT thread only, for the engine being rendered */
+void    telemetry_period_begin(void);
+void    telemetry_period_end(int frames, int rate);
+void    telemetry_patch_rendered(int id, unsigned long ns, int voices);
+void    telemetry_voice_stolen(void);
+unsigned long telemetry_now_ns(void);
+
+/* any thread: the driver's xrun notification for e */
+void    telemetry_xrun(Engine* e);
+
+/*  not for usage by RT thread: the sample budget's doings, for the
+    selected engine */
+void    telemetry_samples(unsigned long bytes, unsigned long budget);
+void    telemetry_sample_evicted(void);
+void    telemetry_sample_reloaded(void);
+
+
+#endif /* __TELEMETRY_H__ */
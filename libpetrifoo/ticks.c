@@ -25,19 +25,17 @@
 #include <sys/time.h>
 #include "petri-foo.h"
 #include "driver.h"
+#include "engine_private.h"
 #include "ticks.h"
 
 
-static int samplerate = -1;
-
-
 Tick ticks_secs_to_ticks (float secs)
 {
-     return samplerate * secs;
+     return current_engine->samplerate * secs;
 }
 
 
 void ticks_set_samplerate (int rate)
 {
-     samplerate = rate;
+     current_engine->samplerate = rate;
 }
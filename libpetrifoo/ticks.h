@@ -26,10 +26,11 @@
 #define __TICKS_H__
 
 
-#include <jack/jack.h>
+#include <stdint.h>
 
 
-typedef jack_nframes_t Tick;
+/* frames, as JACK counts them (jack_nframes_t) */
+typedef uint32_t Tick;
 
 
 void    ticks_set_samplerate(int rate);
@@ -0,0 +1,343 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "petri-foo.h"
+#include "telemetry.h"
+
+
+/* magic numbers */
+enum
+{
+    TRACE_RINGS =       8,
+    TRACE_RING_SIZE =   1 << 15,    /* events, must be a power of two */
+    TRACE_FLUSH_MS =    100,
+};
+
+
+typedef struct _TraceEvent
+{
+    unsigned long   ns;
+    const char*     name;
+    int             arg;
+    char            phase;          /* 'B'egin, 'E'nd or 'i'nstant */
+
+} TraceEvent;
+
+
+typedef struct _TraceRing
+{
+    TraceEvent*     events;
+    unsigned long   head;           /* the recording thread's */
+    unsigned long   tail;           /* the flush thread's */
+    const char*     name;
+    bool            busy;           /* recording thread is writing */
+
+} TraceRing;
+
+
+static TraceRing        rings[TRACE_RINGS];
+static int              rings_claimed = 0;
+static unsigned int     generation = 0;     /* one per trace_start */
+static bool             recording = false;
+static unsigned long    dropped = 0;
+
+/* the flush thread's */
+static FILE*            file = 0;
+static unsigned long    start_ns = 0;
+static bool             first_event = true;
+static pthread_t        thread;
+static bool             quit = false;
+
+/* which ring the calling thread records to, in trace generation */
+static __thread TraceRing*      my_ring = 0;
+static __thread unsigned int    my_gen = 0;
+static __thread const char*     my_name = 0;
+
+
+/* the calling thread's ring, claimed the first time it records */
+inline static TraceRing* thread_ring(void)
+{
+    unsigned int gen = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+    int ix;
+
+    if (my_gen == gen)
+        return my_ring;
+
+    ix = __atomic_fetch_add(&rings_claimed, 1, __ATOMIC_RELAXED);
+
+    my_gen = gen;
+    my_ring = (ix < TRACE_RINGS) ? &rings[ix] : 0;
+
+    if (my_ring)
+        __atomic_store_n(&my_ring->name, my_name, __ATOMIC_RELAXED);
+
+    return my_ring;
+}
+
+
+inline static void record(char phase, const char* name, int arg)
+{
+    TraceRing* r;
+    TraceEvent* ev;
+    unsigned long head;
+
+    if (!__atomic_load_n(&recording, __ATOMIC_RELAXED))
+        return;
+
+    if (!(r = thread_ring()))
+    {
+        __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    /*  trace_stop waits for busy to clear before freeing the events,
+        having cleared recording first, so one or the other of us is
+        bound to see the other's change */
+    __atomic_store_n(&r->busy, true, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&recording, __ATOMIC_SEQ_CST))
+    {
+        head = r->head;
+
+        if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)
+                                                    < TRACE_RING_SIZE)
+        {
+            ev = &r->events[head & (TRACE_RING_SIZE - 1)];
+            ev->ns = telemetry_now_ns();
+            ev->name = name;
+            ev->arg = arg;
+            ev->phase = phase;
+            __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+        }
+        else
+            __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&r->busy, false, __ATOMIC_RELEASE);
+}
+
+
+void trace_begin(const char* name, int arg)
+{
+    record('B', name, arg);
+}
+
+
+void trace_end(const char* name)
+{
+    record('E', name, -1);
+}
+
+
+void trace_instant(const char* name, int arg)
+{
+    record('i', name, arg);
+}
+
+
+void trace_thread_name(const char* name)
+{
+    my_name = name;
+
+    if (my_ring
+     && my_gen == __atomic_load_n(&generation, __ATOMIC_ACQUIRE))
+        __atomic_store_n(&my_ring->name, name, __ATOMIC_RELAXED);
+}
+
+
+unsigned long trace_dropped(void)
+{
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+
+static void write_event(int tid, const TraceEvent* ev)
+{
+    fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+                  "\"pid\":1,\"tid\":%d",
+                    first_event ? "" : ",", ev->name, ev->phase,
+                    (ev->ns - start_ns) / 1000.0, tid);
+
+    if (ev->phase == 'i')
+        fputs(",\"s\":\"t\"", file);
+
+    if (ev->arg >= 0)
+        fprintf(file, ",\"args\":{\"arg\":%d}", ev->arg);
+
+    fputc('}', file);
+    first_event = false;
+}
+
+
+/* writes out everything recorded so far */
+static void flush(void)
+{
+    int count = __atomic_load_n(&rings_claimed, __ATOMIC_RELAXED);
+    unsigned long head;
+    unsigned long tail;
+    int i;
+
+    if (count > TRACE_RINGS)
+        count = TRACE_RINGS;
+
+    for (i = 0; i < count; ++i)
+    {
+        TraceRing* r = &rings[i];
+
+        head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+        for (tail = r->tail; tail != head; ++tail)
+            write_event(i, &r->events[tail & (TRACE_RING_SIZE - 1)]);
+
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+
+static void* flush_thread(void* arg)
+{
+    (void)arg;
+
+    while (!__atomic_load_n(&quit, __ATOMIC_ACQUIRE))
+    {
+        usleep(TRACE_FLUSH_MS * 1000);
+        flush();
+    }
+
+    return 0;
+}
+
+
+int trace_start(const char* path)
+{
+    int i;
+
+    if (file)
+        trace_stop();
+
+    if (!(file = fopen(path, "w")))
+    {
+        debug("failed to open trace file %s\n", path);
+        return -1;
+    }
+
+    /*  touch every page now, rather than have the recording threads
+        fault them in */
+    for (i = 0; i < TRACE_RINGS; ++i)
+    {
+        if (!(rings[i].events = malloc(sizeof(TraceEvent)
+                                                * TRACE_RING_SIZE)))
+            goto fail;
+
+        memset(rings[i].events, 0, sizeof(TraceEvent) * TRACE_RING_SIZE);
+        rings[i].head = rings[i].tail = 0;
+        rings[i].name = 0;
+    }
+
+    fputs("{\"traceEvents\":[", file);
+    first_event = true;
+    start_ns = telemetry_now_ns();
+    dropped = 0;
+    quit = false;
+
+    if (pthread_create(&thread, NULL, flush_thread, NULL) != 0)
+        goto fail;
+
+    debug("recording trace to %s\n", path);
+
+    __atomic_store_n(&rings_claimed, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&recording, true, __ATOMIC_SEQ_CST);
+
+    return 0;
+
+fail:
+    debug("failed to start trace\n");
+
+    for (i = 0; i < TRACE_RINGS; ++i)
+    {
+        free(rings[i].events);
+        rings[i].events = 0;
+    }
+
+    fclose(file);
+    file = 0;
+
+    return -1;
+}
+
+
+void trace_stop(void)
+{
+    int count;
+    int i;
+
+    if (!file)
+        return;
+
+    __atomic_store_n(&recording, false, __ATOMIC_SEQ_CST);
+
+    for (i = 0; i < TRACE_RINGS; ++i)
+        while (__atomic_load_n(&rings[i].busy, __ATOMIC_SEQ_CST))
+            usleep(1000);
+
+    __atomic_store_n(&quit, true, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+
+    flush();
+
+    count = __atomic_load_n(&rings_claimed, __ATOMIC_RELAXED);
+
+    if (count > TRACE_RINGS)
+        count = TRACE_RINGS;
+
+    for (i = 0; i < count; ++i)
+    {
+        fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                      "\"pid\":1,\"tid\":%d,"
+                      "\"args\":{\"name\":\"",
+                        first_event ? "" : ",", i);
+
+        if (rings[i].name)
+            fprintf(file, "%s\"}}", rings[i].name);
+        else
+            fprintf(file, "thread %d\"}}", i);
+
+        first_event = false;
+    }
+
+    fputs("\n]}\n", file);
+    fclose(file);
+    file = 0;
+
+    debug("trace stopped, %lu events dropped\n", trace_dropped());
+
+    for (i = 0; i < TRACE_RINGS; ++i)
+    {
+        free(rings[i].events);
+        rings[i].events = 0;
+    }
+}
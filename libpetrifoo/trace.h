@@ -0,0 +1,63 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+
+#include <stdbool.h>
+
+
+/*  trace
+        an optional recorder of what the engine does and when, for
+        finding out what was behind an xrun. spans and instants are
+        timestamped into a ring per thread, allocated by trace_start,
+        so recording never locks or allocates. a flush thread empties
+        the rings into a Chrome trace event file, which chrome://tracing
+        and the Perfetto UI both open.
+
+        names are kept by pointer, so must be string literals. arg is
+        shown alongside (patch id, note, frames...), -1 for none.
+
+        while no trace is being recorded, each call is one relaxed
+        load and a branch.
+ */
+
+
+/*  *** NOT for usage by RT thread ***
+    trace_start returns -1 if the file could not be opened, trace_stop
+    writes out whatever is left and closes it. */
+int     trace_start(const char* path);
+void    trace_stop(void);
+
+
+/*  names the calling thread in the trace, threads which don't show
+    up as "thread N". name must be a string literal, as above. */
+void    trace_thread_name(const char* name);
+
+
+/* any thread */
+void    trace_begin(const char* name, int arg);
+void    trace_end(const char* name);
+void    trace_instant(const char* name, int arg);
+
+/* events lost to full rings, or threads beyond the rings there are */
+unsigned long trace_dropped(void);
+
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,316 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "worker.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "engine_private.h"
+#include "petri-foo.h"
+#include "trace.h"
+
+
+typedef struct _WorkerBatch
+{
+    WorkerFunc  func;
+    Engine*     engine;     /* the caller's */
+    char*       data;
+    size_t      elem_size;
+    int         count;
+    int         next;       /* index of next element to hand out */
+    int         done;       /* number of elements completed */
+
+} WorkerBatch;
+
+
+typedef struct _WorkerJob WorkerJob;
+
+struct _WorkerJob
+{
+    WorkerFunc  func;
+    Engine*     engine;     /* the submitter's, held until done */
+    void*       data;
+    WorkerJob*  next;
+};
+
+
+static pthread_t*       threads = 0;
+static int              nthreads = 0;
+static bool             quit = false;
+static bool             urgent = false;
+static WorkerBatch*     batch = 0;
+static WorkerJob*       jobs_head = 0;
+static WorkerJob*       jobs_tail = 0;
+
+/* protects everything above, and the contents of batch */
+static pthread_mutex_t  mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   done_cond = PTHREAD_COND_INITIALIZER;
+
+/* only one batch is handed out at a time */
+static pthread_mutex_t  batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*  takes the next element of the current batch and runs it. must be
+    called with mutex held, returns with mutex held. returns false if
+    there was nothing to do.
+ */
+static bool run_next(void)
+{
+    WorkerBatch* b = batch;
+    int i;
+
+    if (!b || b->next >= b->count)
+        return false;
+
+    i = b->next++;
+
+    pthread_mutex_unlock(&mutex);
+    engine_select(b->engine);
+    b->func(b->data + i * b->elem_size);
+    pthread_mutex_lock(&mutex);
+
+    if (++b->done == b->count)
+        pthread_cond_broadcast(&done_cond);
+
+    return true;
+}
+
+
+/*  takes the oldest background job off the queue and runs it. must be
+    called with mutex held, returns with mutex held. returns false if
+    there was nothing to do.
+ */
+static bool run_job(void)
+{
+    WorkerJob* job = jobs_head;
+
+    if (!job)
+        return false;
+
+    if (!(jobs_head = job->next))
+        jobs_tail = 0;
+
+    pthread_mutex_unlock(&mutex);
+    engine_select(job->engine);
+    job->func(job->data);
+    engine_release(job->engine);
+    free(job);
+    pthread_mutex_lock(&mutex);
+
+    return true;
+}
+
+
+static void* worker_thread(void* arg)
+{
+    (void)arg;
+
+    trace_thread_name("worker");
+
+    pthread_mutex_lock(&mutex);
+
+    while (!quit)
+    {
+        /* batches come before background jobs, unless they're urgent */
+        if (__atomic_load_n(&urgent, __ATOMIC_RELAXED))
+        {
+            if (!run_job() && !run_next())
+                pthread_cond_wait(&work_cond, &mutex);
+        }
+        else if (!run_next() && !run_job())
+            pthread_cond_wait(&work_cond, &mutex);
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return 0;
+}
+
+
+int worker_init(int count)
+{
+    int i;
+
+    if (threads)
+        return 0;
+
+    if (count <= 0)
+    {   /* the thread calling worker_run_batch also does its share,
+           so leave a core for it */
+        count = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+
+        if (count < 1)
+            count = 1;
+    }
+
+    debug("starting %d worker threads\n", count);
+
+    if (!(threads = malloc(sizeof(*threads) * count)))
+        return -1;
+
+    quit = false;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (pthread_create(&threads[i], NULL, worker_thread, NULL) != 0)
+            break;
+    }
+
+    if ((nthreads = i) == 0)
+    {
+        free(threads);
+        threads = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void worker_shutdown(void)
+{
+    int i;
+
+    if (!threads)
+        return;
+
+    debug("stopping worker threads...\n");
+
+    pthread_mutex_lock(&mutex);
+    __atomic_store_n(&quit, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&mutex);
+
+    for (i = 0; i < nthreads; ++i)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    threads = 0;
+    nthreads = 0;
+
+    /* jobs still queued get to clean up after themselves */
+    pthread_mutex_lock(&mutex);
+
+    while (run_job())
+        ;
+
+    pthread_mutex_unlock(&mutex);
+
+    __atomic_store_n(&quit, false, __ATOMIC_RELEASE);
+
+    debug("done\n");
+}
+
+
+int worker_get_thread_count(void)
+{
+    return nthreads;
+}
+
+
+bool worker_quitting(void)
+{
+    return __atomic_load_n(&quit, __ATOMIC_ACQUIRE);
+}
+
+
+void worker_set_urgent(bool set)
+{
+    __atomic_store_n(&urgent, set, __ATOMIC_RELAXED);
+}
+
+
+int worker_submit(WorkerFunc func, void* data)
+{
+    WorkerJob* job;
+
+    if (!threads)
+        return -1;
+
+    if (!(job = malloc(sizeof(*job))))
+        return -1;
+
+    job->func = func;
+    job->engine = current_engine;
+    job->data = data;
+    job->next = 0;
+
+    engine_hold(job->engine);
+
+    pthread_mutex_lock(&mutex);
+
+    if (jobs_tail)
+        jobs_tail->next = job;
+    else
+        jobs_head = job;
+
+    jobs_tail = job;
+
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&mutex);
+
+    return 0;
+}
+
+
+void worker_run_batch(WorkerFunc func, void* data, int count,
+                                                  size_t elem_size)
+{
+    WorkerBatch b;
+    int i;
+
+    if (count <= 0)
+        return;
+
+    if (!threads || count == 1)
+    {
+        for (i = 0; i < count; ++i)
+            func((char*)data + i * elem_size);
+
+        return;
+    }
+
+    b.func = func;
+    b.engine = current_engine;
+    b.data = data;
+    b.elem_size = elem_size;
+    b.count = count;
+    b.next = 0;
+    b.done = 0;
+
+    pthread_mutex_lock(&batch_mutex);
+    pthread_mutex_lock(&mutex);
+
+    batch = &b;
+    pthread_cond_broadcast(&work_cond);
+
+    while (run_next())
+        ;
+
+    while (b.done < b.count)
+        pthread_cond_wait(&done_cond, &mutex);
+
+    batch = 0;
+
+    pthread_mutex_unlock(&mutex);
+    pthread_mutex_unlock(&batch_mutex);
+}
@@ -0,0 +1,82 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __WORKER_H__
+#define __WORKER_H__
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/*  worker
+        a pool of threads for doing the slow non-realtime jobs (ie
+        decoding and resampling sample files) on every core rather
+        than on the calling thread. the work is done with the
+        caller's engine selected (see engine.h).
+
+    *** NOT for usage by RT thread ***
+ */
+
+
+typedef void (*WorkerFunc)(void* data);
+
+
+/*  threads <= 0 creates one worker thread per online processor,
+    less one for the thread calling worker_run_batch */
+int     worker_init(int threads);
+void    worker_shutdown(void);
+
+int     worker_get_thread_count(void);
+
+
+/*  worker_run_batch calls func once for each of the count elements
+    (each elem_size bytes) of the array data, spreading the calls
+    among the worker threads and the calling thread. returns once
+    every call has completed.
+
+    if the pool has not been initialized the calls are simply made
+    one after another by the calling thread.
+ */
+void    worker_run_batch(WorkerFunc func, void* data, int count,
+                                                  size_t elem_size);
+
+
+/*  worker_submit queues func(data) as a low priority background job,
+    which is only picked up by a worker thread when there is no batch
+    work to do. returns -1 (and does not queue the job) if the pool is
+    not running.
+
+    jobs which have not started by the time worker_shutdown is called
+    are still called, but with worker_quitting returning true, so
+    that they may free their data rather than do the work.
+ */
+int     worker_submit(WorkerFunc func, void* data);
+bool    worker_quitting(void);
+
+
+/*  while set the background jobs are picked up ahead of any batch
+    work, for when there is nobody waiting on the batches so much as
+    on what the jobs leave behind (ie a bounce, which wants the best
+    quality samples the jobs load). may be called from any thread,
+    the RT thread included.
+ */
+void    worker_set_urgent(bool);
+
+
+#endif /* __WORKER_H__ */
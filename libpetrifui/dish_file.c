@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <locale.h>
+#include <pthread.h>
 
 #include "config.h"
 #include "file_ops.h"
@@ -41,6 +42,7 @@
 #include "petri-foo.h"
 #include "pf_error.h"
 #include "sample.h"
+#include "worker.h"
 
 
 typedef struct _dish_file_data
@@ -56,6 +58,70 @@ typedef struct _dish_file_data
 dish_file_data* dish_data = 0;
 
 
+/*  samples are not loaded while the dish file is read, instead a job
+    is recorded for each patch and once all the XML has been read the
+    samples are loaded in parallel by the worker pool.
+ */
+typedef struct _sample_job
+{
+    int     patch_id;
+    char*   filename;
+    int     raw_samplerate;
+    int     raw_channels;
+    int     sndfile_format;
+
+    int     play_start;
+    int     play_stop;
+    int     loop_start;
+    int     loop_stop;
+    int     fade_samples;
+    int     xfade_samples;
+    int     points_rate;    /* rate of the frames the points count */
+
+    /* filled in by the worker */
+    Sample* sample;
+    int     result;
+    int     error;
+} sample_job;
+
+
+typedef struct _sample_jobs
+{
+    sample_job  job[PATCH_COUNT];
+    int         count;
+} sample_jobs;
+
+
+/*  in lazy mode dish_read does not wait for the samples. each job is
+    instead handed to the worker pool as a background job of its own,
+    and the samples it loads are installed by dish_file_poll, on the
+    thread which read the bank.
+ */
+enum
+{
+    LAZY_QUEUED,
+    LAZY_DONE,
+    LAZY_CANCELLED  /* the worker frees it */
+};
+
+
+typedef struct _lazy_load
+{
+    sample_job      job;
+    unsigned int    serial; /* the patch's when queued */
+    int             state;
+} lazy_load;
+
+
+static bool             lazy = false;
+static lazy_load*       lazy_loads[PATCH_COUNT];
+static int              lazy_count = 0;
+
+/* protects the above, bar lazy itself, and the state of each load */
+static pthread_mutex_t  lazy_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   lazy_cond = PTHREAD_COND_INITIALIZER;
+
+
 
 const char* dish_file_extension(void)
 {
@@ -537,6 +603,9 @@ static int dish_write(void)
     int     patch_count;
     char*   samples_dir = 0;
 
+    /* samples still loading would be saved as missing */
+    dish_file_poll_wait();
+
     setlocale(LC_NUMERIC, "C");
 
     assert(dish_data != 0);
@@ -610,6 +679,9 @@ static int dish_write(void)
         snprintf(buf, CHARBUFSIZE, "%d", patch_get_channel(patch_id[i]));
         xmlNewProp(nodepatch,   BAD_CAST "channel", BAD_CAST buf);
 
+        snprintf(buf, CHARBUFSIZE, "%d", patch_get_bus(patch_id[i]));
+        xmlNewProp(nodepatch,   BAD_CAST "bus", BAD_CAST buf);
+
         /*  ------------------------
             sample
          */
@@ -633,10 +705,19 @@ static int dish_write(void)
         /* play mode, reverse, to_end */
         dish_file_write_sample_mode_props(node1, patch_id[i]);
 
+        /* the rate of the sample data, which the points count in */
+        if (patch_sample_data(patch_id[i])->samplerate > 0)
+        {
+            snprintf(buf, CHARBUFSIZE, "%d",
+                            patch_sample_data(patch_id[i])->samplerate);
+            xmlNewProp(node1, BAD_CAST "samplerate", BAD_CAST buf);
+        }
+
         /* raw samplerate, raw channels, sndfile format */
         dish_file_write_sample_raw(node1, patch_id[i]);
 
-        if (patch_get_sample(patch_id[i]))
+        /* evicted samples (see patch_set_sample_budget) have no data */
+        if (patch_sample_data(patch_id[i])->frames > 0)
         {
             /* sample play */
             node2 = xmlNewTextChild(node1, NULL, BAD_CAST "Play", NULL);
@@ -838,12 +919,14 @@ int get_prop_mod_src(xmlNodePtr node, const char* name, int* mod_id)
 }
 
 
-static int dish_file_read_sample(xmlNodePtr node,  int patch_id)
+static int dish_file_read_sample(xmlNodePtr node,  int patch_id,
+                                                    sample_jobs* jobs)
 {
     xmlChar* prop;
     xmlNodePtr node1;
     char* filename = 0;
-    bool sample_loaded = false;
+    sample_job* job = 0;
+    int i;
 
     int play_start = -1;
     int play_stop = -1;
@@ -852,11 +935,12 @@ static int dish_file_read_sample(xmlNodePtr node,  int patch_id)
     int fade_samples = -1;
     int xfade_samples = -1;
     int mode = PATCH_PLAY_SINGLESHOT;
-    double sr_ratio = 1.0;
 
-    if (dish_data->samplerate
-     && dish_data->samplerate != patch_get_samplerate())
-        sr_ratio = patch_get_samplerate() / (double)dish_data->samplerate;
+    /*  older files only give the master samplerate, which the points
+        were relative to because samples were always resampled to it */
+    int points_rate = dish_data->samplerate;
+
+    get_prop_int(node, "samplerate", &points_rate);
 
     prop = xmlGetProp(node, BAD_CAST "file");
 
@@ -925,64 +1009,74 @@ static int dish_file_read_sample(xmlNodePtr node,  int patch_id)
         if (node1->type != XML_ELEMENT_NODE)
             continue;
 
-        if (!sample_loaded && filename)
+        if (!job && filename)
         {
-            int raw_samplerate = 0;
-            int raw_channels = 0;
-            int sndfile_format = 0;
+            /* a patch only has one sample, the last one read wins */
+            for (i = 0; i < jobs->count; ++i)
+            {
+                if (jobs->job[i].patch_id == patch_id)
+                {
+                    job = &jobs->job[i];
+                    free(job->filename);
+                    break;
+                }
+            }
+
+            if (!job)
+            {
+                if (jobs->count == PATCH_COUNT)
+                {
+                    free(filename);
+                    return -1;
+                }
+
+                job = &jobs->job[jobs->count++];
+            }
+
+            job->patch_id = patch_id;
+            job->filename = filename;
+            job->raw_samplerate = 0;
+            job->raw_channels = 0;
+            job->sndfile_format = 0;
+            job->sample = 0;
+            job->result = -1;
+            job->error = PF_ERR_INVALID_ERROR;
+            filename = 0;
 
             if (xmlStrcmp(node1->name, BAD_CAST "Raw") == 0)
             {
                 if (get_prop_int(node1, "samplerate", &n))
-                        raw_samplerate = n;
+                        job->raw_samplerate = n;
 
                 if (get_prop_int(node1, "channels", &n))
-                        raw_channels = n;
+                        job->raw_channels = n;
 
                 if (get_prop_int(node1, "sndfile_format", &n))
-                        sndfile_format = n;
-            }
-
-            if (patch_sample_load(patch_id, filename,
-                                            raw_samplerate,
-                                            raw_channels,
-                                            sndfile_format) < 0)
-            {
-                msg_log(MSG_ERROR, "failed to load sample: %s error (%s)\n",
-                    filename, pf_error_str(pf_error_get()));
+                        job->sndfile_format = n;
             }
-            else
-            {
-                msg_log(MSG_MESSAGE, "loaded sample %s into patch %d\n",
-                                     filename, patch_id);
-                sample_loaded = true;
-            }
-
-            free(filename);
-            filename = 0;
         }
 
         if (xmlStrcmp(node1->name, BAD_CAST "Play") == 0)
         {
             if (get_prop_int(node1, "start", &n))
-                play_start = n * sr_ratio;
+                play_start = n;
 
             if (get_prop_int(node1, "stop", &n))
-                play_stop = n * sr_ratio;
+                play_stop = n;
 
             if (get_prop_int(node1, "fade_samples", &n))
-                fade_samples = n * sr_ratio;
+                fade_samples = n;
         }
         else if (xmlStrcmp(node1->name, BAD_CAST "Loop") == 0)
         {
             if (get_prop_int(node1, "start", &n))
-                loop_start = n * sr_ratio;
+                loop_start = n;
 
             if (get_prop_int(node1, "stop", &n))
-                loop_stop = n * sr_ratio;
+                loop_stop = n;
 
             if (get_prop_int(node1, "xfade_samples", &n))
-                xfade_samples = n * sr_ratio;
+                xfade_samples = n;
         }
         else if (xmlStrcmp(node1->name, BAD_CAST "Note") == 0)
         {
@@ -1029,28 +1123,224 @@ static int dish_file_read_sample(xmlNodePtr node,  int patch_id)
         }
     }
 
-    if (!sample_loaded)
-    {
-        free(filename);
+    free(filename);
+
+    if (!job)
         return 0;
+
+    job->play_start = play_start;
+    job->play_stop = play_stop;
+    job->loop_start = loop_start;
+    job->loop_stop = loop_stop;
+    job->fade_samples = fade_samples;
+    job->xfade_samples = xfade_samples;
+    job->points_rate = points_rate;
+
+    return 0;
+}
+
+
+/* runs on the worker threads */
+static void dish_file_load_sample(void* data)
+{
+    sample_job* job = data;
+
+    if (!(job->sample = sample_new()))
+    {
+        job->error = pf_error_get();
+        return;
+    }
+
+    job->result = patch_sample_load_data(job->sample, job->filename,
+                                                job->raw_samplerate,
+                                                job->raw_channels,
+                                                job->sndfile_format);
+    if (job->result < 0)
+        job->error = pf_error_get();
+}
+
+
+/* points not read from the file stay negative */
+static void scale_point(int* frame, double ratio)
+{
+    if (*frame > 0)
+        *frame *= ratio;
+}
+
+
+static int dish_file_install_sample(sample_job* job)
+{
+    int id = job->patch_id;
+    int rate;
+
+    if (!job->sample
+     || patch_sample_install(id, job->sample, job->result) < 0)
+    {
+        msg_log(MSG_ERROR, "failed to load sample: %s error (%s)\n",
+                    job->filename, pf_error_str(job->error));
+        return -1;
     }
 
-    if (sanitize_sample_points( &play_start,    &play_stop,
-                                &loop_start,    &loop_stop,
-                                &fade_samples,  &xfade_samples,
-                    patch_get_mark_frame(patch_id, WF_MARK_STOP)) < 0)
+    msg_log(MSG_MESSAGE, "loaded sample %s into patch %d\n",
+                         job->filename, id);
+
+    rate = patch_sample_data(id)->samplerate;
+
+    if (job->points_rate > 0 && rate > 0 && job->points_rate != rate)
+    {
+        double sr_ratio = rate / (double)job->points_rate;
+
+        scale_point(&job->play_start, sr_ratio);
+        scale_point(&job->play_stop, sr_ratio);
+        scale_point(&job->loop_start, sr_ratio);
+        scale_point(&job->loop_stop, sr_ratio);
+        scale_point(&job->fade_samples, sr_ratio);
+        scale_point(&job->xfade_samples, sr_ratio);
+    }
+
+    if (sanitize_sample_points( &job->play_start,   &job->play_stop,
+                                &job->loop_start,   &job->loop_stop,
+                                &job->fade_samples, &job->xfade_samples,
+                    patch_get_mark_frame(id, WF_MARK_STOP)) < 0)
     {
         /* it's all so borked that sanity becomes impossible */
         return -1;
     }
 
-    patch_sample_set_points(patch_id,   play_start,     play_stop,
-                                        loop_start,     loop_stop,
-                                        fade_samples,   xfade_samples);
+    patch_sample_set_points(id, job->play_start,    job->play_stop,
+                                job->loop_start,    job->loop_stop,
+                                job->fade_samples,  job->xfade_samples);
     return 0;
 }
 
 
+static void lazy_load_free(lazy_load* ll)
+{
+    if (ll->job.sample)
+        sample_free(ll->job.sample);
+
+    free(ll->job.filename);
+    free(ll);
+}
+
+
+/* runs on the worker threads */
+static void lazy_load_job(void* data)
+{
+    lazy_load* ll = data;
+    bool cancelled;
+
+    pthread_mutex_lock(&lazy_mutex);
+    cancelled = (ll->state == LAZY_CANCELLED);
+    pthread_mutex_unlock(&lazy_mutex);
+
+    if (!cancelled && !worker_quitting())
+        dish_file_load_sample(&ll->job);
+
+    pthread_mutex_lock(&lazy_mutex);
+
+    if (!(cancelled = (ll->state == LAZY_CANCELLED)))
+    {
+        ll->state = LAZY_DONE;
+        pthread_cond_broadcast(&lazy_cond);
+    }
+
+    pthread_mutex_unlock(&lazy_mutex);
+
+    if (cancelled)
+        lazy_load_free(ll);
+}
+
+
+/*  queues the jobs, most recently played channels first and otherwise
+    in the order the bank gave them, so that what was being played
+    before the bank was (re)opened is heard again soonest */
+static void lazy_load_queue(sample_jobs* jobs)
+{
+    unsigned long used[PATCH_COUNT];
+    int order[PATCH_COUNT];
+    lazy_load* ll;
+    int i, j;
+
+    for (i = 0; i < jobs->count; ++i)
+    {
+        unsigned long u = patch_channel_last_used(
+                            patch_get_channel(jobs->job[i].patch_id));
+
+        for (j = i; j > 0 && used[j - 1] < u; --j)
+        {
+            used[j] = used[j - 1];
+            order[j] = order[j - 1];
+        }
+
+        used[j] = u;
+        order[j] = i;
+    }
+
+    for (i = 0; i < jobs->count; ++i)
+    {
+        sample_job* job = &jobs->job[order[i]];
+
+        if (!(ll = malloc(sizeof(*ll))))
+            goto now;
+
+        ll->job = *job;
+        ll->serial = patch_sample_get_serial(job->patch_id);
+        ll->state = LAZY_QUEUED;
+
+        pthread_mutex_lock(&lazy_mutex);
+
+        if (lazy_count < PATCH_COUNT)
+            lazy_loads[lazy_count++] = ll;
+        else
+        {
+            pthread_mutex_unlock(&lazy_mutex);
+            free(ll);
+            goto now;
+        }
+
+        pthread_mutex_unlock(&lazy_mutex);
+
+        if (worker_submit(lazy_load_job, ll) == 0)
+            continue;
+
+        /* no pool to give it to, so it's done here after all */
+        dish_file_load_sample(&ll->job);
+
+        pthread_mutex_lock(&lazy_mutex);
+        ll->state = LAZY_DONE;
+        pthread_mutex_unlock(&lazy_mutex);
+        continue;
+
+    now:
+        dish_file_load_sample(job);
+        dish_file_install_sample(job);
+        free(job->filename);
+    }
+}
+
+
+/* forgets every load still to be installed (ie for a new bank) */
+static void lazy_load_cancel_all(void)
+{
+    int i;
+
+    pthread_mutex_lock(&lazy_mutex);
+
+    for (i = 0; i < lazy_count; ++i)
+    {
+        if (lazy_loads[i]->state == LAZY_DONE)
+            lazy_load_free(lazy_loads[i]);
+        else
+            lazy_loads[i]->state = LAZY_CANCELLED;
+    }
+
+    lazy_count = 0;
+
+    pthread_mutex_unlock(&lazy_mutex);
+}
+
+
 static int dish_file_read_eg(xmlNodePtr node, int patch_id)
 {
     int eg_id = 0;
@@ -1456,6 +1746,7 @@ static int dish_read(const char *path)
     float   n;
     int i;
     bool full_save = false;
+    sample_jobs* jobs;
 
     setlocale(LC_NUMERIC, "C");
 
@@ -1513,6 +1804,16 @@ static int dish_read(const char *path)
 
     dish_data->samplerate = 0;
 
+    if (!(jobs = malloc(sizeof(*jobs))))
+    {
+        msg_log(MSG_ERROR, "out of memory reading %s\n", path);
+        xmlFreeDoc(doc);
+        setlocale(LC_NUMERIC, "");
+        return -1;
+    }
+
+    jobs->count = 0;
+
     for (node1 = noderoot->children;
          node1 != NULL;
          node1 = node1->next)
@@ -1547,6 +1848,9 @@ static int dish_read(const char *path)
             if (get_prop_int(nodepatch, "channel", &i))
                 patch_set_channel(patch_id, i);
 
+            if (get_prop_int(nodepatch, "bus", &i))
+                patch_set_bus(patch_id, i);
+
             msg_log(MSG_MESSAGE, "Reading data for patch %d '%s'\n",
                                  patch_id, patch_get_name(patch_id));
 
@@ -1559,7 +1863,7 @@ static int dish_read(const char *path)
 
                 if (xmlStrcmp(node2->name, BAD_CAST "Sample") == 0)
                 {
-                    dish_file_read_sample(node2, patch_id);
+                    dish_file_read_sample(node2, patch_id, jobs);
                 }
                 else if (xmlStrcmp(node2->name, BAD_CAST "Amplitude") ==0)
                 {
@@ -1627,6 +1931,21 @@ static int dish_read(const char *path)
 
     xmlFreeDoc(doc);
 
+    if (__atomic_load_n(&lazy, __ATOMIC_RELAXED))
+        lazy_load_queue(jobs);
+    else
+    {
+        worker_run_batch(dish_file_load_sample, jobs->job, jobs->count,
+                                                    sizeof(sample_job));
+        for (i = 0; i < jobs->count; ++i)
+        {
+            dish_file_install_sample(&jobs->job[i]);
+            free(jobs->job[i].filename);
+        }
+    }
+
+    free(jobs);
+
     msg_log(MSG_MESSAGE, "Successfully read dish file '%s'\n", path);
 
     setlocale(LC_NUMERIC, "");
@@ -1793,11 +2112,101 @@ const char* dish_file_state_path(void)
 
 int dish_file_read(const char* path)
 {
+    lazy_load_cancel_all();
     patch_destroy_all();
     return dish_read(path);
 }
 
 
+void dish_file_set_lazy(bool set)
+{
+    __atomic_store_n(&lazy, set, __ATOMIC_RELAXED);
+}
+
+
+int dish_file_poll(void)
+{
+    lazy_load* done[PATCH_COUNT];
+    int count = 0;
+    int finished = 0;
+    int i;
+
+    pthread_mutex_lock(&lazy_mutex);
+
+    for (i = 0; i < lazy_count; )
+    {
+        if (lazy_loads[i]->state == LAZY_DONE)
+        {
+            done[count++] = lazy_loads[i];
+            lazy_loads[i] = lazy_loads[--lazy_count];
+        }
+        else
+            ++i;
+    }
+
+    pthread_mutex_unlock(&lazy_mutex);
+
+    for (i = 0; i < count; ++i)
+    {
+        sample_job* job = &done[i]->job;
+
+        /* unless the patch has gone, or been given another sample */
+        if (done[i]->serial == patch_sample_get_serial(job->patch_id))
+        {
+            dish_file_install_sample(job);
+            job->sample = 0;
+            ++finished;
+        }
+
+        lazy_load_free(done[i]);
+    }
+
+    return finished;
+}
+
+
+void dish_file_poll_wait(void)
+{
+    pthread_mutex_lock(&lazy_mutex);
+
+    for (;;)
+    {
+        int i;
+
+        for (i = 0; i < lazy_count; ++i)
+            if (lazy_loads[i]->state == LAZY_QUEUED)
+                break;
+
+        if (i == lazy_count)
+            break;
+
+        pthread_cond_wait(&lazy_cond, &lazy_mutex);
+    }
+
+    pthread_mutex_unlock(&lazy_mutex);
+
+    dish_file_poll();
+}
+
+
+bool dish_file_patch_loading(int patch_id)
+{
+    bool loading = false;
+    int i;
+
+    pthread_mutex_lock(&lazy_mutex);
+
+    for (i = 0; i < lazy_count && !loading; ++i)
+        loading = (lazy_loads[i]->job.patch_id == patch_id
+                && lazy_loads[i]->serial
+                                    == patch_sample_get_serial(patch_id));
+
+    pthread_mutex_unlock(&lazy_mutex);
+
+    return loading;
+}
+
+
 int dish_file_import(const char* path)
 {
     int ret;
@@ -92,4 +92,23 @@ int     dish_file_export(const char* path);
 int     dish_file_write(void);
 
 
+/*  when lazy is set dish_file_read and dish_file_import return as
+    soon as the bank's patches have been created, and the samples are
+    loaded in the background by the worker pool, those for the most
+    recently played channels first. a patch is silent until its sample
+    has been installed by dish_file_poll, which must be called, every
+    so often, by the thread that read the bank.
+
+    dish_file_poll returns how many patches it installed samples for
+    (or failed to). dish_file_poll_wait waits for the samples still
+    loading, and installs them, as saving does first.
+
+    dish_file_patch_loading tells if patch_id is still waiting.
+ */
+void    dish_file_set_lazy(bool);
+int     dish_file_poll(void);
+void    dish_file_poll_wait(void);
+bool    dish_file_patch_loading(int patch_id);
+
+
 #endif
@@ -29,6 +29,7 @@
 #include "instance.h"
 #include "petri-foo.h"
 #include "msg_log.h"
+#include "rtlog.h"
 
 
 static bool         msg_log_notification_state = false;
@@ -155,6 +156,22 @@ skip:
 }
 
 
+void msg_log_rtlog_sink(int level, const char* msg)
+{
+    static const int types[] = {
+        MSG_DEBUG,      /* RTLOG_DEBUG */
+        MSG_MESSAGE,    /* RTLOG_MESSAGE */
+        MSG_WARNING,    /* RTLOG_WARNING */
+        MSG_ERROR       /* RTLOG_ERROR */
+    };
+
+    if (level < RTLOG_DEBUG || level > RTLOG_ERROR)
+        level = RTLOG_ERROR;
+
+    msg_log(types[level], "%s", msg);
+}
+
+
 /*  were there any errors? */
 bool msg_log_get_notification_state(void)
 {
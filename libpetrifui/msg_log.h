@@ -95,6 +95,10 @@ char*   strconcat(const char*, const char*);
 int     msg_log(int type, const char* format, ...);
 void    msg_log_set_message_cb(msg_log_cb);
 
+/*  logs the messages the engine's threads leave with rtlog, for use
+    as its sink (see rtlog.h) */
+void    msg_log_rtlog_sink(int level, const char* msg);
+
 bool    msg_log_get_notification_state(void);
 void    msg_log_reset_notification_state(void);
 
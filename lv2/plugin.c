@@ -0,0 +1,597 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*  an LV2 instrument wrapping an engine (see engine.h) of its own.
+
+    MIDI arrives on the control port and is played at the frame it is
+    stamped with. banks are loaded by the host's worker thread, either
+    when the bank parameter is set (by a patch:Set message on the
+    control port) or when the plugin's state is restored, and saved
+    with its state.
+ */
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lv2/lv2plug.in/ns/lv2core/lv2.h"
+#include "lv2/lv2plug.in/ns/ext/atom/atom.h"
+#include "lv2/lv2plug.in/ns/ext/atom/util.h"
+#include "lv2/lv2plug.in/ns/ext/midi/midi.h"
+#include "lv2/lv2plug.in/ns/ext/patch/patch.h"
+#include "lv2/lv2plug.in/ns/ext/state/state.h"
+#include "lv2/lv2plug.in/ns/ext/urid/urid.h"
+#include "lv2/lv2plug.in/ns/ext/worker/worker.h"
+
+#include "dish_file.h"
+#include "driver.h"
+#include "engine.h"
+#include "gc.h"
+#include "lfo.h"
+#include "midi_control.h"
+#include "mixer.h"
+#include "mod_src.h"
+#include "patch_util.h"
+#include "petri-foo.h"
+#include "worker.h"
+
+
+#define PETRI_FOO_LV2_URI       "http://petri-foo.sourceforge.net/lv2"
+#define PETRI_FOO_LV2__bank     PETRI_FOO_LV2_URI "#bank"
+#define PETRI_FOO_LV2_BANK_FILE "bank.petri-foo"
+
+
+MIDI_CONTROL_H__CC_MAP_DEF
+
+
+enum
+{
+    PORT_CONTROL =  0,
+    PORT_LEFT =     1,
+    PORT_RIGHT =    2,
+
+    /*  the most frames mixed at once, hosts may ask for any number.
+        events are still played at their own frame within a block. */
+    BLOCK =         512
+};
+
+
+typedef struct _PetriFooURIs
+{
+    LV2_URID    atom_Path;
+    LV2_URID    atom_URID;
+    LV2_URID    atom_Object;
+    LV2_URID    atom_Blank;
+    LV2_URID    midi_MidiEvent;
+    LV2_URID    patch_Set;
+    LV2_URID    patch_property;
+    LV2_URID    patch_value;
+    LV2_URID    bank;
+
+} PetriFooURIs;
+
+
+typedef struct _PetriFoo
+{
+    Engine*                     engine;
+    Tick                        ticks;      /* frames rendered so far */
+
+    const LV2_Atom_Sequence*    control;
+    float*                      left;
+    float*                      right;
+
+    LV2_URID_Map*               map;
+    LV2_Worker_Schedule*        schedule;
+    PetriFooURIs                uris;
+
+    char*                       bank;   /* last loaded, under dish_mutex */
+
+} PetriFoo;
+
+
+/* the shared parts of the library, set up for the first instance */
+static int              instances = 0;
+static pthread_mutex_t  instances_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* dish_file keeps the bank being read or written in a global */
+static pthread_mutex_t  dish_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* the end of the block being mixed, for the mixer's clock */
+static __thread Tick    block_end = 0;
+
+
+static Tick block_time(void)
+{
+    return block_end;
+}
+
+
+static void library_init(void)
+{
+    pthread_mutex_lock(&instances_mutex);
+
+    if (instances++ == 0)
+    {
+        mod_src_create();
+        lfo_tables_init();
+        worker_init(0);
+        gc_init();
+    }
+
+    pthread_mutex_unlock(&instances_mutex);
+}
+
+
+static void library_shutdown(void)
+{
+    pthread_mutex_lock(&instances_mutex);
+
+    if (--instances == 0)
+    {
+        worker_shutdown();
+        gc_shutdown();
+        mod_src_destroy();
+    }
+
+    pthread_mutex_unlock(&instances_mutex);
+}
+
+
+static const void* get_feature(const LV2_Feature* const* features,
+                                                    const char* uri)
+{
+    int i;
+
+    for (i = 0; features && features[i]; ++i)
+        if (strcmp(features[i]->URI, uri) == 0)
+            return features[i]->data;
+
+    return 0;
+}
+
+
+static void map_uris(PetriFoo* pf)
+{
+    LV2_URID_Map* map = pf->map;
+
+    pf->uris.atom_Path =        map->map(map->handle, LV2_ATOM__Path);
+    pf->uris.atom_URID =        map->map(map->handle, LV2_ATOM__URID);
+    pf->uris.atom_Object =      map->map(map->handle, LV2_ATOM__Object);
+    pf->uris.atom_Blank =       map->map(map->handle, LV2_ATOM__Blank);
+    pf->uris.midi_MidiEvent =   map->map(map->handle, LV2_MIDI__MidiEvent);
+    pf->uris.patch_Set =        map->map(map->handle, LV2_PATCH__Set);
+    pf->uris.patch_property =   map->map(map->handle, LV2_PATCH__property);
+    pf->uris.patch_value =      map->map(map->handle, LV2_PATCH__value);
+    pf->uris.bank =             map->map(map->handle, PETRI_FOO_LV2__bank);
+}
+
+
+/* not RT: replaces the patches of pf's engine with those of the bank */
+static int load_bank(PetriFoo* pf, const char* path)
+{
+    Engine* prev = engine_current();
+    int ret;
+
+    debug("loading bank %s\n", path);
+
+    pthread_mutex_lock(&dish_mutex);
+    engine_select(pf->engine);
+
+    patch_destroy_all();
+
+    /* import rather than read, the global bank state isn't ours */
+    if ((ret = dish_file_import(path)) == 0)
+    {
+        free(pf->bank);
+        pf->bank = strdup(path);
+    }
+
+    engine_select(prev);
+    pthread_mutex_unlock(&dish_mutex);
+
+    return ret;
+}
+
+
+static void play_midi(const uint8_t* data, uint32_t size, Tick offset)
+{
+    int chan = data[0] & 0x0F;
+
+    if (size < 3)
+        return;
+
+    switch (data[0] & 0xF0)
+    {
+    case 0x80:
+        mixer_direct_note_off(chan, data[1], offset);
+        break;
+
+    case 0x90:
+        if (data[2] == 0)
+            mixer_direct_note_off(chan, data[1], offset);
+        else
+            mixer_direct_note_on(chan, data[1], data[2] / 127.0, offset);
+        break;
+
+    case 0xB0:
+        mixer_direct_control(chan, data[1], cc_map(data[1], data[2]),
+                                                                offset);
+        break;
+
+    case 0xE0:
+        mixer_direct_control(chan, CC_PITCH_WHEEL,
+                        -1.0 + ((data[2] << 7) | data[1]) / 8192.0, offset);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/* RT: hands a patch:Set of the bank to the worker */
+static void set_parameter(PetriFoo* pf, const LV2_Atom_Object* obj)
+{
+    const LV2_Atom* property = 0;
+    const LV2_Atom* value = 0;
+
+    if (obj->body.otype != pf->uris.patch_Set)
+        return;
+
+    lv2_atom_object_get(obj, pf->uris.patch_property, &property,
+                             pf->uris.patch_value, &value, 0);
+
+    if (!property || !value
+     || property->type != pf->uris.atom_URID
+     || ((const LV2_Atom_URID*)property)->body != pf->uris.bank
+     || value->type != pf->uris.atom_Path)
+        return;
+
+    pf->schedule->schedule_work(pf->schedule->handle,
+                                sizeof(*value) + value->size, value);
+}
+
+
+/* RT: mixes frames (no more than BLOCK) at offset into the outputs */
+static void mix_block(PetriFoo* pf, uint32_t offset, uint32_t frames)
+{
+    MixerBus bus;
+
+    bus.left = pf->left + offset;
+    bus.right = pf->right + offset;
+
+    block_end = pf->ticks + frames;
+    mixer_mixdown(pf->engine, &bus, 1, frames);
+    pf->ticks += frames;
+}
+
+
+static LV2_Handle instantiate(const LV2_Descriptor* descriptor,
+                              double rate, const char* bundle_path,
+                              const LV2_Feature* const* features)
+{
+    PetriFoo* pf;
+    Engine* prev;
+
+    (void)descriptor;
+    (void)bundle_path;
+
+    if (!(pf = calloc(1, sizeof(*pf))))
+        return 0;
+
+    pf->map = (LV2_URID_Map*)get_feature(features, LV2_URID__map);
+    pf->schedule = (LV2_Worker_Schedule*)get_feature(features,
+                                                LV2_WORKER__schedule);
+    if (!pf->map || !pf->schedule)
+    {
+        debug("host lacks urid:map or worker:schedule\n");
+        free(pf);
+        return 0;
+    }
+
+    map_uris(pf);
+    library_init();
+
+    if (!(pf->engine = engine_new()))
+    {
+        library_shutdown();
+        free(pf);
+        return 0;
+    }
+
+    prev = engine_current();
+    engine_select(pf->engine);
+
+    driver_set_samplerate(rate);
+    driver_set_buffersize(BLOCK);
+    mixer_set_clock(block_time, 0);
+
+    engine_select(prev);
+
+    return pf;
+}
+
+
+static void connect_port(LV2_Handle instance, uint32_t port, void* data)
+{
+    PetriFoo* pf = instance;
+
+    switch (port)
+    {
+    case PORT_CONTROL:
+        pf->control = data;
+        break;
+
+    case PORT_LEFT:
+        pf->left = data;
+        break;
+
+    case PORT_RIGHT:
+        pf->right = data;
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+static void activate(LV2_Handle instance)
+{
+    PetriFoo* pf = instance;
+
+    pf->ticks = 0;
+}
+
+
+static void run(LV2_Handle instance, uint32_t nframes)
+{
+    PetriFoo* pf = instance;
+    Engine* prev = engine_current();
+    uint32_t pos = 0;   /* frames mixed so far */
+    uint32_t at;
+    uint32_t n;
+
+    if (nframes == 0)
+        return;
+
+    engine_select(pf->engine);
+
+    LV2_ATOM_SEQUENCE_FOREACH(pf->control, ev)
+    {
+        at = ev->time.frames;
+
+        if (at >= nframes)
+            at = nframes - 1;
+
+        /* mix up to the block the event falls in */
+        while (at - pos >= BLOCK)
+        {
+            mix_block(pf, pos, BLOCK);
+            pos += BLOCK;
+        }
+
+        if (ev->body.type == pf->uris.midi_MidiEvent)
+        {
+            play_midi(LV2_ATOM_BODY_CONST(&ev->body), ev->body.size,
+                                                                at - pos);
+        }
+        else if (ev->body.type == pf->uris.atom_Object
+              || ev->body.type == pf->uris.atom_Blank)
+        {
+            set_parameter(pf, (const LV2_Atom_Object*)&ev->body);
+        }
+    }
+
+    for (; pos < nframes; pos += n)
+    {
+        n = (nframes - pos < BLOCK) ? nframes - pos : BLOCK;
+        mix_block(pf, pos, n);
+    }
+
+    engine_select(prev);
+}
+
+
+static void cleanup(LV2_Handle instance)
+{
+    PetriFoo* pf = instance;
+
+    engine_free(pf->engine);
+    library_shutdown();
+
+    free(pf->bank);
+    free(pf);
+}
+
+
+static LV2_Worker_Status work(LV2_Handle instance,
+                              LV2_Worker_Respond_Function respond,
+                              LV2_Worker_Respond_Handle handle,
+                              uint32_t size, const void* data)
+{
+    PetriFoo* pf = instance;
+    const LV2_Atom* path = data;
+    char* s;
+
+    (void)respond;
+    (void)handle;
+
+    if (size < sizeof(*path) || path->type != pf->uris.atom_Path)
+        return LV2_WORKER_ERR_UNKNOWN;
+
+    /* the path may not be terminated */
+    if (!(s = strndup(LV2_ATOM_BODY_CONST(path), path->size)))
+        return LV2_WORKER_ERR_UNKNOWN;
+
+    load_bank(pf, s);
+    free(s);
+
+    return LV2_WORKER_SUCCESS;
+}
+
+
+static LV2_Worker_Status work_response(LV2_Handle instance,
+                                       uint32_t size, const void* data)
+{
+    (void)instance;
+    (void)size;
+    (void)data;
+
+    return LV2_WORKER_SUCCESS;
+}
+
+
+static LV2_State_Status save(LV2_Handle instance,
+                             LV2_State_Store_Function store,
+                             LV2_State_Handle handle, uint32_t flags,
+                             const LV2_Feature* const* features)
+{
+    PetriFoo* pf = instance;
+    LV2_State_Map_Path* map_path;
+    LV2_State_Make_Path* make_path;
+    Engine* prev;
+    char* path = 0;
+    char* apath;
+
+    (void)flags;
+
+    map_path = (LV2_State_Map_Path*)get_feature(features,
+                                                LV2_STATE__mapPath);
+    make_path = (LV2_State_Make_Path*)get_feature(features,
+                                                LV2_STATE__makePath);
+
+    pthread_mutex_lock(&dish_mutex);
+
+    if (make_path)
+    {   /* the bank as it is now, edits and all */
+        path = make_path->path(make_path->handle,
+                                            PETRI_FOO_LV2_BANK_FILE);
+        prev = engine_current();
+        engine_select(pf->engine);
+
+        if (path && dish_file_export(path) < 0)
+        {
+            free(path);
+            path = 0;
+        }
+
+        engine_select(prev);
+    }
+
+    if (!path && pf->bank)
+        path = strdup(pf->bank);
+
+    pthread_mutex_unlock(&dish_mutex);
+
+    if (!path)
+        return LV2_STATE_SUCCESS;
+
+    apath = map_path ? map_path->abstract_path(map_path->handle, path)
+                     : strdup(path);
+    free(path);
+
+    if (!apath)
+        return LV2_STATE_ERR_UNKNOWN;
+
+    store(handle, pf->uris.bank, apath, strlen(apath) + 1,
+                        pf->uris.atom_Path,
+                        LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+    free(apath);
+
+    return LV2_STATE_SUCCESS;
+}
+
+
+static LV2_State_Status restore(LV2_Handle instance,
+                                LV2_State_Retrieve_Function retrieve,
+                                LV2_State_Handle handle, uint32_t flags,
+                                const LV2_Feature* const* features)
+{
+    PetriFoo* pf = instance;
+    LV2_State_Map_Path* map_path;
+    const char* value;
+    char* path;
+    size_t size;
+    uint32_t type;
+    uint32_t vflags;
+    int ret;
+
+    (void)flags;
+
+    value = retrieve(handle, pf->uris.bank, &size, &type, &vflags);
+
+    if (!value || type != pf->uris.atom_Path)
+        return LV2_STATE_SUCCESS;
+
+    map_path = (LV2_State_Map_Path*)get_feature(features,
+                                                LV2_STATE__mapPath);
+
+    path = map_path ? map_path->absolute_path(map_path->handle, value)
+                    : strdup(value);
+    if (!path)
+        return LV2_STATE_ERR_UNKNOWN;
+
+    /* the host doesn't run us meanwhile, so load straight away */
+    ret = load_bank(pf, path);
+    free(path);
+
+    return (ret < 0) ? LV2_STATE_ERR_UNKNOWN : LV2_STATE_SUCCESS;
+}
+
+
+static const void* extension_data(const char* uri)
+{
+    static const LV2_Worker_Interface worker =
+    {
+        work, work_response, 0
+    };
+
+    static const LV2_State_Interface state =
+    {
+        save, restore
+    };
+
+    if (strcmp(uri, LV2_WORKER__interface) == 0)
+        return &worker;
+
+    if (strcmp(uri, LV2_STATE__interface) == 0)
+        return &state;
+
+    return 0;
+}
+
+
+static const LV2_Descriptor descriptor =
+{
+    PETRI_FOO_LV2_URI,
+    instantiate,
+    connect_port,
+    activate,
+    run,
+    0,
+    cleanup,
+    extension_data
+};
+
+
+LV2_SYMBOL_EXPORT const LV2_Descriptor* lv2_descriptor(uint32_t index)
+{
+    return (index == 0) ? &descriptor : 0;
+}
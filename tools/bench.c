@@ -0,0 +1,666 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*  petri-foo-bench
+        times the engine's hot paths, each on its own and then end to
+        end, on the offline driver. results are in nanoseconds per
+        frame (per voice where there are voices) and may be saved, to
+        be compared against by a later run.
+ */
+
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "adsr.h"
+#include "headless.h"
+#include "lfo.h"
+#include "maths.h"
+#include "mixer.h"
+#include "offlinedriver.h"
+#include "patch.h"
+#include "patch_set_and_get.h"
+#include "patch_util.h"
+#include "sample.h"
+
+
+enum {
+    DEFAULT_RATE =      48000,
+    DEFAULT_PERIOD =    64,
+    BENCH_REPS =        5,
+    BENCH_MAX =         64,     /* most results one run can hold */
+    SAMPLE_SECS =       4,
+    ROOT_NOTE =         60
+};
+
+
+typedef struct _BenchResult
+{
+    char    name[64];
+    double  ns;         /* best of BENCH_REPS, per unit */
+    const char* unit;
+
+} BenchResult;
+
+
+/*  a benchmark is a pass over some work, timed, repeated until enough
+    time has passed to trust. prepare (if any) is called before each
+    pass, untimed. run returns how many units of work it did. */
+typedef void    (*BenchPrepare)(void* data);
+typedef double  (*BenchRun)(void* data);
+
+
+static BenchResult  results[BENCH_MAX];
+static int          nresults = 0;
+static double       min_time = 0.25;    /* seconds per repetition */
+static const char*  filter = 0;
+
+static int          rate = DEFAULT_RATE;
+static int          period = DEFAULT_PERIOD;
+static float*       buf = 0;
+static MixerBus     bus;            /* the two halves of buf */
+
+static volatile float sink;
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static bool bench_wanted(const char* name)
+{
+    return !filter || strstr(name, filter);
+}
+
+
+static void bench(const char* name, const char* unit,
+                            BenchPrepare prepare, BenchRun run, void* data)
+{
+    BenchResult* r;
+    double best = 0;
+    int rep;
+
+    if (!bench_wanted(name) || nresults == BENCH_MAX)
+        return;
+
+    for (rep = 0; rep < BENCH_REPS; ++rep)
+    {
+        double spent = 0;
+        double units = 0;
+        double t;
+
+        while (spent < min_time * 1e9)
+        {
+            if (prepare)
+                prepare(data);
+
+            t = now_ns();
+            units += run(data);
+            spent += now_ns() - t;
+        }
+
+        if (units > 0 && (rep == 0 || spent / units < best))
+            best = spent / units;
+    }
+
+    r = &results[nresults++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->ns = best;
+    r->unit = unit;
+
+    printf("%-36s %12.3f %s\n", r->name, r->ns, r->unit);
+    fflush(stdout);
+}
+
+
+/**************************************************************************
+ *  kernels
+ */
+
+enum { KERNEL_FRAMES = 4096 };
+
+static float kernel_data[KERNEL_FRAMES + 3];
+
+
+static double run_cerp(void* data)
+{
+    float s = 0;
+    int i;
+
+    (void)data;
+
+    for (i = 0; i < KERNEL_FRAMES; ++i)
+        s += cerp(kernel_data[i],       kernel_data[i + 1],
+                  kernel_data[i + 2],   kernel_data[i + 3], i & 0xff);
+
+    sink = s;
+
+    return KERNEL_FRAMES;
+}
+
+
+static void prepare_adsr(void* data)
+{
+    ADSRParams params;
+
+    adsr_params_init(&params, 0.01, 0.5);
+    params.decay = 0.1;
+    params.sustain = 0.5;
+    adsr_set_params(data, &params);
+    adsr_trigger(data, 0.5, 1.0);
+}
+
+
+static double run_adsr(void* data)
+{
+    float s = 0;
+    int i;
+
+    for (i = 0; i < KERNEL_FRAMES; ++i)
+        s += adsr_tick(data);
+
+    sink = s;
+
+    return KERNEL_FRAMES;
+}
+
+
+static double run_lfo(void* data)
+{
+    float s = 0;
+    int i;
+
+    for (i = 0; i < KERNEL_FRAMES; ++i)
+        s += lfo_tick(data);
+
+    sink = s;
+
+    return KERNEL_FRAMES;
+}
+
+
+static void bench_kernels(void)
+{
+    ADSR* env;
+    LFO* lfo;
+    LFOParams lfopar;
+    int i;
+
+    for (i = 0; i < KERNEL_FRAMES + 3; ++i)
+        kernel_data[i] = sinf(i * 0.01f);
+
+    bench("cerp", "ns/frame", 0, run_cerp, 0);
+
+    if ((env = adsr_new()))
+    {
+        adsr_init(env);
+        bench("adsr_tick", "ns/frame", prepare_adsr, run_adsr, env);
+        adsr_free(env);
+    }
+
+    if ((lfo = lfo_new()))
+    {
+        lfo_init(lfo);
+        lfo_params_init(&lfopar, 5.0, LFO_SHAPE_SINE);
+        lfo_trigger(lfo, &lfopar);
+        bench("lfo_tick", "ns/frame", 0, run_lfo, lfo);
+        lfo_free(lfo);
+    }
+}
+
+
+/**************************************************************************
+ *  voices
+ */
+
+typedef struct _VoiceBench
+{
+    int ids[PATCH_COUNT];
+    int npatches;
+    int voices;
+
+} VoiceBench;
+
+
+/* stops every voice and starts vb->voices, spread over the patches */
+static void prepare_voices(void* data)
+{
+    VoiceBench* vb = data;
+    int i;
+
+    for (i = 0; i < vb->npatches; ++i)
+        patch_flush(vb->ids[i]);
+
+    for (i = 0; i < vb->voices; ++i)
+        patch_trigger_with_id(engine_current(),
+                              vb->ids[i / PATCH_VOICE_COUNT],
+                              ROOT_NOTE + i % PATCH_VOICE_COUNT, 1.0, i);
+}
+
+
+static double run_voices(void* data)
+{
+    VoiceBench* vb = data;
+    int frames;
+
+    /*  a second's worth: notes at most PATCH_VOICE_COUNT semitones
+        above the root play less than SAMPLE_SECS of the sample */
+    for (frames = 0; frames < rate; frames += period)
+    {
+        memset(buf, 0, sizeof(float) * period * 2);
+        patch_render(engine_current(), &bus, 1, 0, period);
+    }
+
+    return (double)frames * vb->voices;
+}
+
+
+static void bench_voices(const char* sample_path)
+{
+    static const struct { const char* name; PatchPlayMode mode; } modes[] =
+    {
+        { "singleshot", PATCH_PLAY_SINGLESHOT },
+        { "reverse",    PATCH_PLAY_SINGLESHOT | PATCH_PLAY_REVERSE },
+        { "trim",       PATCH_PLAY_TRIM },
+        { "loop",       PATCH_PLAY_LOOP },
+        { "pingpong",   PATCH_PLAY_LOOP | PATCH_PLAY_PINGPONG },
+    };
+
+    static const int voices[] = { 1, 16, 64 };
+
+    VoiceBench vb;
+    char name[64];
+    size_t m, v;
+    int i;
+
+    memset(&vb, 0, sizeof(vb));
+    vb.npatches = voices[sizeof(voices) / sizeof(*voices) - 1]
+                                                    / PATCH_VOICE_COUNT;
+
+    for (i = 0; i < vb.npatches; ++i)
+    {
+        if ((vb.ids[i] = patch_create()) < 0
+         || patch_sample_load(vb.ids[i], sample_path, 0, 0, 0) < 0)
+        {
+            fprintf(stderr, "failed to set up patches\n");
+            vb.npatches = i + (vb.ids[i] >= 0);
+            goto done;
+        }
+
+        patch_set_lower_note(vb.ids[i], 0);
+        patch_set_upper_note(vb.ids[i], 127);
+        patch_set_root_note(vb.ids[i], ROOT_NOTE);
+    }
+
+    for (m = 0; m < sizeof(modes) / sizeof(*modes); ++m)
+    {
+        for (i = 0; i < vb.npatches; ++i)
+            patch_set_play_mode(vb.ids[i], modes[m].mode);
+
+        for (v = 0; v < sizeof(voices) / sizeof(*voices); ++v)
+        {
+            vb.voices = voices[v];
+            snprintf(name, sizeof(name), "patch_render/%s/%d",
+                                            modes[m].name, voices[v]);
+            bench(name, "ns/frame/voice", prepare_voices, run_voices, &vb);
+        }
+    }
+
+done:
+    for (i = 0; i < vb.npatches; ++i)
+        patch_destroy(vb.ids[i]);
+}
+
+
+/**************************************************************************
+ *  mixdown
+ */
+
+typedef struct _MixdownBench
+{
+    int events;
+    int note;
+
+} MixdownBench;
+
+
+static double run_mixdown(void* data)
+{
+    MixdownBench* mb = data;
+    int i;
+
+    /*  queued as any thread other than the audio thread would, and
+        played by the period rendered next */
+    for (i = 0; i < mb->events; i += 2)
+    {
+        mixer_note_on(0, ROOT_NOTE + mb->note, 1.0);
+        mixer_note_off(0, ROOT_NOTE + mb->note);
+        mb->note = (mb->note + 1) % PATCH_VOICE_COUNT;
+    }
+
+    offline_driver_render();
+
+    return period;
+}
+
+
+static void bench_mixdown(const char* sample_path)
+{
+    static const int events[] = { 0, 16, 256 };
+
+    MixdownBench mb;
+    char name[64];
+    size_t e;
+    int id;
+
+    if ((id = patch_create()) < 0
+     || patch_sample_load(id, sample_path, 0, 0, 0) < 0)
+    {
+        fprintf(stderr, "failed to set up patch\n");
+
+        if (id >= 0)
+            patch_destroy(id);
+
+        return;
+    }
+
+    patch_set_lower_note(id, 0);
+    patch_set_upper_note(id, 127);
+    patch_set_root_note(id, ROOT_NOTE);
+    patch_set_play_mode(id, PATCH_PLAY_LOOP);
+
+    for (e = 0; e < sizeof(events) / sizeof(*events); ++e)
+    {
+        mb.events = events[e];
+        mb.note = 0;
+        snprintf(name, sizeof(name), "mixer_mixdown/%d", events[e]);
+        bench(name, "ns/frame", 0, run_mixdown, &mb);
+    }
+
+    patch_destroy(id);
+}
+
+
+/**************************************************************************
+ *  loading
+ */
+
+typedef struct _LoadBench
+{
+    const char*     path;
+    SampleQuality   quality;
+    int             frames;
+
+} LoadBench;
+
+
+static double run_load(void* data)
+{
+    LoadBench* lb = data;
+    Sample* s = sample_new();
+
+    if (!s)
+        return 0;
+
+    if (sample_load_file(s, lb->path, rate, 0, 0, 0, 1, lb->quality) < 0)
+    {
+        sample_free(s);
+        return 0;
+    }
+
+    sample_free(s);
+
+    return lb->frames;
+}
+
+
+static void bench_load(const char* native, const char* other,
+                                                    int other_rate)
+{
+    LoadBench lb;
+
+    lb.path = native;
+    lb.quality = SAMPLE_QUALITY_BEST;
+    lb.frames = rate * SAMPLE_SECS;
+    bench("sample_load_file/native", "ns/frame", 0, run_load, &lb);
+
+    lb.path = other;
+    lb.frames = other_rate * SAMPLE_SECS;
+    bench("sample_load_file/resample-best", "ns/frame", 0, run_load, &lb);
+
+    lb.quality = SAMPLE_QUALITY_FAST;
+    bench("sample_load_file/resample-fast", "ns/frame", 0, run_load, &lb);
+}
+
+
+/**************************************************************************
+ *  baselines
+ */
+
+static int results_save(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    int i;
+
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(f, "# petri-foo-bench, %d Hz, %d frames\n", rate, period);
+
+    for (i = 0; i < nresults; ++i)
+        fprintf(f, "%s %.6f %s\n", results[i].name, results[i].ns,
+                                                    results[i].unit);
+
+    fclose(f);
+
+    return 0;
+}
+
+
+/* returns the number of results slower than the baseline by threshold */
+static int results_compare(const char* path, double threshold)
+{
+    FILE* f = fopen(path, "r");
+    char line[256];
+    char name[64];
+    double ns;
+    int slower = 0;
+    int i;
+
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+
+    printf("\ncompared with %s:\n", path);
+
+    while (fgets(line, sizeof(line), f))
+    {
+        if (line[0] == '#' || sscanf(line, "%63s %lf", name, &ns) != 2)
+            continue;
+
+        for (i = 0; i < nresults; ++i)
+        {
+            double change;
+
+            if (strcmp(results[i].name, name) != 0 || ns <= 0)
+                continue;
+
+            change = (results[i].ns - ns) / ns * 100.0;
+
+            printf("%-36s %12.3f -> %12.3f %+7.1f%%%s\n", name, ns,
+                        results[i].ns, change,
+                        change > threshold ? "  SLOWER" : "");
+
+            if (change > threshold)
+                ++slower;
+        }
+    }
+
+    fclose(f);
+
+    return slower;
+}
+
+
+/**************************************************************************
+ *  main
+ */
+
+static void show_usage(void)
+{
+    printf("Usage: petri-foo-bench [options] [filter]\n");
+    printf("(only benchmarks whose names contain filter are run)\n\n");
+
+    printf("Options:\n");
+    printf("  -r, --rate <hz>           Sample rate, defaults to %d\n",
+                                                        DEFAULT_RATE);
+    printf("  -p, --period <frames>     Period size, defaults to %d\n",
+                                                        DEFAULT_PERIOD);
+    printf("  -t, --time <seconds>      Minimum time per repetition, "
+                                        "defaults to %.2f\n", min_time);
+    printf("  -s, --save <file>         Save the results as a baseline\n");
+    printf("  -c, --compare <file>      Compare the results with a "
+                                        "saved baseline\n");
+    printf("  -T, --threshold <percent> Slow down counted as a "
+                                        "regression, defaults to 10\n");
+    printf("  -h, --help                Display this help message\n\n");
+    printf("Exits with status 2 if any result regressed.\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct option opts[] = {
+        { "rate",       required_argument,  0,  'r' },
+        { "period",     required_argument,  0,  'p' },
+        { "time",       required_argument,  0,  't' },
+        { "save",       required_argument,  0,  's' },
+        { "compare",    required_argument,  0,  'c' },
+        { "threshold",  required_argument,  0,  'T' },
+        { "help",       no_argument,        0,  'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    const char* save = 0;
+    const char* compare = 0;
+    double threshold = 10.0;
+    char* native = 0;
+    char* other = 0;
+    int other_rate;
+    int opt;
+    int ret = 1;
+
+    while ((opt = getopt_long(argc, argv, "r:p:t:s:c:T:h", opts, 0)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':   rate = atoi(optarg);        break;
+        case 'p':   period = atoi(optarg);      break;
+        case 't':   min_time = atof(optarg);    break;
+        case 's':   save = optarg;              break;
+        case 'c':   compare = optarg;           break;
+        case 'T':   threshold = atof(optarg);   break;
+        case 'h':   show_usage();               return 0;
+        default:    show_usage();               return 1;
+        }
+    }
+
+    if (optind < argc)
+        filter = argv[optind];
+
+    if (rate <= 0 || period <= 0 || min_time <= 0)
+    {
+        show_usage();
+        return 1;
+    }
+
+    other_rate = (rate == 44100) ? 48000 : 44100;
+
+    if (!(native = headless_test_sample(rate, SAMPLE_SECS))
+     || !(other = headless_test_sample(other_rate, SAMPLE_SECS)))
+    {
+        fprintf(stderr, "failed to write test samples\n");
+        goto done;
+    }
+
+    if (!(buf = malloc(sizeof(float) * period * 2)))
+        goto done;
+
+    bus.left = buf;
+    bus.right = buf + period;
+
+    if (headless_init(rate, period) < 0)
+    {
+        fprintf(stderr, "failed to start the offline driver\n");
+        goto shutdown;
+    }
+
+    printf("%d Hz, %d frames per period\n\n", rate, period);
+
+    bench_kernels();
+    bench_voices(native);
+    bench_mixdown(native);
+    bench_load(native, other, other_rate);
+
+    ret = 0;
+
+    if (save && results_save(save) < 0)
+        ret = 1;
+
+    if (compare)
+    {
+        int slower = results_compare(compare, threshold);
+
+        if (slower < 0)
+            ret = 1;
+        else if (slower > 0)
+            ret = 2;
+    }
+
+shutdown:
+    headless_shutdown();
+
+done:
+    free(buf);
+
+    if (native)
+        unlink(native);
+
+    if (other)
+        unlink(other);
+
+    free(native);
+    free(other);
+
+    return ret;
+}
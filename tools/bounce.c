@@ -0,0 +1,224 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*  petri-foo-bounce
+        renders a MIDI file through a bank straight to a sound file,
+        as fast as the machine allows and without JACK.
+ */
+
+
+#include <getopt.h>
+#include <sndfile.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "headless.h"
+#include "offlinedriver.h"
+#include "smf.h"
+
+
+enum {
+    DEFAULT_RATE =      44100,
+    DEFAULT_PERIOD =    256
+};
+
+
+static void show_usage(void)
+{
+    printf("Usage: petri-foo-bounce [options] bank midi-file output\n");
+    printf("(output format is chosen by extension: .wav or .flac)\n\n");
+
+    printf("Options:\n");
+    printf("  -r, --rate <hz>           Sample rate, defaults to %d\n",
+                                                        DEFAULT_RATE);
+    printf("  -p, --period <frames>     Frames rendered at a time, "
+                                        "defaults to %d\n", DEFAULT_PERIOD);
+    printf("  -t, --tail <seconds>      Time to let notes ring after "
+                                        "the last event, defaults to 2\n");
+    printf("  -h, --help                Display this help message\n");
+}
+
+
+static int output_format(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+
+    if (!ext)
+        return 0;
+
+    if (strcasecmp(ext, ".wav") == 0)
+        return SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+
+    if (strcasecmp(ext, ".flac") == 0)
+        return SF_FORMAT_FLAC | SF_FORMAT_PCM_24;
+
+    return 0;
+}
+
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static int bounce(SmfEvent* events, int count, SNDFILE* out,
+                                    int rate, int period, double tail)
+{
+    long long total;
+    long long done = 0;
+    Tick frame;
+    const float* buf;
+    int e = 0;
+    int n;
+
+    total = (long long)(((count ? events[count - 1].time : 0.0) + tail)
+                                                                * rate);
+
+    while (done < total)
+    {
+        frame = offline_driver_get_frame();
+
+        for (; e < count; ++e)
+        {
+            long long at = (long long)(events[e].time * rate);
+
+            if (at >= (long long)frame + period)
+                break;
+
+            headless_midi(events[e].data,
+                                at > (long long)frame ? at - frame : 0);
+        }
+
+        if (!(buf = offline_driver_render()))
+            return -1;
+
+        n = (total - done < period) ? (int)(total - done) : period;
+
+        if (sf_writef_float(out, buf, n) != n)
+        {
+            fprintf(stderr, "write failed: %s\n", sf_strerror(out));
+            return -1;
+        }
+
+        done += n;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct option opts[] = {
+        { "rate",   required_argument,  0,  'r' },
+        { "period", required_argument,  0,  'p' },
+        { "tail",   required_argument,  0,  't' },
+        { "help",   no_argument,        0,  'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    int rate = DEFAULT_RATE;
+    int period = DEFAULT_PERIOD;
+    double tail = 2.0;
+    int opt;
+    int count;
+    int ret = 1;
+    const char* err;
+    SmfEvent* events;
+    SNDFILE* out;
+    SF_INFO info;
+    double t0;
+
+    while ((opt = getopt_long(argc, argv, "r:p:t:h", opts, 0)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':   rate = atoi(optarg);    break;
+        case 'p':   period = atoi(optarg);  break;
+        case 't':   tail = atof(optarg);    break;
+        case 'h':   show_usage();           return 0;
+        default:    show_usage();           return 1;
+        }
+    }
+
+    if (argc - optind != 3 || rate <= 0 || period <= 0 || tail < 0)
+    {
+        show_usage();
+        return 1;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.samplerate = rate;
+    info.channels = 2;
+
+    if (!(info.format = output_format(argv[optind + 2])))
+    {
+        fprintf(stderr, "unknown output format: %s\n", argv[optind + 2]);
+        return 1;
+    }
+
+    if (!(events = smf_read(argv[optind + 1], &count, &err)))
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind + 1], err);
+        return 1;
+    }
+
+    if (headless_init(rate, period) < 0)
+    {
+        fprintf(stderr, "failed to start the offline driver\n");
+        goto done;
+    }
+
+    if (headless_load_bank(argv[optind]) < 0)
+    {
+        fprintf(stderr, "failed to load bank %s\n", argv[optind]);
+        goto done;
+    }
+
+    if (!(out = sf_open(argv[optind + 2], SFM_WRITE, &info)))
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind + 2], sf_strerror(0));
+        goto done;
+    }
+
+    t0 = now_s();
+
+    if (bounce(events, count, out, rate, period, tail) == 0)
+    {
+        double secs = now_s() - t0;
+        double len = (double)offline_driver_get_frame() / rate;
+
+        printf("rendered %.1fs in %.1fs (%.1fx realtime)\n",
+                            len, secs, secs > 0 ? len / secs : 0.0);
+        ret = 0;
+    }
+
+    sf_close(out);
+
+done:
+    headless_shutdown();
+    smf_free(events);
+
+    return ret;
+}
@@ -0,0 +1,623 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*  petri-foo-daemon: the engine without the GUI. plays a bank through
+    JACK and is controlled by OSC messages sent to it from the same
+    machine (the socket is bound to 127.0.0.1). every message is
+    answered, to the address and port it came from:
+
+    /petri-foo/bank/load s          read the bank at the path
+    /petri-foo/bank/save [s]        write the bank (to the path)
+    /petri-foo/patch/list           a /petri-foo/patch isii (id, name,
+                                    channel, root note) for each patch
+    /petri-foo/patch/set isf        set a parameter of patch id
+    /petri-foo/patch/get is         a /petri-foo/patch/value isf
+    /petri-foo/stats                a /petri-foo/stats ffiiis (load,
+                                    load peak, voices, voices peak,
+                                    xruns, and a summary)
+    /petri-foo/stats/reset          reset the peaks
+    /petri-foo/quit
+
+    the others get a /petri-foo/reply si: the path of the message and
+    0 on success, -1 on failure.
+ */
+
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <lo/lo.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dish_file.h"
+#include "driver.h"
+#include "gc.h"
+#include "instance.h"
+#include "jackdriver.h"
+#include "lfo.h"
+#include "midi.h"
+#include "mixer.h"
+#include "mod_src.h"
+#include "msg_log.h"
+#include "patch_set_and_get.h"
+#include "patch_util.h"
+#include "petri-foo.h"
+#include "rtlog.h"
+#include "sample.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "worker.h"
+
+
+#define DAEMON_DEFAULT_PORT "7770"
+
+
+/* the patch parameters which may be set, and their ranges */
+static const struct
+{
+    const char*     name;
+    PatchParamType  param;
+    float           min;
+    float           max;
+
+} params[] =
+{
+    { "amplitude",  PATCH_PARAM_AMPLITUDE,   0.0, 1.0 },
+    { "pan",        PATCH_PARAM_PANNING,    -1.0, 1.0 },
+    { "pitch",      PATCH_PARAM_PITCH,      -1.0, 1.0 },
+    { "cutoff",     PATCH_PARAM_CUTOFF,      0.0, 1.0 },
+    { "resonance",  PATCH_PARAM_RESONANCE,   0.0, 1.0 },
+    { 0,            PATCH_PARAM_INVALID,     0.0, 0.0 }
+};
+
+
+static volatile sig_atomic_t quit = 0;
+static lo_server server = 0;
+
+
+static void show_usage(void)
+{
+    printf("Usage: petri-foo-daemon [options] [bank]\n\n");
+
+    printf("Options:\n");
+    printf("  -a, --autoconnect         Auto-connect through JACK to "
+                                        "system playback ports\n");
+    printf("  -j, --jack-name <name>    Specify JACK client name, "
+                                        "defaults to \"Petri-Foo\"\n");
+    printf("  -k, --keep-source         Keep resampled samples' file "
+                                        "data in memory, for quicker "
+                                        "sample rate changes\n");
+    printf("  -l, --lazy                Load samples in the background, "
+                                        "playing patches as they load\n");
+    printf("  -m, --memory <MB>         Keep no more than <MB> of "
+                                        "samples in memory, reloading "
+                                        "them when played\n");
+    printf("  -n, --native-rate         Play samples at their own rate "
+                                        "instead of resampling them\n");
+    printf("  -o, --outputs <n>         Number of stereo JACK outputs "
+                                        "patches may be sent to\n");
+    printf("  -p, --port <port>         UDP port on 127.0.0.1 to take "
+                                        "OSC messages on, defaults to "
+                                        DAEMON_DEFAULT_PORT "\n");
+    printf("  -s, --stats <seconds>     Print engine load and voice "
+                                        "counts every <seconds>\n");
+    printf("  -t, --trace <file>        Record what the engine does to "
+                                        "a Chrome trace file\n");
+    printf("  -h, --help                Display this help message\n");
+}
+
+
+static void quit_handler(int sig)
+{
+    (void)sig;
+    quit = 1;
+}
+
+
+static bool patch_exists(int id)
+{
+    int* ids;
+    int count = patch_dump(&ids);
+    int i;
+
+    for (i = 0; i < count; ++i)
+        if (ids[i] == id)
+            break;
+
+    free(ids);
+
+    return i < count;
+}
+
+
+static int param_index(const char* name)
+{
+    int i;
+
+    for (i = 0; params[i].name; ++i)
+        if (strcmp(params[i].name, name) == 0)
+            return i;
+
+    return -1;
+}
+
+
+static void reply(lo_message msg, const char* path, int result)
+{
+    lo_send_from(lo_message_get_source(msg), server, LO_TT_IMMEDIATE,
+                        "/petri-foo/reply", "si", path, result);
+}
+
+
+/*  the socket is bound to the loopback address (see server_start),
+    this is in case it ever isn't */
+static int local_only_cb(const char* path, const char* types,
+                         lo_arg** argv, int argc, lo_message msg,
+                         void* data)
+{
+    const char* host = lo_address_get_hostname(lo_message_get_source(msg));
+
+    (void)types;
+    (void)argv;
+    (void)argc;
+    (void)data;
+
+    if (host && (strncmp(host, "127.", 4) == 0
+              || strcmp(host, "::1") == 0
+              || strncmp(host, "::ffff:127.", 11) == 0))
+        return 1;   /* on to the real handler */
+
+    msg_log(MSG_WARNING, "Ignoring %s from %s\n", path,
+                                            host ? host : "unknown host");
+    return 0;
+}
+
+
+static int bank_load_cb(const char* path, const char* types,
+                        lo_arg** argv, int argc, lo_message msg,
+                        void* data)
+{
+    int ret;
+
+    (void)types;
+    (void)argc;
+    (void)data;
+
+    if ((ret = dish_file_read(&argv[0]->s)) < 0)
+        msg_log(MSG_ERROR, "Failed to load bank '%s'\n", &argv[0]->s);
+    else
+        msg_log(MSG_MESSAGE, "Loaded bank '%s'\n", &argv[0]->s);
+
+    reply(msg, path, ret < 0 ? -1 : 0);
+
+    return 0;
+}
+
+
+static int bank_save_cb(const char* path, const char* types,
+                        lo_arg** argv, int argc, lo_message msg,
+                        void* data)
+{
+    int ret = -1;
+
+    (void)types;
+    (void)data;
+
+    if (argc > 0)
+        ret = dish_file_write_basic(&argv[0]->s);
+    else if (dish_file_has_state())
+        ret = dish_file_write();
+    else
+        msg_log(MSG_ERROR, "No bank to save to, give a path\n");
+
+    reply(msg, path, ret < 0 ? -1 : 0);
+
+    return 0;
+}
+
+
+static int patch_list_cb(const char* path, const char* types,
+                         lo_arg** argv, int argc, lo_message msg,
+                         void* data)
+{
+    int* ids;
+    int count = patch_dump(&ids);
+    int i;
+
+    (void)path;
+    (void)types;
+    (void)argv;
+    (void)argc;
+    (void)data;
+
+    for (i = 0; i < count; ++i)
+        lo_send_from(lo_message_get_source(msg), server, LO_TT_IMMEDIATE,
+                        "/petri-foo/patch", "isii", ids[i],
+                        patch_get_name(ids[i]),
+                        patch_get_channel(ids[i]),
+                        patch_get_root_note(ids[i]));
+    free(ids);
+
+    return 0;
+}
+
+
+static int patch_set_cb(const char* path, const char* types,
+                        lo_arg** argv, int argc, lo_message msg,
+                        void* data)
+{
+    int id = argv[0]->i;
+    int p = param_index(&argv[1]->s);
+    float val = argv[2]->f;
+
+    (void)types;
+    (void)argc;
+    (void)data;
+
+    if (p < 0 || !patch_exists(id))
+    {
+        reply(msg, path, -1);
+        return 0;
+    }
+
+    if (val < params[p].min)
+        val = params[p].min;
+    else if (val > params[p].max)
+        val = params[p].max;
+
+    patch_param_set_value(id, params[p].param, val);
+    reply(msg, path, 0);
+
+    return 0;
+}
+
+
+static int patch_get_cb(const char* path, const char* types,
+                        lo_arg** argv, int argc, lo_message msg,
+                        void* data)
+{
+    int id = argv[0]->i;
+    int p = param_index(&argv[1]->s);
+
+    (void)types;
+    (void)argc;
+    (void)data;
+
+    if (p < 0 || !patch_exists(id))
+    {
+        reply(msg, path, -1);
+        return 0;
+    }
+
+    lo_send_from(lo_message_get_source(msg), server, LO_TT_IMMEDIATE,
+                        "/petri-foo/patch/value", "isf", id,
+                        params[p].name,
+                        patch_param_get_value(id, params[p].param));
+    return 0;
+}
+
+
+static int stats_cb(const char* path, const char* types,
+                    lo_arg** argv, int argc, lo_message msg, void* data)
+{
+    Telemetry t;
+    char buf[256];
+
+    (void)path;
+    (void)types;
+    (void)argv;
+    (void)argc;
+    (void)data;
+
+    telemetry_get(engine_default(), &t);
+    telemetry_format(buf, sizeof(buf), &t);
+
+    lo_send_from(lo_message_get_source(msg), server, LO_TT_IMMEDIATE,
+                        "/petri-foo/stats", "ffiiis",
+                        t.load, t.load_peak, t.voices, t.voices_peak,
+                        (int)t.xruns, buf);
+    return 0;
+}
+
+
+static int stats_reset_cb(const char* path, const char* types,
+                          lo_arg** argv, int argc, lo_message msg,
+                          void* data)
+{
+    (void)types;
+    (void)argv;
+    (void)argc;
+    (void)data;
+
+    telemetry_reset_peaks(engine_default());
+    reply(msg, path, 0);
+
+    return 0;
+}
+
+
+static int quit_cb(const char* path, const char* types, lo_arg** argv,
+                   int argc, lo_message msg, void* data)
+{
+    (void)types;
+    (void)argv;
+    (void)argc;
+    (void)data;
+
+    msg_log(MSG_MESSAGE, "Told to quit\n");
+    reply(msg, path, 0);
+    quit = 1;
+
+    return 0;
+}
+
+
+static void server_error_cb(int num, const char* msg, const char* path)
+{
+    msg_log(MSG_ERROR, "OSC server error %d in path %s: %s\n",
+                                    num, path ? path : "-", msg);
+}
+
+
+/*  liblo binds its servers to every interface, so the server is made
+    on whatever port is free and its socket replaced by one bound to
+    the loopback address, at the port asked for. liblo never sees the
+    difference: it is still reading and answering on the same fd. */
+static int server_start(const char* port)
+{
+    struct sockaddr_in addr;
+    long n = strtol(port, 0, 10);
+    int fd;
+
+    if (n <= 0 || n > 65535)
+        return -1;
+
+    if (!(server = lo_server_new(0, server_error_cb)))
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(n);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0
+     || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+     || dup2(fd, lo_server_get_socket_fd(server)) < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+
+        lo_server_free(server);
+        server = 0;
+        return -1;
+    }
+
+    close(fd);
+
+    lo_server_add_method(server, 0, 0, local_only_cb, 0);
+
+    lo_server_add_method(server, "/petri-foo/bank/load", "s",
+                                                    bank_load_cb, 0);
+    lo_server_add_method(server, "/petri-foo/bank/save", "s",
+                                                    bank_save_cb, 0);
+    lo_server_add_method(server, "/petri-foo/bank/save", "",
+                                                    bank_save_cb, 0);
+    lo_server_add_method(server, "/petri-foo/patch/list", "",
+                                                    patch_list_cb, 0);
+    lo_server_add_method(server, "/petri-foo/patch/set", "isf",
+                                                    patch_set_cb, 0);
+    lo_server_add_method(server, "/petri-foo/patch/get", "is",
+                                                    patch_get_cb, 0);
+    lo_server_add_method(server, "/petri-foo/stats", "",
+                                                    stats_cb, 0);
+    lo_server_add_method(server, "/petri-foo/stats/reset", "",
+                                                    stats_reset_cb, 0);
+    lo_server_add_method(server, "/petri-foo/quit", "",
+                                                    quit_cb, 0);
+    return 0;
+}
+
+
+static void print_stats(void)
+{
+    Telemetry t;
+    char buf[256];
+
+    telemetry_get(engine_default(), &t);
+    telemetry_reset_peaks(engine_default());
+    telemetry_format(buf, sizeof(buf), &t);
+    printf("%s\n", buf);
+    fflush(stdout);
+}
+
+
+int main(int argc, char* argv[])
+{
+    const char* port = DAEMON_DEFAULT_PORT;
+    const char* bank = 0;
+    int stats = 0;
+    time_t next_stats = 0;
+    struct sigaction sa;
+    int opt;
+
+    static struct option opts[] =
+    {
+        { "autoconnect",    0, 0, 'a'},
+        { "jack-name",      1, 0, 'j'},
+        { "keep-source",    0, 0, 'k'},
+        { "lazy",           0, 0, 'l'},
+        { "memory",         1, 0, 'm'},
+        { "native-rate",    0, 0, 'n'},
+        { "outputs",        1, 0, 'o'},
+        { "port",           1, 0, 'p'},
+        { "stats",          1, 0, 's'},
+        { "trace",          1, 0, 't'},
+        { "help",           0, 0, 'h'},
+        { 0, 0, 0, 0}
+    };
+
+    mod_src_create();
+    jackdriver_register();
+    driver_init();
+    lfo_tables_init();
+    mixer_init();
+    worker_init(0);
+    gc_init();
+    patch_control_init();
+    dish_file_state_init();
+    rtlog_set_sink(msg_log_rtlog_sink);
+
+    while ((opt = getopt_long(argc, argv, "aj:klm:no:p:s:t:h", opts, 0)) > 0)
+    {
+        switch (opt)
+        {
+        case 'a':
+            jackdriver_set_autoconnect(true);
+            break;
+
+        case 'j':
+            set_instance_name(optarg);
+            break;
+
+        case 'k':
+            sample_set_keep_source(true);
+            break;
+
+        case 'l':
+            dish_file_set_lazy(true);
+            break;
+
+        case 'm':
+            patch_set_sample_budget((unsigned long)atol(optarg) << 20);
+            break;
+
+        case 'n':
+            patch_set_native_rate(true);
+            break;
+
+        case 'o':
+            if (atoi(optarg) >= 1 && atoi(optarg) <= MIXER_MAX_BUSES)
+                mixer_set_buses(atoi(optarg));
+            else
+                msg_log(MSG_WARNING, "Ignoring --outputs option, "
+                                "must be 1 to %d\n", MIXER_MAX_BUSES);
+            break;
+
+        case 'p':
+            port = optarg;
+            break;
+
+        case 's':
+            stats = atoi(optarg);
+            break;
+
+        case 't':
+            if (trace_start(optarg) < 0)
+                msg_log(MSG_ERROR, "Failed to open trace file '%s'\n",
+                                                                optarg);
+            break;
+
+        case 'h':
+            show_usage();
+            return 0;
+
+        default:
+            show_usage();
+            return 1;
+        }
+    }
+
+    if (optind < argc)
+        bank = argv[optind];
+
+    if (server_start(port) < 0)
+    {
+        msg_log(MSG_ERROR, "Failed to take OSC messages on port %s\n",
+                                                                port);
+        return 1;
+    }
+
+    /* nothing the session managers do, just the one bank */
+    jackdriver_disable_jacksession();
+
+    if (driver_start() < 0)
+    {
+        msg_log(MSG_ERROR, "Failed to start the JACK driver\n");
+        lo_server_free(server);
+        return 1;
+    }
+
+    midi_start();
+
+    if (!bank || dish_file_read(bank) < 0)
+        patch_create_default();
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = quit_handler;
+    sigfillset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGHUP, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+
+    msg_log(MSG_MESSAGE, "Taking OSC messages on port %s\n", port);
+
+    while (!quit)
+    {
+        lo_server_recv_noblock(server, 100);
+
+        /* the engine's messages are passed on from here */
+        rtlog_dispatch();
+
+        /* and the samples of a lazily loaded bank installed, and
+           those in memory kept to the budget */
+        dish_file_poll();
+        patch_sample_budget_poll();
+
+        if (stats > 0 && time(0) >= next_stats)
+        {
+            if (next_stats)
+                print_stats();
+
+            next_stats = time(0) + stats;
+        }
+    }
+
+    msg_log(MSG_MESSAGE, "Cleanup...\n");
+
+    lo_server_free(server);
+    dish_file_state_cleanup();
+    midi_stop();
+    driver_stop();
+    worker_shutdown();
+    rtlog_dispatch();
+    trace_stop();
+    gc_shutdown();
+    patch_shutdown();
+    mixer_shutdown();
+    free_instance_name();
+    mod_src_destroy();
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "headless.h"
+
+#include <math.h>
+#include <sndfile.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dish_file.h"
+#include "driver.h"
+#include "gc.h"
+#include "instance.h"
+#include "lfo.h"
+#include "midi_control.h"
+#include "mixer.h"
+#include "mod_src.h"
+#include "offlinedriver.h"
+#include "patch.h"
+#include "patch_util.h"
+#include "rtlog.h"
+#include "trace.h"
+#include "worker.h"
+
+
+MIDI_CONTROL_H__CC_MAP_DEF
+
+
+int headless_init(int rate, int periodsize)
+{
+    mod_src_create();
+    driver_init();
+    lfo_tables_init();
+    mixer_init();
+    worker_init(0);
+    gc_init();
+    patch_control_init();
+    dish_file_state_init();
+    rtlog_start();
+
+    /* nothing is played live, so there is no reason to skimp */
+    patch_set_fast_resample(false);
+
+    offline_driver_set_format(rate, periodsize);
+    trace_thread_name("audio");
+
+    return driver_start_named("offline");
+}
+
+
+void headless_shutdown(void)
+{
+    dish_file_state_cleanup();
+    driver_stop();
+    worker_shutdown();
+    rtlog_stop();
+    trace_stop();
+    gc_shutdown();
+    patch_shutdown();
+    mixer_shutdown();
+    free_instance_name();
+    mod_src_destroy();
+}
+
+
+int headless_load_bank(const char* path)
+{
+    return dish_file_read(path);
+}
+
+
+char* headless_test_sample(int rate, int secs)
+{
+    SF_INFO info;
+    SNDFILE* f;
+    float frame[2];
+    char* path;
+    int fd;
+    int i;
+
+    if (!(path = strdup("/tmp/petri-foo-XXXXXX")))
+        return 0;
+
+    if ((fd = mkstemp(path)) < 0)
+    {
+        free(path);
+        return 0;
+    }
+
+    close(fd);
+
+    memset(&info, 0, sizeof(info));
+    info.samplerate = rate;
+    info.channels = 2;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+
+    if (!(f = sf_open(path, SFM_WRITE, &info)))
+    {
+        unlink(path);
+        free(path);
+        return 0;
+    }
+
+    for (i = 0; i < rate * secs; ++i)
+    {
+        frame[0] = frame[1] = 0.5 * sin(2 * M_PI * 440.0 * i / rate);
+        sf_writef_float(f, frame, 1);
+    }
+
+    sf_close(f);
+
+    return path;
+}
+
+
+void headless_midi(const unsigned char* data, Tick offset)
+{
+    int chan = data[0] & 0x0F;
+
+    switch (data[0] & 0xF0)
+    {
+    case 0x80:
+        mixer_direct_note_off(chan, data[1], offset);
+        break;
+
+    case 0x90:
+        if (data[2] == 0)
+            mixer_direct_note_off(chan, data[1], offset);
+        else
+            mixer_direct_note_on(chan, data[1], data[2] / 127.0, offset);
+        break;
+
+    case 0xB0:
+        mixer_direct_control(chan, data[1], cc_map(data[1], data[2]),
+                                                                offset);
+        break;
+
+    case 0xE0:
+        mixer_direct_control(chan, CC_PITCH_WHEEL,
+                        -1.0 + ((data[2] << 7) | data[1]) / 8192.0, offset);
+        break;
+
+    default:
+        break;
+    }
+}
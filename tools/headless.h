@@ -0,0 +1,51 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __HEADLESS_H__
+#define __HEADLESS_H__
+
+
+#include "ticks.h"
+
+
+/*  headless
+        brings the engine up (and down again) on the offline driver,
+        for the command line tools. the thread calling headless_init
+        is then the audio thread, see offlinedriver.h
+ */
+
+
+int     headless_init(int rate, int periodsize);
+void    headless_shutdown(void);
+
+
+/* loads a bank, returns -1 on failure */
+int     headless_load_bank(const char* path);
+
+
+/*  writes a stereo sine of secs seconds at rate to a new temporary
+    file, returning its path (to be unlinked and freed) or NULL */
+char*   headless_test_sample(int rate, int secs);
+
+
+/*  passes a MIDI channel message (as read from a MIDI file or port)
+    to the mixer, to be played offset frames into the next period */
+void    headless_midi(const unsigned char* data, Tick offset);
+
+
+#endif /* __HEADLESS_H__ */
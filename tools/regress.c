@@ -0,0 +1,578 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*  petri-foo-regress
+        renders a scripted case on the offline driver and compares the
+        output with the case's golden file, either exactly or to within
+        a tolerance given in dB (of the largest difference, relative to
+        full scale).
+
+        a case is a text file:
+
+            # comments and blank lines are ignored
+            bank        basic.petri-foo     (relative to the case)
+            rate        48000
+            period      64
+            length      2.5                 (seconds rendered)
+            tolerance   -120                (dB, omit for exact)
+
+            0.0     on      0 60 100        (time, channel, note, vel)
+            0.5     off     0 60
+            0.25    cc      0 1 64          (time, channel, param, val)
+            0.75    bend    0 4096          (time, channel, -8192..8191)
+
+        events may be in any order. the golden file is the case's name
+        with .test replaced by .wav, and is written by --record.
+
+        --check needs no golden file: it only makes sure the render is
+        sane, every sample a finite number and not all of them silent.
+ */
+
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <sndfile.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file_ops.h"
+#include "headless.h"
+#include "offlinedriver.h"
+
+
+enum {
+    DEFAULT_RATE =      48000,
+    DEFAULT_PERIOD =    64,
+    MAX_EVENTS =        4096,
+    MAX_LINE =          256
+};
+
+
+typedef struct _CaseEvent
+{
+    long            frame;
+    long            order;
+    unsigned char   data[3];
+
+} CaseEvent;
+
+
+typedef struct _Case
+{
+    char*       bank;
+    int         rate;
+    int         period;
+    double      length;
+    bool        exact;
+    double      tolerance;
+
+    CaseEvent   events[MAX_EVENTS];
+    int         count;
+
+} Case;
+
+
+static int clamp7(int n)
+{
+    return n < 0 ? 0 : (n > 127 ? 127 : n);
+}
+
+
+/* parses one event line, returns -1 if it is not one */
+static int case_event(Case* c, const char* line)
+{
+    CaseEvent* ev;
+    double t;
+    char type[16];
+    int chan, a, b = 0;
+    int n;
+
+    n = sscanf(line, "%lf %15s %d %d %d", &t, type, &chan, &a, &b);
+
+    if (n < 4 || t < 0 || chan < 0 || chan > 15 || c->count == MAX_EVENTS)
+        return -1;
+
+    ev = &c->events[c->count];
+    ev->frame = (long)(t * c->rate + 0.5);
+    ev->order = c->count;
+
+    if (strcmp(type, "on") == 0 && n == 5)
+    {
+        ev->data[0] = 0x90 | chan;
+        ev->data[1] = clamp7(a);
+        ev->data[2] = clamp7(b);
+    }
+    else if (strcmp(type, "off") == 0)
+    {
+        ev->data[0] = 0x80 | chan;
+        ev->data[1] = clamp7(a);
+        ev->data[2] = 0;
+    }
+    else if (strcmp(type, "cc") == 0 && n == 5)
+    {
+        ev->data[0] = 0xB0 | chan;
+        ev->data[1] = clamp7(a);
+        ev->data[2] = clamp7(b);
+    }
+    else if (strcmp(type, "bend") == 0)
+    {
+        a = (a < -8192 ? -8192 : (a > 8191 ? 8191 : a)) + 8192;
+        ev->data[0] = 0xE0 | chan;
+        ev->data[1] = a & 0x7f;
+        ev->data[2] = a >> 7;
+    }
+    else
+        return -1;
+
+    ++c->count;
+
+    return 0;
+}
+
+
+static int event_cmp(const void* a, const void* b)
+{
+    const CaseEvent* x = a;
+    const CaseEvent* y = b;
+
+    if (x->frame != y->frame)
+        return x->frame < y->frame ? -1 : 1;
+
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+
+static int case_read(Case* c, const char* path)
+{
+    FILE* f;
+    char line[MAX_LINE];
+    char word[MAX_LINE];
+    char arg[MAX_LINE];
+    char* dir;
+    int lineno = 0;
+    int ret = 0;
+
+    memset(c, 0, sizeof(*c));
+    c->rate = DEFAULT_RATE;
+    c->period = DEFAULT_PERIOD;
+    c->exact = true;
+
+    if (!(f = fopen(path, "r")))
+    {
+        perror(path);
+        return -1;
+    }
+
+    dir = file_ops_parent_dir(path);
+
+    while (ret == 0 && fgets(line, sizeof(line), f))
+    {
+        char* p = line + strspn(line, " \t");
+
+        ++lineno;
+
+        if (*p == '#' || *p == '\n' || *p == '\0')
+            continue;
+
+        if (sscanf(p, "%255s %255s", word, arg) != 2)
+            ret = -1;
+        else if (strcmp(word, "bank") == 0)
+        {
+            free(c->bank);
+            c->bank = (arg[0] == '/' || !dir) ? strdup(arg)
+                                       : file_ops_join_path(dir, arg);
+        }
+        else if (strcmp(word, "rate") == 0)
+            c->rate = atoi(arg);
+        else if (strcmp(word, "period") == 0)
+            c->period = atoi(arg);
+        else if (strcmp(word, "length") == 0)
+            c->length = atof(arg);
+        else if (strcmp(word, "tolerance") == 0)
+        {
+            c->exact = false;
+            c->tolerance = atof(arg);
+        }
+        else if (case_event(c, p) < 0)
+            ret = -1;
+
+        if (ret < 0)
+            fprintf(stderr, "%s:%d: cannot parse: %s", path, lineno, line);
+    }
+
+    fclose(f);
+    free(dir);
+
+    if (ret == 0 && (!c->bank || c->rate <= 0 || c->period <= 0
+                              || c->length <= 0))
+    {
+        fprintf(stderr, "%s: needs a bank, and a length, rate and "
+                        "period greater than zero\n", path);
+        ret = -1;
+    }
+
+    qsort(c->events, c->count, sizeof(*c->events), event_cmp);
+
+    return ret;
+}
+
+
+/* renders the case into a newly allocated buffer of *frames frames */
+static float* case_render(const Case* c, long* frames)
+{
+    float* out;
+    const float* buf;
+    long total = (long)(c->length * c->rate);
+    long done = 0;
+    long frame;
+    int e = 0;
+    int n;
+
+    if (!(out = malloc(sizeof(float) * total * 2)))
+        return 0;
+
+    while (done < total)
+    {
+        frame = offline_driver_get_frame();
+
+        for (; e < c->count && c->events[e].frame < frame + c->period; ++e)
+            headless_midi(c->events[e].data, c->events[e].frame - frame);
+
+        if (!(buf = offline_driver_render()))
+        {
+            free(out);
+            return 0;
+        }
+
+        n = (total - done < c->period) ? total - done : c->period;
+        memcpy(out + done * 2, buf, sizeof(float) * n * 2);
+        done += n;
+    }
+
+    *frames = total;
+
+    return out;
+}
+
+
+static int wav_write(const char* path, const float* data, long frames,
+                                                                int rate)
+{
+    SF_INFO info;
+    SNDFILE* f;
+
+    memset(&info, 0, sizeof(info));
+    info.samplerate = rate;
+    info.channels = 2;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+
+    if (!(f = sf_open(path, SFM_WRITE, &info)))
+    {
+        fprintf(stderr, "%s: %s\n", path, sf_strerror(0));
+        return -1;
+    }
+
+    if (sf_writef_float(f, data, frames) != frames)
+    {
+        fprintf(stderr, "%s: %s\n", path, sf_strerror(f));
+        sf_close(f);
+        return -1;
+    }
+
+    sf_close(f);
+
+    return 0;
+}
+
+
+static float* wav_read(const char* path, long* frames, int* rate)
+{
+    SF_INFO info;
+    SNDFILE* f;
+    float* data;
+
+    memset(&info, 0, sizeof(info));
+
+    if (!(f = sf_open(path, SFM_READ, &info)))
+    {
+        fprintf(stderr, "%s: %s (record it with --record)\n", path,
+                                                        sf_strerror(0));
+        return 0;
+    }
+
+    if (info.channels != 2
+     || !(data = malloc(sizeof(float) * info.frames * 2)))
+    {
+        fprintf(stderr, "%s: not stereo or too large\n", path);
+        sf_close(f);
+        return 0;
+    }
+
+    *frames = sf_readf_float(f, data, info.frames);
+    *rate = info.samplerate;
+    sf_close(f);
+
+    return data;
+}
+
+
+static double to_db(double x)
+{
+    return x > 0 ? 20.0 * log10(x) : -INFINITY;
+}
+
+
+/*  returns 0 if out matches the golden data closely enough. when
+    diff_path is given the difference is written there */
+static int compare(const Case* c, const float* out, long frames,
+                        const float* gold, long gold_frames, int gold_rate,
+                        const char* diff_path)
+{
+    double max = 0;
+    long differ = 0;
+    long first = -1;
+    long i;
+    float* diff = 0;
+
+    if (gold_rate != c->rate || gold_frames != frames)
+    {
+        fprintf(stderr, "golden file is %ld frames at %d Hz, "
+                        "rendered %ld frames at %d Hz\n",
+                        gold_frames, gold_rate, frames, c->rate);
+        return -1;
+    }
+
+    if (diff_path)
+        diff = malloc(sizeof(float) * frames * 2);
+
+    for (i = 0; i < frames * 2; ++i)
+    {
+        double d = fabs((double)out[i] - gold[i]);
+
+        if (diff)
+            diff[i] = out[i] - gold[i];
+
+        if (out[i] != gold[i])
+        {
+            ++differ;
+
+            if (first < 0)
+                first = i / 2;
+        }
+
+        if (d > max)
+            max = d;
+    }
+
+    if (diff)
+    {
+        wav_write(diff_path, diff, frames, c->rate);
+        free(diff);
+    }
+
+    if (!differ)
+    {
+        printf("bit-exact\n");
+        return 0;
+    }
+
+    printf("%ld of %ld samples differ, the first at frame %ld, "
+           "largest difference %.1f dB\n",
+            differ, frames * 2, first, to_db(max));
+
+    if (c->exact)
+        return -1;
+
+    return to_db(max) <= c->tolerance ? 0 : -1;
+}
+
+
+/* returns 0 if out is fit to be compared with anything at all */
+static int check(const float* out, long frames)
+{
+    double peak = 0;
+    long i;
+
+    for (i = 0; i < frames * 2; ++i)
+    {
+        if (!isfinite(out[i]))
+        {
+            fprintf(stderr, "frame %ld is not a finite number\n", i / 2);
+            return -1;
+        }
+
+        if (fabs(out[i]) > peak)
+            peak = fabs(out[i]);
+    }
+
+    if (peak == 0)
+    {
+        fprintf(stderr, "all %ld frames are silent\n", frames);
+        return -1;
+    }
+
+    printf("sane, peak %.1f dB\n", to_db(peak));
+
+    return 0;
+}
+
+
+static char* golden_path(const char* case_path)
+{
+    const char* dot = strrchr(case_path, '.');
+    size_t len = dot && !strchr(dot, '/') ? (size_t)(dot - case_path)
+                                          : strlen(case_path);
+    char* path = malloc(len + 5);
+
+    if (path)
+    {
+        memcpy(path, case_path, len);
+        strcpy(path + len, ".wav");
+    }
+
+    return path;
+}
+
+
+static void show_usage(void)
+{
+    printf("Usage: petri-foo-regress [options] case\n\n");
+
+    printf("Options:\n");
+    printf("  -r, --record              Write the golden file rather "
+                                        "than compare with it\n");
+    printf("  -c, --check               Only check the render is sane, "
+                                        "no golden file needed\n");
+    printf("  -e, --exact               Require a bit-exact match, "
+                                        "whatever the case says\n");
+    printf("  -t, --tolerance <dB>      Largest difference allowed, "
+                                        "whatever the case says\n");
+    printf("  -d, --diff <file>         Write the difference to file\n");
+    printf("  -h, --help                Display this help message\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct option opts[] = {
+        { "record",     no_argument,        0,  'r' },
+        { "check",      no_argument,        0,  'c' },
+        { "exact",      no_argument,        0,  'e' },
+        { "tolerance",  required_argument,  0,  't' },
+        { "diff",       required_argument,  0,  'd' },
+        { "help",       no_argument,        0,  'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    static Case c;
+
+    bool record = false;
+    bool sanity = false;
+    int exact = -1;
+    double tolerance = 0;
+    const char* diff_path = 0;
+    char* gold_path = 0;
+    float* out = 0;
+    float* gold = 0;
+    long frames = 0;
+    long gold_frames = 0;
+    int gold_rate = 0;
+    int opt;
+    int ret = 1;
+
+    while ((opt = getopt_long(argc, argv, "rcet:d:h", opts, 0)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':   record = true;                          break;
+        case 'c':   sanity = true;                          break;
+        case 'e':   exact = 1;                              break;
+        case 't':   exact = 0; tolerance = atof(optarg);    break;
+        case 'd':   diff_path = optarg;                     break;
+        case 'h':   show_usage();                           return 0;
+        default:    show_usage();                           return 1;
+        }
+    }
+
+    if (argc - optind != 1)
+    {
+        show_usage();
+        return 1;
+    }
+
+    if (case_read(&c, argv[optind]) < 0)
+        return 1;
+
+    if (exact >= 0)
+    {
+        c.exact = exact;
+        c.tolerance = tolerance;
+    }
+
+    if (!(gold_path = golden_path(argv[optind])))
+        goto done;
+
+    if (headless_init(c.rate, c.period) < 0)
+    {
+        fprintf(stderr, "failed to start the offline driver\n");
+        goto shutdown;
+    }
+
+    if (headless_load_bank(c.bank) < 0)
+    {
+        fprintf(stderr, "failed to load bank %s\n", c.bank);
+        goto shutdown;
+    }
+
+    if (!(out = case_render(&c, &frames)))
+    {
+        fprintf(stderr, "failed to render\n");
+        goto shutdown;
+    }
+
+    if (sanity)
+    {
+        ret = check(out, frames) ? 1 : 0;
+    }
+    else if (record)
+    {
+        if (wav_write(gold_path, out, frames, c.rate) == 0)
+        {
+            printf("recorded %s\n", gold_path);
+            ret = 0;
+        }
+    }
+    else if ((gold = wav_read(gold_path, &gold_frames, &gold_rate)))
+    {
+        ret = compare(&c, out, frames, gold, gold_frames, gold_rate,
+                                                    diff_path) ? 1 : 0;
+    }
+
+shutdown:
+    headless_shutdown();
+
+done:
+    free(out);
+    free(gold);
+    free(gold_path);
+    free(c.bank);
+
+    return ret;
+}
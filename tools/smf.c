@@ -0,0 +1,367 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "smf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+enum {
+    SMF_TEMPO_DEFAULT = 500000  /* microseconds per quarter note */
+};
+
+
+/*  events are gathered in ticks first, with tempo changes kept among
+    them, and only turned into seconds once every track is in */
+typedef struct _SmfRaw
+{
+    unsigned long   tick;
+    long            order;      /* keeps the file's order at a tick */
+    long            tempo;      /* > 0 for a tempo change */
+    unsigned char   data[3];
+
+} SmfRaw;
+
+
+typedef struct _SmfReader
+{
+    const unsigned char*    p;
+    const unsigned char*    end;
+
+    SmfRaw*     raw;
+    long        count;
+    long        alloc;
+
+} SmfReader;
+
+
+static unsigned long be_read(const unsigned char* p, int bytes)
+{
+    unsigned long n = 0;
+
+    while (bytes--)
+        n = (n << 8) | *p++;
+
+    return n;
+}
+
+
+static int vlq_read(const unsigned char** p, const unsigned char* end,
+                                                    unsigned long* n)
+{
+    int i;
+
+    *n = 0;
+
+    for (i = 0; i < 4 && *p < end; ++i)
+    {
+        unsigned char c = *(*p)++;
+
+        *n = (*n << 7) | (c & 0x7f);
+
+        if (!(c & 0x80))
+            return 0;
+    }
+
+    return -1;
+}
+
+
+static SmfRaw* raw_add(SmfReader* r)
+{
+    if (r->count == r->alloc)
+    {
+        long alloc = r->alloc ? r->alloc * 2 : 1024;
+        SmfRaw* raw = realloc(r->raw, alloc * sizeof(*raw));
+
+        if (!raw)
+            return 0;
+
+        r->raw = raw;
+        r->alloc = alloc;
+    }
+
+    memset(&r->raw[r->count], 0, sizeof(SmfRaw));
+    r->raw[r->count].order = r->count;
+
+    return &r->raw[r->count++];
+}
+
+
+/* number of data bytes following a channel message's status byte */
+static int data_bytes(unsigned char status)
+{
+    switch (status & 0xf0)
+    {
+    case 0xc0:
+    case 0xd0:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+
+static const char* track_read(SmfReader* r, const unsigned char* p,
+                                            const unsigned char* end)
+{
+    unsigned long tick = 0;
+    unsigned long delta;
+    unsigned long len;
+    unsigned char status = 0;
+    SmfRaw* ev;
+
+    while (p < end)
+    {
+        if (vlq_read(&p, end, &delta) < 0 || p >= end)
+            return "bad delta time";
+
+        tick += delta;
+
+        if (*p == 0xff)
+        {   /* meta event */
+            unsigned char type;
+
+            if (end - p < 2)
+                return "truncated meta event";
+
+            type = p[1];
+            p += 2;
+
+            if (vlq_read(&p, end, &len) < 0 || len > (unsigned long)(end - p))
+                return "bad meta event length";
+
+            if (type == 0x51 && len == 3)
+            {
+                if (!(ev = raw_add(r)))
+                    return "out of memory";
+
+                ev->tick = tick;
+                ev->tempo = be_read(p, 3);
+            }
+            else if (type == 0x2f)
+                break;  /* end of track */
+
+            p += len;
+            continue;
+        }
+
+        if (*p == 0xf0 || *p == 0xf7)
+        {   /* sysex, cancels running status */
+            ++p;
+            status = 0;
+
+            if (vlq_read(&p, end, &len) < 0 || len > (unsigned long)(end - p))
+                return "bad sysex length";
+
+            p += len;
+            continue;
+        }
+
+        if (*p & 0x80)
+            status = *p++;
+        else if (!status)
+            return "data byte without status";
+
+        if (end - p < data_bytes(status))
+            return "truncated event";
+
+        if (!(ev = raw_add(r)))
+            return "out of memory";
+
+        ev->tick = tick;
+        ev->data[0] = status;
+        ev->data[1] = p[0] & 0x7f;
+
+        if (data_bytes(status) == 2)
+            ev->data[2] = p[1] & 0x7f;
+
+        p += data_bytes(status);
+    }
+
+    return 0;
+}
+
+
+static int raw_cmp(const void* a, const void* b)
+{
+    const SmfRaw* x = a;
+    const SmfRaw* y = b;
+
+    if (x->tick != y->tick)
+        return x->tick < y->tick ? -1 : 1;
+
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+
+static const char* smf_parse(SmfReader* r, int* division)
+{
+    const unsigned char* p = r->p;
+    unsigned long len;
+    int format;
+    int tracks;
+    int i;
+    const char* err;
+
+    if (r->end - p < 14 || memcmp(p, "MThd", 4) != 0)
+        return "not a standard MIDI file";
+
+    len = be_read(p + 4, 4);
+
+    if (len < 6 || len > (unsigned long)(r->end - p - 8))
+        return "bad header";
+
+    format =    be_read(p + 8, 2);
+    tracks =    be_read(p + 10, 2);
+    *division = be_read(p + 12, 2);
+
+    if (format > 1)
+        return "only format 0 and 1 files are supported";
+
+    if (*division == 0)
+        return "bad time division";
+
+    p += 8 + len;
+
+    for (i = 0; i < tracks && r->end - p >= 8; ++i)
+    {
+        len = be_read(p + 4, 4);
+
+        if (len > (unsigned long)(r->end - p - 8))
+            return "truncated track";
+
+        if (memcmp(p, "MTrk", 4) == 0
+         && (err = track_read(r, p + 8, p + 8 + len)))
+            return err;
+
+        p += 8 + len;
+    }
+
+    return 0;
+}
+
+
+SmfEvent* smf_read(const char* path, int* count, const char** err)
+{
+    FILE* f;
+    unsigned char* buf = 0;
+    long size;
+    SmfReader r;
+    SmfEvent* events = 0;
+    int division = 0;
+    long tempo = SMF_TEMPO_DEFAULT;
+    unsigned long last = 0;
+    double time = 0.0;
+    long i;
+    int n = 0;
+
+    *count = 0;
+    *err = 0;
+    memset(&r, 0, sizeof(r));
+
+    if (!(f = fopen(path, "rb")))
+    {
+        *err = "could not open file";
+        return 0;
+    }
+
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0
+     || fseek(f, 0, SEEK_SET) != 0)
+    {
+        *err = "could not read file";
+        goto fail;
+    }
+
+    if (!(buf = malloc(size ? size : 1)))
+    {
+        *err = "out of memory";
+        goto fail;
+    }
+
+    if (fread(buf, 1, size, f) != (size_t)size)
+    {
+        *err = "could not read file";
+        goto fail;
+    }
+
+    r.p = buf;
+    r.end = buf + size;
+
+    if ((*err = smf_parse(&r, &division)))
+        goto fail;
+
+    qsort(r.raw, r.count, sizeof(*r.raw), raw_cmp);
+
+    if (!(events = malloc((r.count ? r.count : 1) * sizeof(*events))))
+    {
+        *err = "out of memory";
+        goto fail;
+    }
+
+    for (i = 0; i < r.count; ++i)
+    {
+        unsigned long dt = r.raw[i].tick - last;
+
+        if (division & 0x8000)
+        {   /* SMPTE: frames per second and ticks per frame */
+            int fps = -(signed char)(division >> 8);
+            int tpf = division & 0xff;
+
+            time += dt / (double)((fps == 29 ? 29.97 : fps) * tpf);
+        }
+        else
+            time += dt * (tempo / 1000000.0) / division;
+
+        last = r.raw[i].tick;
+
+        if (r.raw[i].tempo > 0)
+        {
+            tempo = r.raw[i].tempo;
+            continue;
+        }
+
+        events[n].time = time;
+        memcpy(events[n].data, r.raw[i].data, 3);
+        ++n;
+    }
+
+    *count = n;
+
+    free(r.raw);
+    free(buf);
+    fclose(f);
+
+    return events;
+
+fail:
+    free(events);
+    free(r.raw);
+    free(buf);
+    fclose(f);
+
+    return 0;
+}
+
+
+void smf_free(SmfEvent* events)
+{
+    free(events);
+}
@@ -0,0 +1,47 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __SMF_H__
+#define __SMF_H__
+
+
+/*  smf
+        reads the channel messages out of a standard MIDI file (format
+        0 or 1) and works out when each falls, in seconds, from the
+        file's tempo map. sysex and meta events other than tempo
+        changes are skipped.
+ */
+
+
+typedef struct _SmfEvent
+{
+    double          time;       /* seconds from the start */
+    unsigned char   data[3];    /* status byte and up to two data */
+
+} SmfEvent;
+
+
+/*  returns the events of every track merged in time order (events
+    at the same time keep the order of the file), or NULL on error
+    with a message in *err. free with smf_free.
+ */
+SmfEvent*   smf_read(const char* path, int* count, const char** err);
+void        smf_free(SmfEvent*);
+
+
+#endif /* __SMF_H__ */
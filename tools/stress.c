@@ -0,0 +1,491 @@
+/*  Petri-Foo is a fork of the Specimen audio sampler.
+
+    This file is part of Petri-Foo.
+
+    Petri-Foo is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2 as
+    published by the Free Software Foundation.
+
+    Petri-Foo is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Petri-Foo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*  petri-foo-stress
+        plays generated MIDI (notes, chords, controller automation and
+        pitch bend sweeps) through a number of patches on the offline
+        driver, timing every period. a CSV row is written per period,
+        and a summary of render time against active voices at the end
+        gives the most voices the machine can render in real time.
+ */
+
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "headless.h"
+#include "lfo.h"
+#include "offlinedriver.h"
+#include "patch.h"
+#include "patch_set_and_get.h"
+#include "patch_util.h"
+#include "trace.h"
+
+
+enum {
+    DEFAULT_RATE =      48000,
+    DEFAULT_PERIOD =    64,
+    SAMPLE_SECS =       4,
+    MAX_CHORD =         16,
+    MAX_ROUTING =       4,
+    MAX_VOICES =        PATCH_COUNT * PATCH_VOICE_COUNT
+};
+
+
+typedef struct _StressParams
+{
+    int     rate;
+    int     period;
+    double  seconds;
+    int     patches;
+    double  density;    /* chords per second */
+    int     chord;      /* notes per chord */
+    double  length;     /* seconds a chord is held */
+    double  cc_rate;    /* controller messages per second per channel */
+    double  bend_rate;  /* pitch bend sweeps per second */
+    int     routing;    /* modulation routings per patch */
+    unsigned int seed;
+
+} StressParams;
+
+
+/* held chords, waiting for their note-offs */
+typedef struct _Held
+{
+    long    off;        /* frame */
+    int     chan;
+    int     notes[MAX_CHORD];
+    int     count;
+
+} Held;
+
+
+/* per active voice count: how long periods took */
+typedef struct _VoiceStats
+{
+    long    periods;
+    double  total_ns;
+    double  max_ns;
+
+} VoiceStats;
+
+
+static VoiceStats   stats[MAX_VOICES + 1];
+static Held         held[MAX_VOICES];
+static int          nheld = 0;
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*  each level adds one more routing to the one before, in the order
+    a typical patch would gain them */
+static void patch_route(int id, int routing)
+{
+    if (routing >= 1)
+    {   /* vibrato */
+        patch_set_lfo_active(id, MOD_SRC_VLFO, true);
+        patch_set_lfo_freq(id, MOD_SRC_VLFO, 5.0);
+        patch_param_set_mod_src(id, PATCH_PARAM_PITCH, 0, MOD_SRC_VLFO);
+        patch_param_set_mod_amt(id, PATCH_PARAM_PITCH, 0, 0.1);
+    }
+
+    if (routing >= 2)
+    {   /* filter envelope */
+        patch_set_env_active(id, MOD_SRC_EG + 1, true);
+        patch_set_env_decay(id, MOD_SRC_EG + 1, 0.5);
+        patch_set_env_sustain(id, MOD_SRC_EG + 1, 0.3);
+        patch_param_set_mod_src(id, PATCH_PARAM_CUTOFF, 0, MOD_SRC_EG + 1);
+        patch_param_set_mod_amt(id, PATCH_PARAM_CUTOFF, 0, 0.5);
+    }
+
+    if (routing >= 3)
+    {   /* auto-pan from a global LFO */
+        patch_set_lfo_active(id, MOD_SRC_GLFO, true);
+        patch_set_lfo_freq(id, MOD_SRC_GLFO, 0.5);
+        patch_param_set_mod_src(id, PATCH_PARAM_PANNING, 0, MOD_SRC_GLFO);
+        patch_param_set_mod_amt(id, PATCH_PARAM_PANNING, 0, 0.8);
+    }
+
+    if (routing >= 4)
+    {   /* tremolo, with its rate swept by a second voice LFO */
+        patch_set_lfo_active(id, MOD_SRC_VLFO + 1, true);
+        patch_set_lfo_freq(id, MOD_SRC_VLFO + 1, 7.0);
+        patch_set_lfo_active(id, MOD_SRC_VLFO + 2, true);
+        patch_set_lfo_freq(id, MOD_SRC_VLFO + 2, 0.3);
+        patch_set_lfo_fm1_src(id, MOD_SRC_VLFO + 1, MOD_SRC_VLFO + 2);
+        patch_param_set_mod_src(id, PATCH_PARAM_AMPLITUDE, 1,
+                                                    MOD_SRC_VLFO + 1);
+        patch_param_set_mod_amt(id, PATCH_PARAM_AMPLITUDE, 1, 0.3);
+    }
+}
+
+
+static int patches_create(const StressParams* sp, const char* sample)
+{
+    int i;
+    int id;
+
+    for (i = 0; i < sp->patches; ++i)
+    {
+        if ((id = patch_create()) < 0
+         || patch_sample_load(id, sample, 0, 0, 0) < 0)
+        {
+            fprintf(stderr, "failed to set up patch %d\n", i);
+            return -1;
+        }
+
+        patch_set_channel(id, i % 16);
+        patch_set_lower_note(id, 0);
+        patch_set_upper_note(id, 127);
+        patch_set_root_note(id, 60);
+        patch_set_play_mode(id, PATCH_PLAY_LOOP);
+        patch_route(id, sp->routing);
+    }
+
+    return 0;
+}
+
+
+static double rnd(unsigned int* seed)
+{
+    return rand_r(seed) / (RAND_MAX + 1.0);
+}
+
+
+/*  generates the events falling in the period starting at frame and
+    passes them to the mixer, returning how many there were */
+static int period_events(const StressParams* sp, long frame,
+                                                unsigned int* seed)
+{
+    unsigned char data[3];
+    int channels = sp->patches < 16 ? sp->patches : 16;
+    int events = 0;
+    int i, j;
+    int chan;
+    long off;
+
+    /* note-offs for chords whose time is up */
+    for (i = 0; i < nheld; )
+    {
+        if (held[i].off >= frame + sp->period)
+        {
+            ++i;
+            continue;
+        }
+
+        off = held[i].off > frame ? held[i].off - frame : 0;
+
+        for (j = 0; j < held[i].count; ++j)
+        {
+            data[0] = 0x80 | held[i].chan;
+            data[1] = held[i].notes[j];
+            data[2] = 0;
+            headless_midi(data, off);
+            ++events;
+        }
+
+        held[i] = held[--nheld];
+    }
+
+    /* new chords, as a Poisson process */
+    if (rnd(seed) < sp->density * sp->period / sp->rate
+     && nheld < MAX_VOICES)
+    {
+        Held* h = &held[nheld++];
+        int root = 36 + rand_r(seed) % 48;
+
+        off = rand_r(seed) % sp->period;
+        chan = rand_r(seed) % channels;
+
+        h->off = frame + off + (long)(sp->length * sp->rate);
+        h->chan = chan;
+        h->count = sp->chord;
+
+        for (j = 0; j < sp->chord; ++j)
+        {
+            h->notes[j] = (root + j * 4) % 128;
+            data[0] = 0x90 | chan;
+            data[1] = h->notes[j];
+            data[2] = 64 + rand_r(seed) % 64;
+            headless_midi(data, off);
+            ++events;
+        }
+    }
+
+    /* controller automation: the mod wheel, on every channel */
+    if (sp->cc_rate > 0)
+    {
+        double per = sp->cc_rate * sp->period / sp->rate;
+        int n = (int)per + (rnd(seed) < per - (int)per);
+
+        for (i = 0; i < n; ++i)
+        {
+            for (chan = 0; chan < channels; ++chan)
+            {
+                data[0] = 0xB0 | chan;
+                data[1] = 1;
+                data[2] = rand_r(seed) % 128;
+                headless_midi(data, i * sp->period / n);
+                ++events;
+            }
+        }
+    }
+
+    /* pitch bend sweeps, one message per period */
+    if (sp->bend_rate > 0)
+    {
+        double phase = fmod((double)frame / sp->rate * sp->bend_rate, 1.0);
+        int bend = 8192 + (int)(8191 * sin(2 * M_PI * phase));
+
+        for (chan = 0; chan < channels; ++chan)
+        {
+            data[0] = 0xE0 | chan;
+            data[1] = bend & 0x7f;
+            data[2] = bend >> 7;
+            headless_midi(data, 0);
+            ++events;
+        }
+    }
+
+    return events;
+}
+
+
+static void summary(const StressParams* sp)
+{
+    double period_ns = 1e9 * sp->period / sp->rate;
+    int limit = -1;
+    int limit_worst = -1;
+    int v;
+
+    fprintf(stderr, "\n%6s %8s %12s %12s %8s\n",
+                    "voices", "periods", "mean ns", "max ns", "load %");
+
+    for (v = 0; v <= MAX_VOICES; ++v)
+    {
+        double mean;
+
+        if (!stats[v].periods)
+            continue;
+
+        mean = stats[v].total_ns / stats[v].periods;
+
+        fprintf(stderr, "%6d %8ld %12.0f %12.0f %8.1f\n", v,
+                        stats[v].periods, mean, stats[v].max_ns,
+                        100.0 * mean / period_ns);
+
+        if (mean < period_ns)
+            limit = v;
+
+        if (stats[v].max_ns < period_ns)
+            limit_worst = v;
+    }
+
+    fprintf(stderr, "\nat %d frames / %d Hz (%.0f ns per period), "
+                    "most voices rendered in time:\n"
+                    "  %d on average, %d in the worst period\n",
+                    sp->period, sp->rate, period_ns, limit, limit_worst);
+}
+
+
+static void show_usage(void)
+{
+    printf("Usage: petri-foo-stress [options]\n\n");
+
+    printf("Options:\n");
+    printf("  -r, --rate <hz>           Sample rate, defaults to %d\n",
+                                                        DEFAULT_RATE);
+    printf("  -p, --period <frames>     Period size, defaults to %d\n",
+                                                        DEFAULT_PERIOD);
+    printf("  -d, --duration <seconds>  Time rendered, defaults to 30\n");
+    printf("  -P, --patches <n>         Patches, one per channel "
+                                        "(round robin), defaults to 4\n");
+    printf("  -n, --density <n>         Chords per second, "
+                                        "defaults to 20\n");
+    printf("  -c, --chord <n>           Notes per chord, defaults to 3\n");
+    printf("  -l, --length <seconds>    Time chords are held, "
+                                        "defaults to 1\n");
+    printf("  -C, --cc-rate <n>         Mod wheel messages per second "
+                                        "per channel, defaults to 0\n");
+    printf("  -b, --bend-rate <n>       Pitch bend sweeps per second, "
+                                        "defaults to 0\n");
+    printf("  -m, --routing <0-%d>       Modulation routings per patch, "
+                                        "defaults to 0\n", MAX_ROUTING);
+    printf("  -s, --seed <n>            Random seed, defaults to 1\n");
+    printf("  -o, --output <file>       CSV output, defaults to stdout\n");
+    printf("  -t, --trace <file>        Record a Chrome trace of the "
+                                        "run\n");
+    printf("  -h, --help                Display this help message\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    static struct option opts[] = {
+        { "rate",       required_argument,  0,  'r' },
+        { "period",     required_argument,  0,  'p' },
+        { "duration",   required_argument,  0,  'd' },
+        { "patches",    required_argument,  0,  'P' },
+        { "density",    required_argument,  0,  'n' },
+        { "chord",      required_argument,  0,  'c' },
+        { "length",     required_argument,  0,  'l' },
+        { "cc-rate",    required_argument,  0,  'C' },
+        { "bend-rate",  required_argument,  0,  'b' },
+        { "routing",    required_argument,  0,  'm' },
+        { "seed",       required_argument,  0,  's' },
+        { "output",     required_argument,  0,  'o' },
+        { "trace",      required_argument,  0,  't' },
+        { "help",       no_argument,        0,  'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    StressParams sp = {
+        DEFAULT_RATE, DEFAULT_PERIOD, 30.0, 4, 20.0, 3, 1.0,
+        0.0, 0.0, 0, 1
+    };
+
+    const char* output = 0;
+    const char* trace = 0;
+    FILE* csv = stdout;
+    char* sample = 0;
+    unsigned int seed;
+    long frame;
+    long periods;
+    long n;
+    int opt;
+    int ret = 1;
+
+    while ((opt = getopt_long(argc, argv, "r:p:d:P:n:c:l:C:b:m:s:o:t:h",
+                                                    opts, 0)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':   sp.rate = atoi(optarg);         break;
+        case 'p':   sp.period = atoi(optarg);       break;
+        case 'd':   sp.seconds = atof(optarg);      break;
+        case 'P':   sp.patches = atoi(optarg);      break;
+        case 'n':   sp.density = atof(optarg);      break;
+        case 'c':   sp.chord = atoi(optarg);        break;
+        case 'l':   sp.length = atof(optarg);       break;
+        case 'C':   sp.cc_rate = atof(optarg);      break;
+        case 'b':   sp.bend_rate = atof(optarg);    break;
+        case 'm':   sp.routing = atoi(optarg);      break;
+        case 's':   sp.seed = strtoul(optarg, 0, 10);   break;
+        case 'o':   output = optarg;                break;
+        case 't':   trace = optarg;                 break;
+        case 'h':   show_usage();                   return 0;
+        default:    show_usage();                   return 1;
+        }
+    }
+
+    if (sp.rate <= 0 || sp.period <= 0 || sp.seconds <= 0
+     || sp.patches < 1 || sp.patches > PATCH_COUNT
+     || sp.chord < 1 || sp.chord > MAX_CHORD
+     || sp.density < 0 || sp.length < 0
+     || sp.routing < 0 || sp.routing > MAX_ROUTING)
+    {
+        show_usage();
+        return 1;
+    }
+
+    if (output && !(csv = fopen(output, "w")))
+    {
+        perror(output);
+        return 1;
+    }
+
+    if (!(sample = headless_test_sample(sp.rate, SAMPLE_SECS)))
+    {
+        fprintf(stderr, "failed to write test sample\n");
+        goto done;
+    }
+
+    if (headless_init(sp.rate, sp.period) < 0)
+    {
+        fprintf(stderr, "failed to start the offline driver\n");
+        goto shutdown;
+    }
+
+    if (patches_create(&sp, sample) < 0)
+        goto shutdown;
+
+    if (trace && trace_start(trace) < 0)
+    {
+        fprintf(stderr, "failed to open trace file %s\n", trace);
+        goto shutdown;
+    }
+
+    fprintf(csv, "period,seconds,voices,events,render_ns,load\n");
+
+    seed = sp.seed;
+    periods = (long)(sp.seconds * sp.rate / sp.period);
+
+    for (n = 0; n < periods; ++n)
+    {
+        int events;
+        int voices;
+        double t;
+
+        frame = offline_driver_get_frame();
+        events = period_events(&sp, frame, &seed);
+
+        t = now_ns();
+        offline_driver_render();
+        t = now_ns() - t;
+
+        voices = patch_active_voices();
+
+        fprintf(csv, "%ld,%.4f,%d,%d,%.0f,%.4f\n", n,
+                        (double)frame / sp.rate, voices, events, t,
+                        t / (1e9 * sp.period / sp.rate));
+
+        stats[voices].periods++;
+        stats[voices].total_ns += t;
+
+        if (t > stats[voices].max_ns)
+            stats[voices].max_ns = t;
+    }
+
+    summary(&sp);
+    ret = 0;
+
+shutdown:
+    headless_shutdown();
+
+done:
+    if (sample)
+        unlink(sample);
+
+    free(sample);
+
+    if (csv != stdout)
+        fclose(csv);
+
+    return ret;
+}